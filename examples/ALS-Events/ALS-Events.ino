@@ -0,0 +1,67 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+
+#ifdef NRF52_SERIES
+#define SDA1 18 // I2C 1 SDA
+#define SCL1 16 // I2C 1 SCL
+
+TwoWire i2cWire1 = TwoWire(NRF_TWIM0, NRF_TWIS0, SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, SDA1, SCL1);
+
+VCNL4020C ppg1(&i2cWire1, VCNL4020C_ADDR);
+#else
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+#endif
+
+void ppg1IntHandler(void);
+void alsChanged(uint16_t alsValue);
+int vcnlIntPin = 15;
+
+volatile bool ppgHasEvent = false;
+
+void setup()
+{
+	Serial.begin(115200);
+
+	Serial.println("VCNL4020C ALS change events");
+	// Initialize sensor
+	if (!ppg1.initSensorDefault())
+	{
+		Serial.println("Sensor initialization failed!");
+	}
+
+	// Set interrupt pin and callback function
+	ppg1.setInterruptCb(ppg1IntHandler, vcnlIntPin);
+	// Set ALS change callback function
+	ppg1.setAlsChangeCb(alsChanged);
+
+	// Set ALS data rate
+	ppg1.setAlsParam(AMB_SENS_RATE_10, AVG_CONV_4, true);
+
+	// Report changes of more than 10% or at least 20 counts, after 2 measurements outside the window
+	if (!ppg1.startAlsEvents(20, 10, INT_CNT_EXC_2))
+	{
+		Serial.println("Starting ALS events failed");
+	}
+}
+
+void loop()
+{
+	if (ppgHasEvent)
+	{
+		ppgHasEvent = false;
+		ppg1.handleAlsEvent();
+	}
+	// Nothing else to do, the MCU could sleep here until the next light change
+}
+
+void alsChanged(uint16_t alsValue)
+{
+	Serial.print("Ambient light changed to ");
+	Serial.println(alsValue);
+}
+
+void ppg1IntHandler(void)
+{
+	ppgHasEvent = true;
+}
@@ -0,0 +1,81 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+
+#ifdef NRF52_SERIES
+#define SDA1 18 // I2C 1 SDA
+#define SCL1 16 // I2C 1 SCL
+
+TwoWire i2cWire1 = TwoWire(NRF_TWIM0, NRF_TWIS0, SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, SDA1, SCL1);
+
+VCNL4020C ppg1(&i2cWire1, VCNL4020C_ADDR);
+#else
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+#endif
+
+/** Samples per batch */
+#define BATCH_WATERMARK 25
+/** Double buffer for the batches, owned by the sketch */
+PPG_SAMPLE batchBuffer[VCNL4020C_BATCH_SIZE(BATCH_WATERMARK)];
+
+/**
+ * Batch consumer, gets 25 samples at once
+ * A radio or flash writer would send or store the whole block here
+ */
+void batchReady(void *ctx, const PPG_SAMPLE *samples, uint16_t count)
+{
+	uint16_t minVal = 0xFFFF;
+	uint16_t maxVal = 0;
+	for (uint16_t idx = 0; idx < count; idx++)
+	{
+		if (samples[idx].value < minVal)
+		{
+			minVal = samples[idx].value;
+		}
+		if (samples[idx].value > maxVal)
+		{
+			maxVal = samples[idx].value;
+		}
+	}
+	Serial.print("Batch of ");
+	Serial.print(count);
+	Serial.print(" samples over ");
+	Serial.print(samples[count - 1].timestamp - samples[0].timestamp);
+	Serial.print(" us, min ");
+	Serial.print(minVal);
+	Serial.print(" max ");
+	Serial.println(maxVal);
+}
+
+void setup()
+{
+	Serial.begin(115200);
+
+	// Initialize sensor
+	if (!ppg1.initSensorDefault())
+	{
+		Serial.println("Sensor initialization failed!");
+	}
+
+	// Deliver batches of 25 samples, at least every 500ms
+	if (!ppg1.startBatch(batchReady, NULL, batchBuffer, BATCH_WATERMARK, 500))
+	{
+		Serial.println("Batch delivery could not be started");
+	}
+
+	// Set bio sensor data rate
+	ppg1.setBioDataRate(BIO_SENS_RATE_125);
+	// Set LED current
+	ppg1.setLedCurrent(3);
+	// Start continuous measurement with Bio sensor only
+	ppg1.startContinuous(true, false);
+}
+
+void loop()
+{
+	if (ppg1.bioDataReady())
+	{
+		ppg1.readBatchSample();
+	}
+	ppg1.serviceBatch();
+}
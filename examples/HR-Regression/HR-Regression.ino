@@ -0,0 +1,182 @@
+#include <Arduino.h>
+
+#include <heartRate.h>
+#include <ppgSynth.h>
+
+#include "hrGolden.h"
+
+/** Sample rate of the synthetic signals, the golden beat table is made for it */
+#define SAMPLE_RATE GOLDEN_RATE
+/** Length of each signal in seconds */
+#define DURATION_SEC 120
+/** Maximum delay of a detection after the pulse onset in samples (350ms) */
+#define MAX_LAG (SAMPLE_RATE * 35 / 100)
+/** Largest distance of a detected beat from its golden beat in samples */
+#define GOLDEN_TOLERANCE 2
+/** Lowest share of beats that match the golden beat table, float math of the boards differs slightly */
+#define MIN_AGREEMENT 0.98
+/** Samples generated ahead of the timed beat detection */
+#define BLOCK_SIZE 32
+/**
+ * Expected cycles per sample of checkForBeat() on this board, 0 to only report them.
+ * Set it to the value of a known good run, a run more than 10% slower fails.
+ * On the host extras/tools/hr_regression checks the speed in CI.
+ */
+#define CYCLE_BUDGET 0
+
+/*
+ * hrGolden.h holds the beats the default HEART_RATE detects in every preset.
+ * A change of the beat detection that moves, adds or removes beats shows up here.
+ * After an intended change regenerate it from extras/tools/hr_regression:
+ *   ./hr_regression -u -e ../../../examples/HR-Regression/hrGolden.h
+ */
+
+PPG_SYNTH synth;
+PPG_SYNTH_SCORE score(MAX_LAG);
+
+int32_t block[BLOCK_SIZE];
+int16_t detected[BLOCK_SIZE];
+float truth[BLOCK_SIZE];
+
+/**
+ * Run one preset through a new HEART_RATE instance
+ * @param preset
+ * 		Preset number
+ * @param matched
+ * 		Pointer to the number of beats that match the golden beat table
+ * @param detections
+ * 		Pointer to the number of detected beats
+ * @return time in microseconds of the beat detection alone
+ */
+uint32_t runPreset(uint8_t preset, uint16_t *matched, uint16_t *detections)
+{
+	PPG_SYNTH_CONFIG config;
+	PPG_SYNTH::getPreset(preset, &config, SAMPLE_RATE);
+	HEART_RATE hr;
+	hr.setSamplePeriod(1000000UL / SAMPLE_RATE);
+	synth.begin(config);
+	score.reset();
+
+	uint16_t golden = goldenStart[preset];
+	uint16_t goldenEnd = goldenStart[preset + 1];
+	*matched = 0;
+	*detections = 0;
+	uint32_t elapsed = 0;
+	uint32_t numSamples = (uint32_t)SAMPLE_RATE * DURATION_SEC;
+	for (uint32_t first = 0; first < numSamples; first += BLOCK_SIZE)
+	{
+		uint8_t count = ((numSamples - first) < BLOCK_SIZE) ? (uint8_t)(numSamples - first) : BLOCK_SIZE;
+		// Signal generation and scoring are not timed
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			block[idx] = synth.next();
+			truth[idx] = -1.0;
+			if (synth.isBeat())
+			{
+				uint32_t interval = synth.getBeatInterval();
+				truth[idx] = interval ? (60.0 * SAMPLE_RATE / interval) : 0.0;
+			}
+		}
+		uint32_t start = micros();
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			detected[idx] = hr.checkForBeat(block[idx]) ? hr.getLastHR() : -1;
+		}
+		elapsed += micros() - start;
+
+		// Score in sample order, as if the samples were processed one by one
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			uint32_t n = first + idx;
+			if (truth[idx] >= 0.0)
+			{
+				score.addTruth(n, truth[idx]);
+			}
+			if (detected[idx] < 0)
+			{
+				continue;
+			}
+			score.addDetection(n, detected[idx]);
+			(*detections)++;
+			while ((golden < goldenEnd) && ((uint32_t)pgm_read_word(&goldenBeats[golden]) + GOLDEN_TOLERANCE < n))
+			{
+				golden++;
+			}
+			if ((golden < goldenEnd) && ((uint32_t)pgm_read_word(&goldenBeats[golden]) <= n + GOLDEN_TOLERANCE))
+			{
+				(*matched)++;
+				golden++;
+			}
+		}
+	}
+	score.finish(numSamples);
+	return elapsed;
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	delay(1000);
+
+	Serial.println(F("HEART_RATE regression on synthetic signals"));
+	Serial.println(F("preset, truePos, falsePos, falseNeg, F1, BPM error, golden agreement, us/sample, cycles/sample, result"));
+
+	uint8_t failed = 0;
+	uint32_t numSamples = (uint32_t)SAMPLE_RATE * DURATION_SEC;
+	for (uint8_t p = 0; p < PPG_SYNTH_NUM_PRESETS; p++)
+	{
+		uint16_t matched;
+		uint16_t detections;
+		uint32_t elapsed = runPreset(p, &matched, &detections);
+		uint16_t goldenCount = goldenStart[p + 1] - goldenStart[p];
+		float agreement = ((detections + goldenCount) != 0) ? 2.0 * matched / (detections + goldenCount) : 1.0;
+		float usPerSample = (float)elapsed / numSamples;
+#ifdef F_CPU
+		float cyclesPerSample = usPerSample * (F_CPU / 1000000UL);
+#else
+		float cyclesPerSample = 0.0;
+#endif
+
+		bool pass = agreement >= MIN_AGREEMENT;
+		if ((CYCLE_BUDGET > 0) && (cyclesPerSample > (CYCLE_BUDGET * 1.1)))
+		{
+			pass = false;
+		}
+		if (!pass)
+		{
+			failed++;
+		}
+
+		Serial.print(PPG_SYNTH::getPresetName(p));
+		Serial.print(F(", "));
+		Serial.print(score.getTruePos());
+		Serial.print(F(", "));
+		Serial.print(score.getFalsePos());
+		Serial.print(F(", "));
+		Serial.print(score.getFalseNeg());
+		Serial.print(F(", "));
+		Serial.print(score.getF1(), 3);
+		Serial.print(F(", "));
+		Serial.print(score.getBpmError());
+		Serial.print(F(", "));
+		Serial.print(agreement, 3);
+		Serial.print(F(", "));
+		Serial.print(usPerSample);
+		Serial.print(F(", "));
+		Serial.print(cyclesPerSample, 0);
+		Serial.println(pass ? F(", pass") : F(", FAIL"));
+	}
+	if (failed == 0)
+	{
+		Serial.println(F("All presets passed"));
+	}
+	else
+	{
+		Serial.print(failed);
+		Serial.println(F(" presets failed"));
+	}
+}
+
+void loop()
+{
+}
@@ -0,0 +1,113 @@
+/**
+ * Golden beat times of the PPG_SYNTH presets at 125 samples/s, 120 s per preset
+ * Generated by extras/tools/hr_regression with -u -e, do not edit
+ */
+#ifndef HR_GOLDEN_H
+#define HR_GOLDEN_H
+
+#define GOLDEN_RATE 125
+
+/** Input sample of every detected beat, all presets one after the other */
+const uint16_t goldenBeats[] PROGMEM = {
+	239, 353, 469, 586, 700, 812, 930, 1044, 1164, 1280, 1397, 1510,
+	1628, 1745, 1858, 1974, 2093, 2211, 2325, 2435, 2551, 2668, 2787, 2900,
+	3012, 3130, 3244, 3361, 3473, 3592, 3707, 3821, 3936, 4050, 4169, 4286,
+	4402, 4519, 4635, 4755, 4870, 4987, 5104, 5224, 5341, 5453, 5571, 5689,
+	5805, 5921, 6032, 6146, 6262, 6380, 6496, 6615, 6728, 6842, 6954, 7067,
+	7184, 7302, 7416, 7531, 7646, 7759, 7875, 7990, 8109, 8225, 8339, 8456,
+	8571, 8690, 8802, 8917, 9034, 9156, 9270, 9387, 9501, 9613, 9726, 9842,
+	9960, 10076, 10196, 10308, 10419, 10534, 10649, 10766, 10884, 10995, 11109, 11230,
+	11344, 11458, 11572, 11685, 11798, 11916, 12030, 12151, 12271, 12388, 12502, 12615,
+	12727, 12844, 12962, 13075, 13194, 13307, 13419, 13531, 13644, 13761, 13873, 13987,
+	14100, 14215, 14331, 14442, 14558, 14672, 14791, 14904, 160, 210, 260, 310,
+	360, 410, 459, 509, 560, 610, 661, 711, 761, 811, 861, 910,
+	959, 1009, 1059, 1109, 1159, 1209, 1259, 1308, 1358, 1408, 1457, 1507,
+	1557, 1608, 1657, 1708, 1759, 1809, 1859, 1908, 1958, 2007, 2058, 2108,
+	2159, 2209, 2259, 2309, 2359, 2408, 2458, 2507, 2557, 2608, 2658, 2709,
+	2759, 2809, 2859, 2908, 2958, 3008, 3058, 3108, 3158, 3209, 3259, 3310,
+	3360, 3410, 3459, 3508, 3558, 3608, 3658, 3709, 3759, 3808, 3858, 3908,
+	3958, 4008, 4058, 4108, 4159, 4209, 4260, 4309, 4359, 4410, 4459, 4509,
+	4559, 4609, 4659, 4709, 4759, 4809, 4858, 4908, 4958, 5008, 5058, 5107,
+	5158, 5209, 5259, 5309, 5359, 5408, 5458, 5507, 5558, 5608, 5658, 5708,
+	5758, 5808, 5858, 5907, 5957, 6007, 6058, 6108, 6159, 6209, 6259, 6309,
+	6359, 6409, 6459, 6508, 6558, 6609, 6659, 6709, 6759, 6809, 6858, 6908,
+	6957, 7007, 7057, 7107, 7158, 7209, 7259, 7309, 7358, 7407, 7457, 7507,
+	7557, 7608, 7658, 7707, 7757, 7807, 7857, 7906, 7956, 8005, 8055, 8106,
+	8156, 8206, 8257, 8307, 8357, 8406, 8456, 8505, 8554, 8605, 8655, 8706,
+	8756, 8806, 8855, 8904, 8954, 9003, 9053, 9103, 9154, 9204, 9255, 9305,
+	9355, 9405, 9454, 9504, 9555, 9605, 9655, 9706, 9756, 9806, 9856, 9905,
+	9955, 10005, 10055, 10105, 10155, 10206, 10256, 10306, 10356, 10406, 10455, 10505,
+	10555, 10605, 10655, 10705, 10756, 10805, 10855, 10904, 10953, 11004, 11053, 11103,
+	11154, 11204, 11255, 11305, 11354, 11405, 11454, 11505, 11554, 11604, 11654, 11704,
+	11755, 11805, 11855, 11904, 11954, 12003, 12053, 12104, 12155, 12205, 12256, 12305,
+	12355, 12404, 12454, 12504, 12554, 12604, 12654, 12705, 12755, 12805, 12855, 12905,
+	12955, 13005, 13054, 13105, 13155, 13206, 13256, 13307, 13356, 13405, 13455, 13504,
+	13554, 13604, 13655, 13705, 13755, 13804, 13855, 13904, 13955, 14004, 14054, 14105,
+	14155, 14205, 14255, 14306, 14356, 14406, 14455, 14505, 14555, 14605, 14655, 14706,
+	14756, 14806, 14855, 14905, 14954, 359, 529, 720, 895, 1068, 1253, 1432,
+	1606, 1791, 1966, 2151, 2328, 2497, 2682, 2862, 3035, 3220, 3392, 3565,
+	3754, 3933, 4117, 4301, 4469, 4649, 4831, 5009, 5194, 5369, 5540, 5731,
+	5904, 6084, 6268, 6439, 6619, 6796, 6974, 7151, 7325, 7495, 7672, 7851,
+	8015, 8207, 8385, 8563, 8750, 8924, 9108, 9295, 9467, 9651, 9830, 10007,
+	10191, 10371, 10548, 10740, 10919, 11097, 11280, 11456, 11639, 11816, 11994, 12171,
+	12351, 12517, 12701, 12872, 13036, 13226, 13400, 13569, 13759, 13930, 14112, 14296,
+	14473, 14660, 14833, 248, 349, 592, 704, 781, 1052, 1164, 1396, 1514,
+	1605, 1864, 1977, 2043, 2328, 2432, 2675, 2788, 2864, 3130, 3240, 3284,
+	3480, 3600, 3688, 3942, 4055, 4122, 4397, 4502, 4733, 4852, 4939, 5199,
+	5311, 5377, 5663, 5766, 6008, 6122, 6198, 6473, 6580, 6807, 6928, 7020,
+	7271, 7384, 7454, 7729, 7836, 8075, 8190, 8274, 8533, 8643, 8708, 8993,
+	9095, 9329, 9447, 9528, 9795, 9904, 9949, 10135, 10255, 10352, 10601, 10717,
+	10787, 11066, 11169, 11408, 11527, 11610, 11879, 11988, 12032, 12223, 12346, 12437,
+	12696, 12811, 12876, 13161, 13264, 13511, 13625, 13700, 13976, 14084, 14324, 14446,
+	14527, 14790, 14903, 14948, 198, 291, 475, 569, 662, 755, 851, 942,
+	1035, 1129, 1226, 1318, 1409, 1503, 1598, 1696, 1787, 1879, 1971, 2022,
+	2237, 2346, 2438, 2530, 2625, 2723, 2819, 2914, 3004, 3094, 3182, 3377,
+	3469, 3566, 3659, 3755, 3830, 3946, 4041, 4134, 4231, 4322, 4416, 4510,
+	4606, 4702, 4798, 4888, 4972, 5076, 5172, 5265, 5357, 5453, 5544, 5642,
+	5737, 5831, 5925, 5958, 6116, 6213, 6306, 6380, 6495, 6556, 6683, 6779,
+	6872, 6968, 7158, 7253, 7347, 7438, 7531, 7623, 7721, 7815, 7908, 7999,
+	8035, 8187, 8278, 8368, 8463, 8555, 8621, 8738, 8836, 8929, 9022, 9118,
+	9212, 9305, 9398, 9488, 9580, 9767, 9861, 10045, 10139, 10231, 10325, 10419,
+	10510, 10602, 10695, 10791, 10883, 10978, 11073, 11168, 11264, 11358, 11448, 11543,
+	11636, 11727, 11821, 11914, 12004, 12097, 12138, 12288, 12382, 12478, 12570, 12764,
+	12855, 12946, 13000, 13134, 13230, 13319, 13599, 13697, 13793, 13886, 13977, 14166,
+	14260, 14353, 14448, 14538, 14630, 14723, 14816, 14910, 219, 326, 433, 539,
+	643, 747, 856, 967, 1072, 1182, 1290, 1392, 1503, 1608, 1719, 1826,
+	1936, 2043, 2153, 2260, 2369, 2472, 2579, 2685, 2789, 2892, 2994, 3110,
+	3223, 3325, 3429, 3532, 3636, 3745, 3854, 3958, 4066, 4176, 4287, 4391,
+	4498, 4606, 4714, 4824, 4921, 5033, 5143, 5255, 5361, 5470, 5580, 5688,
+	5799, 5906, 6003, 6115, 6226, 6328, 6435, 6542, 6651, 6756, 6860, 6966,
+	7067, 7180, 7291, 7397, 7501, 7613, 7723, 7833, 7936, 8042, 8148, 8257,
+	8363, 8468, 8571, 8677, 8782, 8890, 8990, 9097, 9201, 9306, 9414, 9523,
+	9626, 9733, 9842, 9944, 10050, 10162, 10272, 10367, 10488, 10592, 10703, 10814,
+	10922, 11031, 11136, 11241, 11349, 11455, 11550, 11673, 11780, 11886, 11989, 12096,
+	12204, 12316, 12427, 12532, 12640, 12744, 12852, 12955, 13065, 13174, 13284, 13393,
+	13496, 13605, 13709, 13815, 13923, 14035, 14142, 14254, 14364, 14472, 14582, 14687,
+	14797, 14902, 208, 306, 405, 507, 604, 707, 808, 910, 1009, 1112,
+	1216, 1317, 1418, 1514, 1613, 1710, 1809, 1906, 2002, 2100, 2202, 2303,
+	2401, 2500, 2602, 2699, 2799, 2902, 3000, 3100, 3201, 3298, 3397, 3498,
+	3595, 3694, 3797, 3897, 3995, 4093, 4192, 4290, 4388, 4489, 4588, 4684,
+	4783, 4879, 4981, 5084, 5182, 5280, 5382, 5483, 5586, 5689, 5789, 5885,
+	5982, 6079, 6177, 6275, 6374, 6476, 6580, 6677, 6779, 6876, 6974, 7073,
+	7171, 7270, 7367, 7467, 7567, 7667, 7771, 7872, 7970, 8074, 8177, 8275,
+	8376, 8477, 8580, 8677, 8776, 8877, 8979, 9082, 9183, 9284, 9384, 9483,
+	9583, 9685, 9787, 9889, 9989, 10088, 10188, 10285, 10387, 10488, 10590, 10692,
+	10792, 10892, 10994, 11097, 11199, 11299, 11398, 11501, 11598, 11698, 11797, 11897,
+	11994, 12092, 12190, 12290, 12391, 12490, 12587, 12687, 12785, 12883, 12983, 13087,
+	13190, 13294, 13396, 13493, 13591, 13692, 13794, 13894, 13995, 14094, 14194, 14293,
+	14394, 14492, 14591, 14690, 14789, 14886, 14989, 238, 352, 449, 515, 698,
+	810, 921, 1009, 1157, 1277, 1389, 1472, 1603, 1741, 1857, 1946, 2048,
+	2202, 2317, 2423, 2509, 2663, 2784, 2894, 2979, 3054, 3234, 3347, 3448,
+	3511, 3700, 3818, 3927, 4016, 4165, 4283, 4396, 4480, 4621, 4742, 4855,
+	4949, 5049, 5198, 5313, 5422, 5506, 5663, 5780, 5894, 5977, 6101, 6236,
+	6351, 6445, 6508, 6694, 6811, 6923, 7009, 7160, 7283, 7391, 7481, 7611,
+	7748, 7863, 7955, 8028, 8219, 8331, 8434, 8524, 8676, 8794, 8903, 8990,
+	9131, 9255, 9365, 9458, 9567, 9720, 9837, 9936, 9997, 10183, 10298, 10410,
+	10496, 10639, 10758, 10873, 10961, 11038, 11222, 11340, 11437, 11536, 11686, 11806,
+	11916, 12005, 12157, 12274, 12382, 12462, 12542, 12723, 12834, 12931, 12991, 13170,
+	13286, 13400, 13486, 13610, 13753, 13864, 13956, 14053, 14201, 14317, 14424, 14505,
+	14650, 14774, 14888, 14970};
+
+/** First entry of every preset in goldenBeats, the last entry is the table size */
+const uint16_t goldenStart[PPG_SYNTH_NUM_PRESETS + 1] = {0, 128, 425, 507, 604, 752, 890, 1039, 1168};
+#endif
@@ -0,0 +1,98 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+#include <heartRate.h>
+
+/**
+ * Data of one sensor, passed as context to the event handler
+ */
+struct SENSOR_DATA
+{
+	VCNL4020C *sensor;
+	const char *name;
+	HEART_RATE hr;
+	uint16_t bioVal;
+};
+
+#ifdef ESP32
+// Two sensors with the same I2C address on two I2C buses
+#define NUM_SENSORS 2
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+VCNL4020C ppg2(&Wire1, VCNL4020C_ADDR);
+SENSOR_DATA sensors[NUM_SENSORS] = {{&ppg1, "Left"}, {&ppg2, "Right"}};
+int intPins[NUM_SENSORS] = {15, 16};
+#else
+#define NUM_SENSORS 1
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+SENSOR_DATA sensors[NUM_SENSORS] = {{&ppg1, "Sensor"}};
+int intPins[NUM_SENSORS] = {2};
+#endif
+
+/**
+ * Event handler for all sensors
+ * Called from VCNL4020C::dispatchEvents() with the interrupt status bits
+ */
+void sensorEvent(void *ctx, uint8_t events)
+{
+	SENSOR_DATA *data = (SENSOR_DATA *)ctx;
+	if (events & INT_BIO_RDY)
+	{
+		data->bioVal = data->sensor->getBioValue();
+		if (data->hr.checkForBeat(data->bioVal))
+		{
+			Serial.print(data->name);
+			Serial.print(" heartrate ");
+			Serial.println(data->hr.getSmoothedHR());
+		}
+	}
+	if (events & (INT_TH_LOW_RDY | INT_TH_HIGH_RDY))
+	{
+		// The driver already moved the ALS window and called alsChanged()
+		Serial.print(data->name);
+		Serial.println(" left the ALS window");
+	}
+}
+
+/**
+ * ALS change callback, called from VCNL4020C::dispatchEvents() when the ambient light left its window
+ */
+void alsChanged(uint16_t alsValue)
+{
+	Serial.print("ALS changed to ");
+	Serial.println(alsValue);
+}
+
+void setup()
+{
+	Serial.begin(115200);
+
+	for (uint8_t idx = 0; idx < NUM_SENSORS; idx++)
+	{
+		VCNL4020C *sensor = sensors[idx].sensor;
+		if (!sensor->initSensorDefault())
+		{
+			Serial.print(sensors[idx].name);
+			Serial.println(" initialization failed!");
+			continue;
+		}
+		// The driver owns the interrupt routine, no global flag per sensor is needed
+		sensor->setEventHandler(sensorEvent, &sensors[idx], intPins[idx]);
+		sensor->setBioDataRate(BIO_SENS_RATE_125);
+		sensor->setAlsParam(AMB_SENS_RATE_10, AVG_CONV_4, true);
+		sensor->setLedCurrent(3);
+		sensor->startContinuous(true, false);
+		// ALS only interrupts when it changes by more than 10% or 20 counts, handled by dispatchEvents() as well
+		sensor->setAlsChangeCb(alsChanged);
+		if (!sensor->startAlsEvents(20, 10, INT_CNT_EXC_2))
+		{
+			Serial.print(sensors[idx].name);
+			Serial.println(" ALS events failed!");
+		}
+	}
+}
+
+void loop()
+{
+	// Handle the pending interrupts of all sensors
+	VCNL4020C::dispatchEvents();
+}
@@ -0,0 +1,154 @@
+#include <Arduino.h>
+
+#include <heartRate.h>
+#include <hrNlms.h>
+#include <ppgSynth.h>
+
+/** Sample rate of the synthetic signals */
+#define SAMPLE_RATE 125
+/** Length of each run in seconds */
+#define DURATION_SEC 120
+/** Maximum delay of a detection after the pulse onset in samples (350ms) */
+#define MAX_LAG (SAMPLE_RATE * 35 / 100)
+
+/**
+ * Canceller settings of one run
+ */
+struct SETUP
+{
+	uint8_t numRefs; ///< Reference channels
+	uint8_t taps;	 ///< Taps per reference channel
+};
+
+const SETUP setups[] = {{1, 1}, {1, 4}, {2, 4}, {3, 4}, {3, 8}};
+
+PPG_SYNTH synth;
+PPG_SYNTH_SCORE score(MAX_LAG);
+uint32_t noiseState;
+
+/**
+ * Reference channels and the disturbance they cause in the bio signal
+ * - Accelerometer X, arm swing, couples with a short delay
+ * - Accelerometer Y, slow movement
+ * - Ambient light, changes while the user moves
+ */
+int32_t disturbance(uint32_t n, int32_t *refs)
+{
+	static float lastX[2];
+	float t = (float)n / SAMPLE_RATE;
+	noiseState ^= noiseState << 13;
+	noiseState ^= noiseState >> 17;
+	noiseState ^= noiseState << 5;
+	float accX = 600.0 * sin(2.0 * PI * 1.7 * t) + 400.0 * sin(2.0 * PI * 2.9 * t + 1.0) + (float)(noiseState % 200) - 100.0;
+	float accY = 500.0 * sin(2.0 * PI * 0.9 * t + 2.0);
+	float als = 300.0 * sin(2.0 * PI * 0.5 * t);
+	if (n == 0)
+	{
+		lastX[0] = accX;
+		lastX[1] = accX;
+	}
+	float coupled = 0.5 * accX + 0.3 * lastX[0] + 0.15 * lastX[1] + 0.6 * accY + 0.5 * als;
+	lastX[1] = lastX[0];
+	lastX[0] = accX;
+	refs[0] = (int32_t)accX;
+	refs[1] = (int32_t)accY;
+	refs[2] = 20000 + (int32_t)als;
+	return (int32_t)coupled;
+}
+
+/**
+ * Run the disturbed signal through the canceller and the beat detection
+ * @param nlms
+ * 		Canceller, NULL to run the beat detection on the disturbed signal
+ * @param detect
+ * 		FALSE to only generate the signals, for the timing
+ * @return time in microseconds
+ */
+uint32_t run(HR_NLMS *nlms, bool detect)
+{
+	HEART_RATE hr;
+	hr.setSamplePeriod(1000000UL / SAMPLE_RATE);
+	PPG_SYNTH_CONFIG config;
+	PPG_SYNTH::getPreset(0, &config, SAMPLE_RATE);
+	synth.begin(config);
+	score.reset();
+	noiseState = 1;
+	uint32_t numSamples = (uint32_t)SAMPLE_RATE * DURATION_SEC;
+	int32_t refs[3];
+	uint32_t start = micros();
+	for (uint32_t n = 0; n < numSamples; n++)
+	{
+		int32_t sample = synth.next() + disturbance(n, refs);
+		if (synth.isBeat())
+		{
+			uint32_t interval = synth.getBeatInterval();
+			score.addTruth(n, interval ? (60.0 * SAMPLE_RATE / interval) : 0.0);
+		}
+		if (nlms != NULL)
+		{
+			sample = nlms->process(sample, refs);
+		}
+		if (detect && hr.checkForBeat(sample))
+		{
+			score.addDetection(n, hr.getLastHR());
+		}
+	}
+	uint32_t elapsed = micros() - start;
+	score.finish(numSamples);
+	return elapsed;
+}
+
+void printScore(void)
+{
+	Serial.print(score.getTruePos());
+	Serial.print(", ");
+	Serial.print(score.getFalsePos());
+	Serial.print(", ");
+	Serial.print(score.getFalseNeg());
+	Serial.print(", ");
+	Serial.print(score.getF1(), 3);
+	Serial.print(", ");
+	Serial.print(score.getBpmError());
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	delay(1000);
+
+	Serial.println(F("HR_NLMS noise canceller benchmark"));
+	Serial.println(F("refs, taps, truePos, falsePos, falseNeg, F1, BPM error, us/sample, cycles/sample"));
+
+	uint32_t numSamples = (uint32_t)SAMPLE_RATE * DURATION_SEC;
+	uint32_t base = run(NULL, false);
+	run(NULL, true);
+	Serial.print(F("0, 0, "));
+	printScore();
+	Serial.println(F(", 0, 0"));
+
+	for (uint8_t s = 0; s < sizeof(setups) / sizeof(setups[0]); s++)
+	{
+		HR_NLMS nlmsTimed(setups[s].numRefs, setups[s].taps);
+		float usPerSample = (float)(run(&nlmsTimed, false) - base) / numSamples;
+		HR_NLMS nlms(setups[s].numRefs, setups[s].taps);
+		run(&nlms, true);
+#ifdef F_CPU
+		float cyclesPerSample = usPerSample * (F_CPU / 1000000UL);
+#else
+		float cyclesPerSample = 0.0;
+#endif
+		Serial.print(setups[s].numRefs);
+		Serial.print(", ");
+		Serial.print(setups[s].taps);
+		Serial.print(", ");
+		printScore();
+		Serial.print(", ");
+		Serial.print(usPerSample);
+		Serial.print(", ");
+		Serial.println(cyclesPerSample, 0);
+	}
+}
+
+void loop()
+{
+}
@@ -0,0 +1,97 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+#include <heartRate.h>
+#include <ppgPipeline.h>
+
+#ifdef ESP32
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+
+int vcnlIntPin = 15;
+
+HEART_RATE hr;
+
+/**
+ * Sample source for the acquisition task
+ * Reads the bio value if the data ready interrupt is set
+ */
+bool readSample(void *ctx, PPG_SAMPLE *sample)
+{
+	if (!ppg1.checkBioInt())
+	{
+		return false;
+	}
+	sample->timestamp = micros();
+	sample->value = ppg1.getBioValue();
+	return sample->value != 0xFFFF;
+}
+
+PPG_PIPELINE pipeline(readSample, NULL);
+
+/**
+ * Result callback, runs in the processing task
+ */
+void handleResult(void *ctx, const PPG_SAMPLE &sample, bool beat)
+{
+	if (beat)
+	{
+		Serial.printf("Beat at %lu us, heart rate %d (%d%%)\n", (unsigned long)sample.timestamp, hr.getSmoothedHR(), hr.getHRConfidence());
+	}
+}
+
+void IRAM_ATTR ppg1IntHandler(void)
+{
+	pipeline.notifyFromISR();
+}
+
+void setup()
+{
+	Serial.begin(115200);
+
+	// Initialize sensor
+	if (!ppg1.initSensorDefault())
+	{
+		Serial.println("VCNL4020C initialization failed!");
+	}
+
+	// Set interrupt pin and callback function
+	ppg1.setInterruptCb(ppg1IntHandler, vcnlIntPin);
+
+	// Set bio sensor data rate
+	ppg1.setBioDataRate(BIO_SENS_RATE_250);
+	// Set LED current
+	ppg1.setLedCurrent(3);
+
+	hr.setSamplePeriod(4000);
+	hr.setDecimation(4);
+	pipeline.setHeartRate(&hr);
+	pipeline.setResultCb(handleResult, NULL);
+
+	// Acquisition on core 0, processing on core 1
+	if (!pipeline.begin(0, 1))
+	{
+		Serial.println("Starting pipeline failed!");
+	}
+
+	// Start continuous measurement with Bio sensor only
+	ppg1.startContinuous(true, false);
+}
+
+void loop()
+{
+	delay(10000);
+	Serial.printf("Acquired %lu, dropped %lu, processed %lu, max queue depth %d\n",
+				  (unsigned long)pipeline.getAcquired(), (unsigned long)pipeline.getDropped(),
+				  (unsigned long)pipeline.getProcessed(), pipeline.getMaxDepth());
+}
+#else
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println("This example needs a dual core ESP32");
+}
+
+void loop()
+{
+}
+#endif
@@ -0,0 +1,136 @@
+#include <Arduino.h>
+
+#include <heartRate.h>
+
+/** Sample rate of the synthetic signal */
+#define SAMPLE_RATE 125
+/** Number of samples per run (60 seconds) */
+#define NUM_SAMPLES (SAMPLE_RATE * 60)
+/** Beats of two policies closer than this (in samples) count as the same beat */
+#define MATCH_WINDOW 3
+
+/**
+ * Result of one policy over the synthetic signal
+ */
+struct RESULT
+{
+	uint16_t beats;	   ///< Detected beats
+	uint16_t matches;  ///< Beats with a Q15 beat within MATCH_WINDOW
+	float usPerSample; ///< Time of checkForBeat() per sample
+};
+
+/**
+ * Synthetic PPG sample, fundamental plus 2nd harmonic on a DC level near full scale
+ */
+int32_t syntheticSample(uint32_t n, float bpm, int32_t dcLevel)
+{
+	float phase = 2.0 * PI * bpm / 60.0 * n / SAMPLE_RATE;
+	return dcLevel + (int32_t)(150.0 * sin(phase) + 60.0 * sin(2.0 * phase + 1.0)) + (int32_t)random(20);
+}
+
+/**
+ * Run a policy side by side with Q15 over the synthetic signal
+ * Both detectors are new for every run, the beats are matched while they are detected,
+ * so only the two detectors and no beat lists need RAM.
+ */
+template <class POLICY>
+void comparePolicy(float bpm, int32_t dcLevel, RESULT *q15, RESULT *other)
+{
+	HEART_RATE_T<HR_POLICY_Q15> hrQ15;
+	HEART_RATE_T<POLICY> hr;
+	hrQ15.setSamplePeriod(1000000 / SAMPLE_RATE);
+	hr.setSamplePeriod(1000000 / SAMPLE_RATE);
+	randomSeed(1);
+
+	memset(q15, 0, sizeof(RESULT));
+	memset(other, 0, sizeof(RESULT));
+	int32_t lastQ15 = -1;
+	int32_t pending = -1;
+	uint32_t elapsedQ15 = 0;
+	uint32_t elapsed = 0;
+	for (uint32_t n = 0; n < NUM_SAMPLES; n++)
+	{
+		int32_t sample = syntheticSample(n, bpm, dcLevel);
+		uint32_t start = micros();
+		bool beatQ15 = hrQ15.checkForBeat(sample);
+		elapsedQ15 += micros() - start;
+		start = micros();
+		bool beat = hr.checkForBeat(sample);
+		elapsed += micros() - start;
+
+		if (beatQ15)
+		{
+			q15->beats++;
+			lastQ15 = n;
+			// A beat of the policy up to MATCH_WINDOW samples earlier
+			if ((pending >= 0) && ((uint32_t)pending + MATCH_WINDOW >= n))
+			{
+				other->matches++;
+				pending = -1;
+			}
+		}
+		if (beat)
+		{
+			other->beats++;
+			if ((lastQ15 >= 0) && ((uint32_t)lastQ15 + MATCH_WINDOW >= n))
+			{
+				other->matches++;
+			}
+			else
+			{
+				// Wait for a Q15 beat up to MATCH_WINDOW samples later
+				pending = n;
+			}
+		}
+	}
+	q15->matches = q15->beats;
+	q15->usPerSample = (float)elapsedQ15 / NUM_SAMPLES;
+	other->usPerSample = (float)elapsed / NUM_SAMPLES;
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	delay(1000);
+
+	Serial.println(F("HEART_RATE arithmetic policy benchmark"));
+	Serial.println(F("bpm, dc, beats Q15, beats Q31, beats float, Q31 match, float match, us/sample Q15, us/sample Q31, us/sample float"));
+
+	float rates[] = {55.0, 80.0, 140.0};
+	int32_t levels[] = {20000, 50000, 64000};
+	for (uint8_t r = 0; r < 3; r++)
+	{
+		for (uint8_t l = 0; l < 3; l++)
+		{
+			RESULT resQ15;
+			RESULT resQ31;
+			RESULT resFloat;
+			comparePolicy<HR_POLICY_Q31>(rates[r], levels[l], &resQ15, &resQ31);
+			comparePolicy<HR_POLICY_FLOAT>(rates[r], levels[l], &resQ15, &resFloat);
+
+			Serial.print(rates[r]);
+			Serial.print(F(", "));
+			Serial.print(levels[l]);
+			Serial.print(F(", "));
+			Serial.print(resQ15.beats);
+			Serial.print(F(", "));
+			Serial.print(resQ31.beats);
+			Serial.print(F(", "));
+			Serial.print(resFloat.beats);
+			Serial.print(F(", "));
+			Serial.print(resQ31.matches);
+			Serial.print(F(", "));
+			Serial.print(resFloat.matches);
+			Serial.print(F(", "));
+			Serial.print(resQ15.usPerSample);
+			Serial.print(F(", "));
+			Serial.print(resQ31.usPerSample);
+			Serial.print(F(", "));
+			Serial.println(resFloat.usPerSample);
+		}
+	}
+}
+
+void loop()
+{
+}
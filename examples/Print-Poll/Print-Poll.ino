@@ -14,11 +14,11 @@ VCNL4020C ppg1(&i2cWire1, VCNL4020C_ADDR);
 VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
 #endif
 
-uint8_t regVal1;
-uint8_t regVal2;
 uint16_t regValL1;
 uint16_t regValL2;
 
+VCNL4020C_SNAPSHOT snapshot;
+
 bool ppgHasData = false;
 
 HEART_RATE hr;
@@ -49,70 +49,16 @@ void setup()
 	Serial.println("+++++++++++++++++++++++++++++++++++");
 	Serial.println("Default values after initialization");
 	Serial.println("+++++++++++++++++++++++++++++++++++");
-	// Get DevID and RevID
-	if (!ppg1.getIds(&regVal1, &regVal2))
-	{
-		Serial.println("Reading ID register failed!");
-	}
-	else
-	{
-		Serial.println("Got DevID " + String(regVal1) + ", RevID " + String(regVal2));
-	}
-
-	// Get current command register settings
-	if (!ppg1.getCmdReg(&regVal1))
-	{
-		Serial.println("Reading command register failed!");
-	}
-	else
-	{
-		Serial.println("Self timed measures " + String(((regVal1 & SELF_TIMED_EN) == SELF_TIMED_EN ? "enabled" : "disabled")));
-		Serial.println("Continuous bio measurement " + String(((regVal1 & PER_BIO_MEAS_EN) == PER_BIO_MEAS_EN ? "active" : "inactive")));
-		Serial.println("Continuous als measurement " + String(((regVal1 & PER_ALS_MEAS_EN) == PER_ALS_MEAS_EN ? "active" : "inactive")));
-		Serial.println("Single bio measurement " + String(((regVal1 & START_BIO_MES) == START_BIO_MES ? "active" : "inactive")));
-		Serial.println("Single als measurement " + String(((regVal1 & START_ALS_MES) == START_ALS_MES ? "active" : "inactive")));
-	}
-	// Get current bio sensor data rate
-	if (!ppg1.getBioDataRate(&regVal1))
-	{
-		Serial.println("Reading bio data rate failed!");
-	}
-	else
+	// Read all registers in one transaction and print them
+	if (!ppg1.readSnapshot(&snapshot))
 	{
-		String sensRates[] = {"1.95", "3.90625", "7.8125", "16.625", "31.25", "62.5", "125", "250"};
-		if (regVal1 > 7)
-		{
-			Serial.println("Got invalid bio sensor rate");
-		}
-		else
-		{
-			Serial.println("Bio sensor data rate is " + sensRates[regVal1] + "measures/s");
-		}
-	}
-	// Get LED current setting
-	regVal1 = ppg1.getLedCurrent();
-	if (regVal1 > 20)
-	{
-		Serial.println("Got invalid LED current");
+		Serial.println("Reading registers failed!");
 	}
 	else
 	{
-		Serial.println("LED current is " + String(regVal1 * 10) + " mA");
-	}
-
-	// Get ambient light sensor settings
-	if (!ppg1.getAlsParam(&regVal1))
-	{
-		Serial.println("Reading ALS settings failed");
-	}
-	else
-	{
-		uint8_t alsRates[] = {1, 2, 3, 4, 5, 6, 8, 10};
-		regVal2 = (regVal1 & 0b0111000) >> 4;
-		Serial.println("ALS data rate " + String(alsRates[regVal2]) + " samples/s");
-		Serial.println("Auto offset compensation is " + String(((regVal1 & AUTO_COMP_ENA) == AUTO_COMP_ENA ? "enabled" : "disabled")));
-		regVal2 = regVal1 & 0b00000011;
-		Serial.println("Averaging count is " + String(pow(2, regVal2)));
+		ppg1.printSnapshot(Serial, snapshot);
+		// Same snapshot as JSON
+		ppg1.printSnapshot(Serial, snapshot, true);
 	}
 
 	Serial.println("+++++++++++++++++++++++++++++++++++");
@@ -161,7 +107,8 @@ void setup()
 			}
 			else
 			{
-				Serial.println("Got Bio value " + regValL1);
+				Serial.print("Got Bio value ");
+				Serial.println(regValL1);
 			}
 			if (regValL2 == 0xFFFF)
 			{
@@ -169,7 +116,8 @@ void setup()
 			}
 			else
 			{
-				Serial.println("Got ALS value " + regValL2);
+				Serial.print("Got ALS value ");
+				Serial.println(regValL2);
 			}
 		}
 	}
@@ -194,11 +142,15 @@ void loop()
 	if (ppg1.bioDataReady())
 	{
 		bioVal = ppg1.getBioValue();
-		if (hr.checkForBeat(bioVal))
-		{
-			beatsPerMinute = hr.getLastHR();
-		}
-		Serial.println("Bio value " + String(bioVal) + " Heartrate " + String(beatsPerMinute));
+		hr.checkForBeat(bioVal);
+		beatsPerMinute = hr.getSmoothedHR();
+		Serial.print("Bio value ");
+		Serial.print(bioVal);
+		Serial.print(" Heartrate ");
+		Serial.print(beatsPerMinute);
+		Serial.print(" (");
+		Serial.print(hr.getHRConfidence());
+		Serial.println("%)");
 	}
 
 	// Attempt to auto-adjust LED current
@@ -0,0 +1,79 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+#include <heartRate.h>
+
+/**
+ * Pulse morphology features per beat.
+ * HR_MORPH is attached to the beat detection and prints one CSV line per beat:
+ * beat sample, BPM, amplitude, rise time, duration, max slope, notch delay,
+ * notch height in percent, notch type (1 = local minimum, 2 = inflection), area.
+ * Times are in samples of 8 ms (125 Hz).
+ * The first beat has no record, its pulse is not complete yet.
+ */
+
+#ifdef NRF52_SERIES
+#define SDA1 18 // I2C 1 SDA
+#define SCL1 16 // I2C 1 SCL
+
+TwoWire i2cWire1 = TwoWire(NRF_TWIM0, NRF_TWIS0, SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, SDA1, SCL1);
+
+VCNL4020C ppg1(&i2cWire1, VCNL4020C_ADDR);
+#else
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+#endif
+
+HEART_RATE hr;
+HR_MORPH morph;
+
+void setup()
+{
+	Serial.begin(115200);
+
+	// Initialize sensor
+	if (!ppg1.initSensorDefault())
+	{
+		Serial.println(F("Sensor initialization failed!"));
+	}
+
+	// Set bio sensor data rate, the beat timing is derived from the sample count
+	ppg1.setBioDataRate(BIO_SENS_RATE_125);
+	hr.setSamplePeriod(8000);
+	hr.setMorph(&morph);
+
+	Serial.println(F("sample,bpm,amplitude,rise,duration,slope,notchDelay,notchHeight,notchType,area"));
+
+	// Start continuous measurement with Bio sensor only
+	ppg1.startContinuous(true, false);
+}
+
+void loop()
+{
+	HR_MORPH_FEATURES f;
+
+	if (ppg1.bioDataReady())
+	{
+		if (hr.checkForBeat(ppg1.getBioValue()) && morph.getFeatures(&f))
+		{
+			Serial.print(f.beatSample);
+			Serial.print(',');
+			Serial.print(hr.getSmoothedHR());
+			Serial.print(',');
+			Serial.print(f.amplitude);
+			Serial.print(',');
+			Serial.print(f.riseTime);
+			Serial.print(',');
+			Serial.print(f.duration);
+			Serial.print(',');
+			Serial.print(f.maxSlope);
+			Serial.print(',');
+			Serial.print(f.notchDelay);
+			Serial.print(',');
+			Serial.print(f.notchHeight);
+			Serial.print(',');
+			Serial.print(f.notchType);
+			Serial.print(',');
+			Serial.println(f.area);
+		}
+	}
+}
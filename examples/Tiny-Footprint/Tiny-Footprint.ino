@@ -0,0 +1,86 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+#include <heartRate.h>
+
+/**
+ * Heart rate with polling, the smallest use of the library.
+ * Build with the tiny profile (PPG_TINY, see ppgConfig.h) for uno, leonardo or mega2560.
+ * The flash and static RAM of the build are printed by the compiler:
+ *   "Sketch uses ... bytes of program storage space"
+ *   "Global variables use ... bytes of dynamic memory"
+ * extras/tools/footprint/footprint.sh builds this sketch for every AVR board
+ * with and without the tiny profile and lists both numbers.
+ * At startup the sketch prints the size of the objects and on AVR the free RAM.
+ */
+
+#ifdef NRF52_SERIES
+#define SDA1 18 // I2C 1 SDA
+#define SCL1 16 // I2C 1 SCL
+
+TwoWire i2cWire1 = TwoWire(NRF_TWIM0, NRF_TWIS0, SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, SDA1, SCL1);
+
+VCNL4020C ppg1(&i2cWire1, VCNL4020C_ADDR);
+#else
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+#endif
+
+HEART_RATE hr;
+
+#ifdef __AVR__
+extern int __heap_start, *__brkval;
+
+/**
+ * Free RAM between heap and stack
+ * @return free RAM in bytes
+ */
+int freeRam(void)
+{
+	int top;
+	return (int)&top - (__brkval == 0 ? (int)&__heap_start : (int)__brkval);
+}
+#endif
+
+void setup()
+{
+	Serial.begin(115200);
+
+#ifdef PPG_TINY
+	Serial.println(F("Profile tiny"));
+#else
+	Serial.println(F("Profile full"));
+#endif
+	Serial.print(F("sizeof(VCNL4020C) "));
+	Serial.println((unsigned int)sizeof(VCNL4020C));
+	Serial.print(F("sizeof(HEART_RATE) "));
+	Serial.println((unsigned int)sizeof(HEART_RATE));
+#ifdef __AVR__
+	Serial.print(F("Free RAM "));
+	Serial.println(freeRam());
+#endif
+
+	// Initialize sensor
+	if (!ppg1.initSensorDefault())
+	{
+		Serial.println(F("Sensor initialization failed!"));
+	}
+
+	// Set bio sensor data rate, the beat timing is derived from the sample count
+	ppg1.setBioDataRate(BIO_SENS_RATE_125);
+	hr.setSamplePeriod(8000);
+
+	// Start continuous measurement with Bio sensor only
+	ppg1.startContinuous(true, false);
+}
+
+void loop()
+{
+	if (ppg1.bioDataReady())
+	{
+		if (hr.checkForBeat(ppg1.getBioValue()))
+		{
+			Serial.print(F("BPM "));
+			Serial.println(hr.getSmoothedHR());
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#include <Arduino.h>
+
+#include <vcnl4020c.h>
+
+#ifdef ESP32
+VCNL4020C ppg1(&Wire, VCNL4020C_ADDR);
+
+/** Sensor configuration, kept in RTC memory during deep sleep */
+RTC_DATA_ATTR uint8_t savedConfig[VCNL4020C_CONFIG_SIZE];
+/** Flag if savedConfig holds a configuration */
+RTC_DATA_ATTR bool configValid = false;
+/** Number of wake ups */
+RTC_DATA_ATTR uint32_t bootCount = 0;
+
+bool storeConfig(const uint8_t *data, uint8_t len)
+{
+	memcpy(savedConfig, data, len);
+	configValid = true;
+	return true;
+}
+
+bool loadConfig(uint8_t *data, uint8_t len)
+{
+	if (!configValid)
+	{
+		return false;
+	}
+	memcpy(data, savedConfig, len);
+	return true;
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	bootCount++;
+
+	ppg1.setConfigStorage(storeConfig, loadConfig);
+
+	// The sensor stays powered during deep sleep, restore the configuration without startup delay
+	if (ppg1.warmStart(false, true))
+	{
+		Serial.printf("Wake up %lu: warm start in %lu us\n", (unsigned long)bootCount, (unsigned long)ppg1.getStartupTime());
+	}
+	else
+	{
+		// No saved configuration, do a full initialization
+		if (!ppg1.initSensorDefault())
+		{
+			Serial.println("Sensor initialization failed!");
+		}
+		ppg1.setBioDataRate(BIO_SENS_RATE_125);
+		ppg1.setLedCurrent(3);
+		ppg1.startContinuous(true, false);
+		ppg1.saveConfig();
+		Serial.printf("Wake up %lu: cold start in %lu us\n", (unsigned long)bootCount, (unsigned long)ppg1.getStartupTime());
+	}
+
+	// Read a few samples
+	uint8_t samples = 0;
+	time_t startTimeout = millis();
+	while ((samples < 10) && ((millis() - startTimeout) < 1000))
+	{
+		if (ppg1.bioDataReady())
+		{
+			Serial.println(ppg1.getBioValue());
+			samples++;
+		}
+	}
+
+	// Sleep 5 seconds
+	esp_sleep_enable_timer_wakeup(5000000);
+	esp_deep_sleep_start();
+}
+
+void loop()
+{
+}
+#else
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println("This example needs an ESP32 with RTC memory");
+}
+
+void loop()
+{
+}
+#endif
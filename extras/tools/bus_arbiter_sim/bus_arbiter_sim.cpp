@@ -0,0 +1,415 @@
+/**
+ * @file bus_arbiter_sim.cpp
+ * @brief Check of BUS_ARBITER with simulated PPG, IMU and display clients
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * The clients are threads that hold the bus for a simulated transfer time.
+ * Every grant is logged in order, a counter checks that never two clients
+ * own the bus at the same time. The scenarios check:
+ * - priority: PPG before IMU before display after the bus is released
+ * - deadline: clients of the same priority in deadline order, clients
+ *   without deadline last, a grant after the deadline is counted as miss
+ * - preemption: a chunked display transfer hands the bus to the PPG
+ *   sensor between two chunks, the PPG waits at most about one chunk
+ * - statistics: acquisitions, timeouts and wait times match the log
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -pthread -I../../../src bus_arbiter_sim.cpp ../../../src/busArbiter.cpp ../../../src/ppgThread.cpp ../../../src/ppgPlatform.cpp -o bus_arbiter_sim
+ *
+ * Usage:
+ * bus_arbiter_sim [-n rounds]
+ */
+
+#include <busArbiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Time for the waiting clients to queue up before the bus is released */
+#define SIM_SETTLE_MS 20
+/** Simulated transfer time of a short register access */
+#define SIM_ACCESS_US 300
+/** Simulated transfer time of one display chunk */
+#define SIM_CHUNK_US 2000
+/** Number of display chunks */
+#define SIM_CHUNKS 40
+
+/**
+ * Simulated bus, logs the grants and checks the mutual exclusion
+ */
+struct SIM_BUS
+{
+	BUS_ARBITER arbiter;				///< Arbiter under test
+	std::atomic<int> owners;			///< Clients inside a transfer, must never be above 1
+	std::atomic<uint32_t> collisions;	///< Transfers that found another owner
+	std::mutex logLock;					///< Protects log
+	std::vector<std::string> log;		///< Names of the clients in grant order
+
+	SIM_BUS(void) : owners(0), collisions(0)
+	{
+	}
+
+	/**
+	 * Simulated transfer of a client that owns the bus
+	 */
+	void transfer(const char *name, uint32_t us)
+	{
+		if (owners.fetch_add(1) != 0)
+		{
+			collisions++;
+		}
+		{
+			std::lock_guard<std::mutex> guard(logLock);
+			log.push_back(name);
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(us));
+		owners.fetch_sub(1);
+	}
+
+	/**
+	 * One register access of a client: acquire, transfer, release
+	 * @return TRUE if the bus was granted
+	 */
+	bool access(int8_t client, uint32_t deadlineUs, uint32_t timeoutMs, uint32_t us)
+	{
+		if (!arbiter.acquire(client, deadlineUs, timeoutMs))
+		{
+			return false;
+		}
+		transfer(arbiter.getName(client), us);
+		arbiter.release(client);
+		return true;
+	}
+};
+
+static uint32_t failed = 0;
+
+/**
+ * Report a failed check
+ */
+static void fail(const char *scenario, const char *what)
+{
+	printf("  FAIL %s: %s\n", scenario, what);
+	failed++;
+}
+
+/**
+ * Compare the grant log with the expected order
+ */
+static void checkOrder(const char *scenario, SIM_BUS &bus, const std::vector<std::string> &expected)
+{
+	std::string got;
+	std::string want;
+	for (size_t idx = 0; idx < bus.log.size(); idx++)
+	{
+		got += (idx ? " " : "") + bus.log[idx];
+	}
+	for (size_t idx = 0; idx < expected.size(); idx++)
+	{
+		want += (idx ? " " : "") + expected[idx];
+	}
+	if (got != want)
+	{
+		printf("  FAIL %s: grant order \"%s\", expected \"%s\"\n", scenario, got.c_str(), want.c_str());
+		failed++;
+	}
+	if (bus.collisions != 0)
+	{
+		fail(scenario, "two clients owned the bus at the same time");
+	}
+}
+
+/**
+ * The display holds the bus, IMU, fuel gauge and PPG queue up in this order.
+ * On release the bus goes to PPG, IMU, gauge, i.e. by priority and not by arrival.
+ */
+static void checkPriority(void)
+{
+	SIM_BUS bus;
+	int8_t display = bus.arbiter.addClient("display", 1);
+	int8_t gauge = bus.arbiter.addClient("gauge", 1);
+	int8_t imu = bus.arbiter.addClient("imu", 5);
+	int8_t ppg = bus.arbiter.addClient("ppg", 10);
+
+	bus.arbiter.acquire(display);
+	bus.transfer("display", 0);
+	std::vector<std::thread> pool;
+	int8_t arrivals[] = {imu, gauge, ppg};
+	for (size_t idx = 0; idx < sizeof(arrivals); idx++)
+	{
+		int8_t client = arrivals[idx];
+		pool.push_back(std::thread([&bus, client] { bus.access(client, 0, 1000, SIM_ACCESS_US); }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(SIM_SETTLE_MS));
+	}
+	bus.arbiter.release(display);
+	for (size_t idx = 0; idx < pool.size(); idx++)
+	{
+		pool[idx].join();
+	}
+	checkOrder("priority", bus, {"display", "ppg", "imu", "gauge"});
+
+	// Wait statistics, the later arrivals waited shorter
+	BUS_ARBITER_STATS ppgStats;
+	BUS_ARBITER_STATS imuStats;
+	BUS_ARBITER_STATS gaugeStats;
+	bus.arbiter.getStats(ppg, &ppgStats);
+	bus.arbiter.getStats(imu, &imuStats);
+	bus.arbiter.getStats(gauge, &gaugeStats);
+	if ((ppgStats.acquisitions != 1) || (imuStats.acquisitions != 1) || (gaugeStats.acquisitions != 1))
+	{
+		fail("priority", "every client must have one acquisition");
+	}
+	if ((imuStats.maxWaitUs <= ppgStats.maxWaitUs) || (imuStats.maxWaitUs < 2 * SIM_SETTLE_MS * 1000))
+	{
+		fail("priority", "the imu arrived first and must have waited longest");
+	}
+	if ((ppgStats.totalWaitUs != ppgStats.maxWaitUs) || (ppgStats.timeouts != 0) || (ppgStats.deadlineMisses != 0))
+	{
+		fail("priority", "ppg statistics inconsistent");
+	}
+}
+
+/**
+ * Four PPG sensors of the same priority queue up, one without deadline first,
+ * then with 300, 100 and 200 ms. The bus goes in deadline order, the one
+ * without deadline last. A fifth sensor with a 1 ms deadline waits behind
+ * a long transfer and misses it.
+ */
+static void checkDeadline(void)
+{
+	SIM_BUS bus;
+	int8_t holder = bus.arbiter.addClient("holder", 10);
+	int8_t none = bus.arbiter.addClient("none", 10);
+	int8_t late = bus.arbiter.addClient("d300", 10);
+	int8_t early = bus.arbiter.addClient("d100", 10);
+	int8_t middle = bus.arbiter.addClient("d200", 10);
+
+	bus.arbiter.acquire(holder);
+	bus.transfer("holder", 0);
+	std::vector<std::thread> pool;
+	int8_t arrivals[] = {none, late, early, middle};
+	uint32_t deadlines[] = {0, 300000, 100000, 200000};
+	for (size_t idx = 0; idx < sizeof(arrivals); idx++)
+	{
+		int8_t client = arrivals[idx];
+		uint32_t deadline = deadlines[idx];
+		pool.push_back(std::thread([&bus, client, deadline] { bus.access(client, deadline, 1000, SIM_ACCESS_US); }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(SIM_SETTLE_MS));
+	}
+	bus.arbiter.release(holder);
+	for (size_t idx = 0; idx < pool.size(); idx++)
+	{
+		pool[idx].join();
+	}
+	checkOrder("deadline", bus, {"holder", "d100", "d200", "d300", "none"});
+
+	BUS_ARBITER_STATS stats;
+	for (size_t idx = 0; idx < sizeof(arrivals); idx++)
+	{
+		bus.arbiter.getStats(arrivals[idx], &stats);
+		if (stats.deadlineMisses != 0)
+		{
+			fail("deadline", "deadline miss counted for a grant in time");
+		}
+	}
+
+	// Deadline of 1 ms behind a transfer of SIM_SETTLE_MS
+	int8_t missed = bus.arbiter.addClient("missed", 10);
+	bus.arbiter.acquire(holder);
+	std::thread waiter([&bus, missed] { bus.access(missed, 1000, 1000, SIM_ACCESS_US); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(SIM_SETTLE_MS));
+	bus.arbiter.release(holder);
+	waiter.join();
+	bus.arbiter.getStats(missed, &stats);
+	if ((stats.acquisitions != 1) || (stats.deadlineMisses != 1))
+	{
+		fail("deadline", "grant after the deadline not counted as miss");
+	}
+}
+
+/**
+ * Context of the chunked display transfer
+ */
+struct DISPLAY_CTX
+{
+	SIM_BUS *bus;		 ///< Simulated bus
+	uint32_t chunks;	 ///< Chunks transferred
+	uint32_t lastOffset; ///< Offset of the previous chunk
+	bool ordered;		 ///< Flag if the chunks came in order
+};
+
+static bool sendChunk(void *ctx, uint32_t offset, uint16_t len)
+{
+	DISPLAY_CTX *display = (DISPLAY_CTX *)ctx;
+	if ((display->chunks != 0) && (offset != display->lastOffset + len))
+	{
+		display->ordered = false;
+	}
+	display->lastOffset = offset;
+	display->chunks++;
+	display->bus->transfer("display", SIM_CHUNK_US);
+	return true;
+}
+
+/**
+ * A chunked display transfer runs while the PPG sensor reads every 5 ms.
+ * The display must give the bus to the PPG between two chunks, so the PPG
+ * never waits for the whole transfer.
+ */
+static void checkPreemption(void)
+{
+	SIM_BUS bus;
+	int8_t ppg = bus.arbiter.addClient("ppg", 10);
+	int8_t display = bus.arbiter.addClient("display", 1);
+	DISPLAY_CTX ctx = {&bus, 0, 0, true};
+
+	std::atomic<bool> running(true);
+	uint32_t reads = 0;
+	uint32_t readTimeouts = 0;
+	std::thread sensor([&] {
+		while (running)
+		{
+			if (bus.access(ppg, 0, 1000, SIM_ACCESS_US))
+			{
+				reads++;
+			}
+			else
+			{
+				readTimeouts++;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	bool done = bus.arbiter.transferChunked(display, sendChunk, &ctx, SIM_CHUNKS * 32, 32);
+	running = false;
+	sensor.join();
+
+	if (!done || (ctx.chunks != SIM_CHUNKS) || !ctx.ordered)
+	{
+		fail("preemption", "display transfer incomplete or out of order");
+	}
+	if (bus.collisions != 0)
+	{
+		fail("preemption", "two clients owned the bus at the same time");
+	}
+
+	// PPG reads between the first and the last display chunk
+	size_t first = bus.log.size();
+	size_t last = 0;
+	for (size_t idx = 0; idx < bus.log.size(); idx++)
+	{
+		if (bus.log[idx] == "display")
+		{
+			first = (idx < first) ? idx : first;
+			last = idx;
+		}
+	}
+	uint32_t between = 0;
+	for (size_t idx = first; idx < last; idx++)
+	{
+		if (bus.log[idx] == "ppg")
+		{
+			between++;
+		}
+	}
+	BUS_ARBITER_STATS displayStats;
+	BUS_ARBITER_STATS ppgStats;
+	bus.arbiter.getStats(display, &displayStats);
+	bus.arbiter.getStats(ppg, &ppgStats);
+	printf("  display %u chunks, %u preemptions, ppg %u reads during the transfer, ppg max wait %u us\n", ctx.chunks,
+		   displayStats.preemptions, between, ppgStats.maxWaitUs);
+	if ((displayStats.preemptions == 0) || (between < displayStats.preemptions))
+	{
+		fail("preemption", "the display did not give the bus to the ppg between chunks");
+	}
+	// Every preemption is one more acquisition of the display
+	if (displayStats.acquisitions != displayStats.preemptions + 1)
+	{
+		fail("preemption", "display acquisitions do not match its preemptions");
+	}
+	if ((ppgStats.acquisitions != reads) || (ppgStats.timeouts != readTimeouts) || (readTimeouts != 0))
+	{
+		fail("preemption", "ppg statistics do not match its reads");
+	}
+	// Without preemption the ppg would wait for the whole transfer
+	if (ppgStats.maxWaitUs >= (SIM_CHUNKS / 2) * SIM_CHUNK_US)
+	{
+		fail("preemption", "ppg waited for most of the display transfer");
+	}
+}
+
+/**
+ * A client gives up after its timeout while another one holds the bus,
+ * the timeout is counted and the bus is not granted to it later.
+ */
+static void checkTimeout(void)
+{
+	SIM_BUS bus;
+	int8_t display = bus.arbiter.addClient("display", 1);
+	int8_t imu = bus.arbiter.addClient("imu", 5);
+
+	bus.arbiter.acquire(display);
+	bool granted = bus.arbiter.acquire(imu, 0, 5);
+	bus.arbiter.release(display);
+	BUS_ARBITER_STATS stats;
+	bus.arbiter.getStats(imu, &stats);
+	if (granted || (stats.timeouts != 1) || (stats.acquisitions != 0))
+	{
+		fail("timeout", "timeout not reported or not counted");
+	}
+	// The bus must be free again for the next client
+	if (!bus.arbiter.acquire(display, 0, 5))
+	{
+		fail("timeout", "bus not free after the timed out client");
+	}
+	bus.arbiter.release(display);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t rounds = 3;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-n") == 0) && ((arg + 1) < argc))
+		{
+			rounds = (uint32_t)atol(argv[++arg]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-n rounds]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (rounds == 0)
+	{
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	for (uint32_t round = 1; round <= rounds; round++)
+	{
+		printf("Round %u\n", round);
+		checkPriority();
+		checkDeadline();
+		checkPreemption();
+		checkTimeout();
+	}
+	if (failed != 0)
+	{
+		printf("%u checks failed\n", failed);
+		return 2;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Build bus_arbiter_sim and check BUS_ARBITER with simulated bus clients
+# Usage: bus_arbiter_sim.sh [bus_arbiter_sim options]
+# Exits with the result of bus_arbiter_sim, non-zero if the build or a check failed.
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+SRC=$DIR/../../../src
+BIN=$(mktemp -d)
+trap 'rm -rf "$BIN"' EXIT
+
+g++ -std=c++11 -O2 -pthread -I"$SRC" "$DIR/bus_arbiter_sim.cpp" "$SRC/busArbiter.cpp" "$SRC/ppgThread.cpp" "$SRC/ppgPlatform.cpp" -o "$BIN/bus_arbiter_sim" || exit 1
+"$BIN/bus_arbiter_sim" "$@"
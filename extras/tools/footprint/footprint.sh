@@ -0,0 +1,38 @@
+#!/bin/bash
+# Flash and RAM footprint of the library per board, with and without the tiny profile
+# Usage: footprint.sh [sketch] [fqbn...]
+# Needs arduino-cli with the arduino:avr core and this library installed.
+# Exits non-zero if any build failed.
+
+SKETCH=${1:-$(dirname "$0")/../../../examples/Tiny-Footprint}
+shift
+BOARDS=${@:-arduino:avr:uno arduino:avr:leonardo arduino:avr:mega}
+
+FAILED=0
+printf "%-24s %-8s %10s %10s\n" "board" "profile" "flash" "ram"
+for FQBN in $BOARDS; do
+	for PROFILE in full tiny; do
+		FLAGS=""
+		if [ "$PROFILE" = "tiny" ]; then
+			FLAGS="-DPPG_TINY"
+		fi
+		OUT=$(arduino-cli compile --clean --fqbn "$FQBN" \
+			--build-property "compiler.cpp.extra_flags=$FLAGS" \
+			--build-property "compiler.c.extra_flags=$FLAGS" \
+			"$SKETCH" 2>&1)
+		if [ $? -ne 0 ]; then
+			echo "$OUT"
+			printf "%-24s %-8s %10s %10s\n" "$FQBN" "$PROFILE" "failed" "-"
+			FAILED=$((FAILED + 1))
+			continue
+		fi
+		FLASH=$(echo "$OUT" | sed -n 's/^Sketch uses \([0-9]*\) bytes.*/\1/p')
+		RAM=$(echo "$OUT" | sed -n 's/^Global variables use \([0-9]*\) bytes.*/\1/p')
+		printf "%-24s %-8s %10s %10s\n" "$FQBN" "$PROFILE" "$FLASH" "$RAM"
+	done
+done
+
+if [ $FAILED -ne 0 ]; then
+	echo "$FAILED builds failed"
+	exit 1
+fi
@@ -0,0 +1,193 @@
+/**
+ * @file history_check.cpp
+ * @brief Range query check of SENSOR_HISTORY with long ranges
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * Fills histories with day long signals and compares the range queries
+ * with min, max, count and mean computed directly from the added values:
+ * - 24 hours of 1 Hz heart rate, query over all hourly buckets
+ * - 2 hours and 24 hours of 10 Hz ambient light near full scale,
+ *   the sum of the merged buckets does not fit in 32 bit
+ * - one hour of 20 Hz ambient light, more values than a bucket counts
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -I../../../src history_check.cpp -o history_check
+ *
+ * Usage:
+ * history_check
+ */
+
+#include <sensorHistory.h>
+
+#include <stdio.h>
+
+/** Seconds per hour */
+#define HOUR_SEC 3600UL
+
+/**
+ * Expected aggregate, computed from the added values
+ */
+struct EXPECTED
+{
+	uint16_t min = 0xFFFF; ///< Smallest value
+	uint16_t max = 0;	   ///< Largest value
+	uint32_t count = 0;	   ///< Number of counted values
+	uint64_t sum = 0;	   ///< Sum of the counted values
+
+	void add(uint16_t value, bool counted)
+	{
+		min = (value < min) ? value : min;
+		max = (value > max) ? value : max;
+		if (counted)
+		{
+			count++;
+			sum += value;
+		}
+	}
+
+	uint16_t getMean(void) const
+	{
+		return (count == 0) ? 0 : (uint16_t)((sum + count / 2) / count);
+	}
+};
+
+static uint32_t failed = 0;
+
+/**
+ * Compare a query result with the expected aggregate
+ * @return TRUE if all fields match
+ */
+static bool compare(const char *name, const HISTORY_STATS &stats, const EXPECTED &expected)
+{
+	bool pass = (stats.min == expected.min) && (stats.max == expected.max) && (stats.count == expected.count) &&
+				(stats.sum == expected.sum) && (stats.getMean() == expected.getMean());
+	printf("%-28s min %5u/%5u max %5u/%5u count %7u/%7u mean %5u/%5u %s\n", name, stats.min, expected.min, stats.max, expected.max,
+		   stats.count, expected.count, stats.getMean(), expected.getMean(), pass ? "pass" : "FAIL");
+	if (!pass)
+	{
+		failed++;
+	}
+	return pass;
+}
+
+/**
+ * Heart rate like signal, slow swing between 48 and 171 BPM
+ */
+static uint16_t bpmAt(uint32_t sec)
+{
+	return (uint16_t)(48 + (sec * 7 + (sec / 600) * 13) % 124);
+}
+
+/**
+ * Bright ambient light near full scale
+ */
+static uint16_t alsAt(uint32_t sample)
+{
+	return (uint16_t)(0xFFFF - (sample * 31) % 2000);
+}
+
+/**
+ * 24 hours of 1 Hz values, 86400 values over 24 hourly buckets
+ */
+static void checkHeartRateDay(void)
+{
+	SENSOR_HISTORY history;
+	EXPECTED expected;
+	for (uint32_t sec = 0; sec < 24 * HOUR_SEC; sec++)
+	{
+		history.add(sec, bpmAt(sec));
+		expected.add(bpmAt(sec), true);
+	}
+	HISTORY_STATS stats;
+	uint8_t level = history.query(0, 24 * HOUR_SEC - 1, &stats);
+	compare("1 Hz BPM, 24 h", stats, expected);
+	if (level != HISTORY_HOURS)
+	{
+		printf("1 Hz BPM, 24 h: resolution %u instead of hours FAIL\n", level);
+		failed++;
+	}
+
+	// The hourly series must add up to the same
+	HISTORY_STATS hours[24];
+	uint16_t count = history.getSeries(HISTORY_HOURS, hours, 24);
+	EXPECTED series;
+	for (uint16_t idx = 0; idx < count; idx++)
+	{
+		series.min = (hours[idx].min < series.min) ? hours[idx].min : series.min;
+		series.max = (hours[idx].max > series.max) ? hours[idx].max : series.max;
+		series.count += hours[idx].count;
+		series.sum += hours[idx].sum;
+	}
+	compare("1 Hz BPM, 24 hourly series", stats, series);
+}
+
+/**
+ * 10 Hz values near full scale, the merged sum needs more than 32 bit
+ * @param hours
+ * 		Length of the signal and the query
+ */
+static void checkAmbientLight(uint32_t hours)
+{
+	SENSOR_HISTORY_T<10, 60, 24> history;
+	EXPECTED expected;
+	uint32_t sample = 0;
+	for (uint32_t sec = 0; sec < hours * HOUR_SEC; sec++)
+	{
+		for (uint8_t idx = 0; idx < 10; idx++, sample++)
+		{
+			history.add(sec, alsAt(sample));
+			expected.add(alsAt(sample), true);
+		}
+	}
+	HISTORY_STATS stats;
+	history.query(0, hours * HOUR_SEC - 1, &stats);
+	char name[32];
+	snprintf(name, sizeof(name), "10 Hz ALS, %u h", hours);
+	compare(name, stats, expected);
+}
+
+/**
+ * 20 Hz values for one hour, the hourly bucket counts only the first HISTORY_BUCKET_MAX_COUNT
+ */
+static void checkFullBucket(void)
+{
+	SENSOR_HISTORY history;
+	EXPECTED expected;
+	uint32_t sample = 0;
+	for (uint32_t sec = 0; sec < HOUR_SEC; sec++)
+	{
+		for (uint8_t idx = 0; idx < 20; idx++, sample++)
+		{
+			history.add(sec, alsAt(sample));
+			expected.add(alsAt(sample), sample < HISTORY_BUCKET_MAX_COUNT);
+		}
+	}
+	// Older than the minutes, answered by the hourly bucket
+	history.add(2 * HOUR_SEC, 0);
+	HISTORY_STATS stats;
+	history.query(0, HOUR_SEC - 1, &stats);
+	compare("20 Hz ALS, full hour bucket", stats, expected);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+	{
+		fprintf(stderr, "Usage: %s\n", argv[0]);
+		return 1;
+	}
+	printf("query result/expected\n");
+	checkHeartRateDay();
+	checkAmbientLight(2);
+	checkAmbientLight(24);
+	checkFullBucket();
+	if (failed != 0)
+	{
+		printf("%u checks failed\n", failed);
+		return 2;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Build history_check and check the long range queries of SENSOR_HISTORY
+# Usage: history_check.sh
+# Exits with the result of history_check, non-zero if the build or a check failed.
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+SRC=$DIR/../../../src
+BIN=$(mktemp -d)
+trap 'rm -rf "$BIN"' EXIT
+
+g++ -std=c++11 -O2 -I"$SRC" "$DIR/history_check.cpp" -o "$BIN/history_check" || exit 1
+"$BIN/history_check"
@@ -0,0 +1,486 @@
+/**
+ * @file hr_regression.cpp
+ * @brief Regression of the HEART_RATE beat detection against golden beat tables
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * All PPG_SYNTH presets are run through HEART_RATE for every configuration
+ * (sample rate and decimation). The detected beats are compared with the golden
+ * beat table of the configuration, a beat counts as matched if a golden beat is
+ * within HR_REG_TOLERANCE samples and its heart rate within HR_REG_BPM_TOLERANCE.
+ * The cost of checkForBeat() is measured relative to a fixed Q15 filter kernel,
+ * which keeps the ratio comparable between machines, and compared with the
+ * golden speed ratio. It is measured undecimated at 125 samples/s and with
+ * decimation 4 at 250 samples/s, the decimation must save at least
+ * HR_REG_MIN_DECIM_GAIN per input sample.
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -I../../../src hr_regression.cpp ../../../src/heartRate.cpp ../../../src/bpmSmoother.cpp ../../../src/hrDecimator.cpp ../../../src/hrMorph.cpp ../../../src/ppgSynth.cpp ../../../src/ppgPlatform.cpp -o hr_regression
+ *
+ * Usage:
+ * hr_regression [-d golden dir] [-u] [-e header] [-s]
+ */
+
+#include <heartRate.h>
+#include <ppgSynth.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Length of each signal in seconds */
+#define DURATION_SEC 120
+/** Largest distance of a detected beat from its golden beat in input samples */
+#define HR_REG_TOLERANCE 2
+/** Largest heart rate difference of a matched beat in beats/minute */
+#define HR_REG_BPM_TOLERANCE 2
+/** Lowest share of matched beats per preset */
+#define HR_REG_MIN_AGREEMENT 0.99
+/** Highest accepted slow down of checkForBeat() against the golden speed ratio */
+#define HR_REG_MAX_SLOWDOWN 1.25
+/** Lowest accepted saving per input sample of the decimated speed configuration against the undecimated one */
+#define HR_REG_MIN_DECIM_GAIN 2.0
+/** Repetitions of the speed measurement, the median ratio is used */
+#define HR_REG_SPEED_RUNS 31
+
+/**
+ * Sample rate and decimation of one configuration
+ */
+struct CONFIG
+{
+	uint16_t rate;		///< Samples per second
+	uint8_t decimation; ///< Decimation factor, 1 for off
+};
+
+const CONFIG configs[] = {
+	{125, 1},
+	{125, 2},
+	{250, 4},
+};
+const size_t numConfigs = sizeof(configs) / sizeof(configs[0]);
+
+/** Configurations of the speed check, undecimated first, one golden ratio each in speed.txt */
+const CONFIG speedConfigs[] = {
+	{125, 1},
+	{250, 4},
+};
+const size_t numSpeedConfigs = sizeof(speedConfigs) / sizeof(speedConfigs[0]);
+
+/**
+ * One detected or golden beat
+ */
+struct BEAT
+{
+	uint8_t preset;	 ///< Preset index
+	uint32_t sample; ///< Input sample of the detection
+	int bpm;		 ///< getLastHR() at the detection
+};
+
+/**
+ * Run all presets of one configuration
+ * @param config
+ * 		Configuration
+ * @param beats
+ * 		Detected beats of all presets
+ * @param f1
+ * 		F1 score against the true beats per preset
+ * @param bpmErr
+ * 		Mean heart rate error per preset
+ */
+static void runConfig(const CONFIG &config, std::vector<BEAT> *beats, float *f1, float *bpmErr)
+{
+	uint32_t numSamples = (uint32_t)config.rate * DURATION_SEC;
+	for (uint8_t p = 0; p < PPG_SYNTH_NUM_PRESETS; p++)
+	{
+		PPG_SYNTH_CONFIG synthConfig;
+		PPG_SYNTH::getPreset(p, &synthConfig, config.rate);
+		PPG_SYNTH synth;
+		synth.begin(synthConfig);
+		PPG_SYNTH_SCORE score(config.rate * 35 / 100);
+		HEART_RATE hr;
+		hr.setSamplePeriod(1000000UL / config.rate);
+		if (config.decimation > 1)
+		{
+			hr.setDecimation(config.decimation);
+		}
+		for (uint32_t n = 0; n < numSamples; n++)
+		{
+			int32_t sample = synth.next();
+			if (synth.isBeat())
+			{
+				uint32_t interval = synth.getBeatInterval();
+				score.addTruth(n, interval ? (60.0 * config.rate / interval) : 0.0);
+			}
+			if (hr.checkForBeat(sample))
+			{
+				score.addDetection(n, hr.getLastHR());
+				BEAT beat = {p, n, hr.getLastHR()};
+				beats->push_back(beat);
+			}
+		}
+		score.finish(numSamples);
+		f1[p] = score.getF1();
+		bpmErr[p] = score.getBpmError();
+	}
+}
+
+static std::string tableName(const std::string &dir, const CONFIG &config)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%u_%u.csv", config.rate, config.decimation);
+	return dir + name;
+}
+
+static bool readTable(const std::string &path, std::vector<BEAT> *beats)
+{
+	FILE *in = fopen(path.c_str(), "r");
+	if (in == NULL)
+	{
+		return false;
+	}
+	char line[64];
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		unsigned preset;
+		unsigned long sample;
+		int bpm;
+		if (sscanf(line, "%u,%lu,%d", &preset, &sample, &bpm) == 3)
+		{
+			BEAT beat = {(uint8_t)preset, (uint32_t)sample, bpm};
+			beats->push_back(beat);
+		}
+	}
+	fclose(in);
+	return true;
+}
+
+static bool writeTable(const std::string &path, const std::vector<BEAT> &beats)
+{
+	FILE *out = fopen(path.c_str(), "w");
+	if (out == NULL)
+	{
+		return false;
+	}
+	fprintf(out, "# preset,sample,bpm\n");
+	for (size_t idx = 0; idx < beats.size(); idx++)
+	{
+		fprintf(out, "%u,%lu,%d\n", beats[idx].preset, (unsigned long)beats[idx].sample, beats[idx].bpm);
+	}
+	fclose(out);
+	return true;
+}
+
+/**
+ * Write the golden beat times of one configuration as PROGMEM tables for the HR-Regression example
+ */
+static bool writeHeader(const std::string &path, const CONFIG &config, const std::vector<BEAT> &beats)
+{
+	FILE *out = fopen(path.c_str(), "w");
+	if (out == NULL)
+	{
+		return false;
+	}
+	fprintf(out, "/**\n * Golden beat times of the PPG_SYNTH presets at %u samples/s, %u s per preset\n", config.rate, DURATION_SEC);
+	fprintf(out, " * Generated by extras/tools/hr_regression with -u -e, do not edit\n */\n");
+	fprintf(out, "#ifndef HR_GOLDEN_H\n#define HR_GOLDEN_H\n\n");
+	fprintf(out, "#define GOLDEN_RATE %u\n\n", config.rate);
+	fprintf(out, "/** Input sample of every detected beat, all presets one after the other */\n");
+	fprintf(out, "const uint16_t goldenBeats[] PROGMEM = {");
+	for (size_t idx = 0; idx < beats.size(); idx++)
+	{
+		fprintf(out, "%s%lu", (idx == 0) ? "\n\t" : ((idx % 12) ? ", " : ",\n\t"), (unsigned long)beats[idx].sample);
+	}
+	fprintf(out, "};\n\n/** First entry of every preset in goldenBeats, the last entry is the table size */\n");
+	fprintf(out, "const uint16_t goldenStart[PPG_SYNTH_NUM_PRESETS + 1] = {");
+	size_t idx = 0;
+	for (uint8_t p = 0; p <= PPG_SYNTH_NUM_PRESETS; p++)
+	{
+		while ((idx < beats.size()) && (beats[idx].preset < p))
+		{
+			idx++;
+		}
+		fprintf(out, "%s%lu", p ? ", " : "", (unsigned long)idx);
+	}
+	fprintf(out, "};\n#endif\n");
+	fclose(out);
+	return true;
+}
+
+/**
+ * Compare the detections of one preset with the golden beats
+ * @return share of matched beats, 2 * matched / (detected + golden)
+ */
+static float agreement(const std::vector<BEAT> &beats, const std::vector<BEAT> &golden, uint8_t preset)
+{
+	std::vector<const BEAT *> det;
+	std::vector<const BEAT *> gold;
+	for (size_t idx = 0; idx < beats.size(); idx++)
+	{
+		if (beats[idx].preset == preset)
+		{
+			det.push_back(&beats[idx]);
+		}
+	}
+	for (size_t idx = 0; idx < golden.size(); idx++)
+	{
+		if (golden[idx].preset == preset)
+		{
+			gold.push_back(&golden[idx]);
+		}
+	}
+	if (det.empty() && gold.empty())
+	{
+		return 1.0;
+	}
+	size_t i = 0;
+	size_t j = 0;
+	uint32_t matched = 0;
+	while ((i < det.size()) && (j < gold.size()))
+	{
+		int32_t diff = (int32_t)(det[i]->sample - gold[j]->sample);
+		if (abs(diff) <= HR_REG_TOLERANCE)
+		{
+			if (abs(det[i]->bpm - gold[j]->bpm) <= HR_REG_BPM_TOLERANCE)
+			{
+				matched++;
+			}
+			i++;
+			j++;
+		}
+		else if (diff < 0)
+		{
+			i++;
+		}
+		else
+		{
+			j++;
+		}
+	}
+	return 2.0 * matched / (det.size() + gold.size());
+}
+
+/**
+ * Reference kernel for the speed ratio, DC removal and a 23 tap Q15 FIR
+ */
+static int32_t referenceKernel(const std::vector<int32_t> &samples)
+{
+	static const int16_t coeffs[12] = {172, 321, 579, 927, 1360, 1858, 2390, 2916, 3391, 3768, 4012, 4096};
+	int32_t buf[32] = {0};
+	int32_t dc = 0;
+	int32_t sum = 0;
+	for (size_t n = 0; n < samples.size(); n++)
+	{
+		dc += ((samples[n] << 15) - dc) >> 4;
+		buf[n & 31] = samples[n] - (dc >> 15);
+		int32_t acc = (int32_t)coeffs[11] * buf[(n - 11) & 31];
+		for (uint8_t k = 0; k < 11; k++)
+		{
+			acc += (int32_t)coeffs[k] * (buf[(n - k) & 31] + buf[(n - 22 + k) & 31]);
+		}
+		sum += (acc >> 15) > 0;
+	}
+	return sum;
+}
+
+/**
+ * Time of checkForBeat() per input sample relative to the reference kernel over all presets
+ * @param config
+ * 		Sample rate and decimation
+ */
+static float speedRatio(const CONFIG &config)
+{
+	std::vector<int32_t> samples;
+	for (uint8_t p = 0; p < PPG_SYNTH_NUM_PRESETS; p++)
+	{
+		PPG_SYNTH_CONFIG synthConfig;
+		PPG_SYNTH::getPreset(p, &synthConfig, config.rate);
+		PPG_SYNTH synth;
+		synth.begin(synthConfig);
+		for (uint32_t n = 0; n < (uint32_t)config.rate * DURATION_SEC; n++)
+		{
+			samples.push_back(synth.next());
+		}
+	}
+	std::vector<double> ratios;
+	double total = 0.0;
+	double totalRef = 0.0;
+	volatile int32_t sink = 0;
+	for (uint8_t run = 0; run <= HR_REG_SPEED_RUNS; run++)
+	{
+		HEART_RATE hr;
+		hr.setSamplePeriod(1000000UL / config.rate);
+		if (config.decimation > 1)
+		{
+			hr.setDecimation(config.decimation);
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		uint32_t beats = 0;
+		for (size_t n = 0; n < samples.size(); n++)
+		{
+			beats += hr.checkForBeat(samples[n]);
+		}
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		start = std::chrono::steady_clock::now();
+		sink = sink + referenceKernel(samples) + beats;
+		double elapsedRef = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		// The first run warms up the caches
+		if (run == 0)
+		{
+			continue;
+		}
+		ratios.push_back(elapsed / elapsedRef);
+		total += elapsed;
+		totalRef += elapsedRef;
+	}
+	printf("%u samples/s, decimation %u: checkForBeat %.1f ns/sample, reference %.1f ns/sample\n", config.rate, config.decimation,
+		   total * 1e9 / HR_REG_SPEED_RUNS / samples.size(), totalRef * 1e9 / HR_REG_SPEED_RUNS / samples.size());
+	// Median of the back to back ratios, a burst of other load spoils only single runs
+	std::sort(ratios.begin(), ratios.end());
+	return (float)ratios[ratios.size() / 2];
+}
+
+int main(int argc, char **argv)
+{
+	std::string dir = "golden";
+	std::string header;
+	bool update = false;
+	bool speed = true;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-d") == 0) && ((arg + 1) < argc))
+		{
+			dir = argv[++arg];
+		}
+		else if ((strcmp(argv[arg], "-e") == 0) && ((arg + 1) < argc))
+		{
+			header = argv[++arg];
+		}
+		else if (strcmp(argv[arg], "-u") == 0)
+		{
+			update = true;
+		}
+		else if (strcmp(argv[arg], "-s") == 0)
+		{
+			speed = false;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-d golden dir] [-u] [-e header] [-s]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	uint32_t failed = 0;
+	for (size_t c = 0; c < numConfigs; c++)
+	{
+		std::vector<BEAT> beats;
+		float f1[PPG_SYNTH_NUM_PRESETS];
+		float bpmErr[PPG_SYNTH_NUM_PRESETS];
+		runConfig(configs[c], &beats, f1, bpmErr);
+		std::string path = tableName(dir, configs[c]);
+		printf("%u samples/s, decimation %u\n", configs[c].rate, configs[c].decimation);
+
+		if (update)
+		{
+			if (!writeTable(path, beats))
+			{
+				fprintf(stderr, "Could not write %s\n", path.c_str());
+				return 1;
+			}
+			if (!header.empty() && (c == 0) && !writeHeader(header, configs[c], beats))
+			{
+				fprintf(stderr, "Could not write %s\n", header.c_str());
+				return 1;
+			}
+		}
+		std::vector<BEAT> golden;
+		if (!readTable(path, &golden))
+		{
+			fprintf(stderr, "Could not read %s, create it with -u\n", path.c_str());
+			return 1;
+		}
+		for (uint8_t p = 0; p < PPG_SYNTH_NUM_PRESETS; p++)
+		{
+			float agree = agreement(beats, golden, p);
+			bool pass = agree >= HR_REG_MIN_AGREEMENT;
+			if (!pass)
+			{
+				failed++;
+			}
+			printf("  %-14s F1 %.3f BPM error %5.1f golden agreement %.3f %s\n", PPG_SYNTH::getPresetName(p), f1[p], bpmErr[p], agree,
+				   pass ? "pass" : "FAIL");
+		}
+	}
+
+	if (speed)
+	{
+		float ratios[numSpeedConfigs];
+		for (size_t c = 0; c < numSpeedConfigs; c++)
+		{
+			ratios[c] = speedRatio(speedConfigs[c]);
+		}
+		std::string path = dir + "/speed.txt";
+		if (update)
+		{
+			FILE *out = fopen(path.c_str(), "w");
+			if (out == NULL)
+			{
+				fprintf(stderr, "Could not write %s\n", path.c_str());
+				return 1;
+			}
+			for (size_t c = 0; c < numSpeedConfigs; c++)
+			{
+				fprintf(out, "%.3f\n", ratios[c]);
+			}
+			fclose(out);
+		}
+		float goldenRatios[numSpeedConfigs];
+		size_t numGolden = 0;
+		FILE *in = fopen(path.c_str(), "r");
+		if (in != NULL)
+		{
+			while ((numGolden < numSpeedConfigs) && (fscanf(in, "%f", &goldenRatios[numGolden]) == 1) && (goldenRatios[numGolden] > 0.0))
+			{
+				numGolden++;
+			}
+			fclose(in);
+		}
+		if (numGolden != numSpeedConfigs)
+		{
+			fprintf(stderr, "Could not read %s, create it with -u\n", path.c_str());
+			return 1;
+		}
+		for (size_t c = 0; c < numSpeedConfigs; c++)
+		{
+			bool pass = ratios[c] <= goldenRatios[c] * HR_REG_MAX_SLOWDOWN;
+			if (!pass)
+			{
+				failed++;
+			}
+			printf("Speed ratio %u samples/s, decimation %u: %.3f, golden %.3f %s\n", speedConfigs[c].rate, speedConfigs[c].decimation,
+				   ratios[c], goldenRatios[c], pass ? "pass" : "FAIL");
+		}
+		// The ratios are per input sample, so their quotient is the saving of the decimation
+		float gain = ratios[0] / ratios[numSpeedConfigs - 1];
+		bool pass = gain >= HR_REG_MIN_DECIM_GAIN;
+		if (!pass)
+		{
+			failed++;
+		}
+		printf("Decimation gain %.2f, minimum %.2f %s\n", gain, HR_REG_MIN_DECIM_GAIN, pass ? "pass" : "FAIL");
+	}
+
+	if (failed != 0)
+	{
+		printf("%u checks failed\n", failed);
+		return 2;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
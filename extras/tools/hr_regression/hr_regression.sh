@@ -0,0 +1,13 @@
+#!/bin/bash
+# Build hr_regression and check the beat detection against the golden beat tables
+# Usage: hr_regression.sh [hr_regression options]
+# Exits with the result of hr_regression, non-zero if the build or a check failed.
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+SRC=$DIR/../../../src
+BIN=$(mktemp -d)
+trap 'rm -rf "$BIN"' EXIT
+
+g++ -std=c++11 -O2 -I"$SRC" "$DIR/hr_regression.cpp" "$SRC/heartRate.cpp" "$SRC/bpmSmoother.cpp" "$SRC/hrDecimator.cpp" \
+	"$SRC/hrMorph.cpp" "$SRC/ppgSynth.cpp" "$SRC/ppgPlatform.cpp" -o "$BIN/hr_regression" || exit 1
+cd "$DIR" && "$BIN/hr_regression" "$@"
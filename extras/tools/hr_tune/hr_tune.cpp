@@ -0,0 +1,498 @@
+/**
+ * @file hr_tune.cpp
+ * @brief Grid search of HEART_RATE beat detection parameters against labeled recordings
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * Every combination of the given parameter values is run over all recordings,
+ * the parameter sets are spread over all cores. For each set the beat detection
+ * F1 score and the mean heart rate error are reported, the best set is written
+ * as a header file that can be used with HEART_RATE::setParams().
+ *
+ * Recordings have one sample per line, either the bio value (Plot-Poll output)
+ * or timestamp in us and bio value separated by a comma.
+ * The labels of a recording are in <recording>.labels, one reference beat per
+ * line as sample index (e.g. R peaks of an ECG or hand annotated pulses).
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -pthread -I../../../src hr_tune.cpp ../../../src/heartRate.cpp ../../../src/bpmSmoother.cpp ../../../src/hrDecimator.cpp ../../../src/hrMorph.cpp ../../../src/ppgPlatform.cpp -o hr_tune
+ */
+
+#include <heartRate.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Recording with its reference beats
+ */
+struct RECORDING
+{
+	std::string name;			 ///< File name
+	std::vector<int32_t> samples; ///< Bio values
+	std::vector<uint32_t> labels; ///< Sample index of the reference beats
+	uint32_t periodUs;			 ///< Sample period
+};
+
+/**
+ * One parameter set of the grid and its score
+ */
+struct CANDIDATE
+{
+	HR_PARAMS params;	 ///< Parameters
+	float cutoffHz = 0;	 ///< FIR cutoff, 0 for the default FIR
+	uint32_t truePos = 0; ///< Detected beats matching a label
+	uint32_t falsePos = 0; ///< Detected beats without label
+	uint32_t falseNeg = 0; ///< Labels without detected beat
+	double bpmErrSum = 0; ///< Sum of the absolute heart rate errors
+	uint32_t bpmCount = 0; ///< Number of heart rate errors
+	float f1 = 0;		  ///< F1 score
+	float bpmErr = 0;	  ///< Mean absolute heart rate error
+};
+
+static std::vector<RECORDING> recordings;
+static std::vector<CANDIDATE> candidates;
+static std::atomic<size_t> nextCandidate(0);
+static float sampleRate = 250.0;
+static uint8_t decimation = 1;
+static uint32_t toleranceMs = 100;
+
+/**
+ * Parse a comma separated list of numbers
+ */
+static std::vector<float> parseList(const char *list)
+{
+	std::vector<float> values;
+	while (*list != 0)
+	{
+		char *end;
+		values.push_back((float)strtod(list, &end));
+		if (end == list)
+		{
+			break;
+		}
+		list = (*end == ',') ? end + 1 : end;
+	}
+	return values;
+}
+
+/**
+ * Read a recording and its labels
+ */
+static bool loadRecording(const char *path, RECORDING *rec)
+{
+	FILE *in = fopen(path, "r");
+	if (in == NULL)
+	{
+		return false;
+	}
+	rec->name = path;
+	std::vector<uint32_t> deltas;
+	uint32_t lastTimestamp = 0;
+	char line[128];
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		if ((line[0] < '0') || (line[0] > '9'))
+		{
+			continue;
+		}
+		char *end;
+		long first = strtol(line, &end, 10);
+		if (*end == ',')
+		{
+			if (!rec->samples.empty())
+			{
+				deltas.push_back((uint32_t)first - lastTimestamp);
+			}
+			lastTimestamp = (uint32_t)first;
+			rec->samples.push_back((int32_t)strtol(end + 1, NULL, 10));
+		}
+		else
+		{
+			rec->samples.push_back((int32_t)first);
+		}
+	}
+	fclose(in);
+	rec->periodUs = (uint32_t)(1000000.0 / sampleRate + 0.5);
+	if (!deltas.empty())
+	{
+		std::sort(deltas.begin(), deltas.end());
+		rec->periodUs = deltas[deltas.size() / 2];
+	}
+
+	in = fopen((rec->name + ".labels").c_str(), "r");
+	if (in == NULL)
+	{
+		return false;
+	}
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		if ((line[0] >= '0') && (line[0] <= '9'))
+		{
+			rec->labels.push_back((uint32_t)strtoul(line, NULL, 10));
+		}
+	}
+	fclose(in);
+	std::sort(rec->labels.begin(), rec->labels.end());
+	return !rec->samples.empty() && !rec->labels.empty();
+}
+
+/**
+ * Design a Hamming windowed sinc low pass with the DC gain of the default FIR
+ */
+static void designFir(HR_PARAMS *params, float cutoffHz, float rate)
+{
+	HR_PARAMS defaults;
+	double gain = defaults.firCoeffs[defaults.firHalf];
+	for (uint8_t i = 0; i < defaults.firHalf; i++)
+	{
+		gain += 2.0 * defaults.firCoeffs[i];
+	}
+	uint8_t half = params->firHalf;
+	double taps[HR_FIR_MAX_COEFFS];
+	double sum = 0.0;
+	for (uint8_t i = 0; i <= half; i++)
+	{
+		int n = (int)i - half;
+		double fc = cutoffHz / rate;
+		double sinc = (n == 0) ? 2.0 * fc : sin(2.0 * M_PI * fc * n) / (M_PI * n);
+		double window = 0.54 - 0.46 * cos(M_PI * i / (half + 0.5));
+		taps[i] = sinc * window;
+		sum += (i == half) ? taps[i] : 2.0 * taps[i];
+	}
+	for (uint8_t i = 0; i <= half; i++)
+	{
+		double coeff = taps[i] * gain / sum;
+		params->firCoeffs[i] = (int16_t)std::max(-32768.0, std::min(32767.0, floor(coeff + 0.5)));
+	}
+}
+
+/**
+ * Run one parameter set over all recordings
+ */
+static void evaluate(CANDIDATE *cand)
+{
+	for (size_t r = 0; r < recordings.size(); r++)
+	{
+		const RECORDING &rec = recordings[r];
+		HEART_RATE hr;
+		hr.setDecimation(decimation);
+		hr.setParams(cand->params);
+		hr.setSamplePeriod(rec.periodUs);
+
+		std::vector<uint32_t> beats;
+		std::vector<int> bpm;
+		for (size_t idx = 0; idx < rec.samples.size(); idx++)
+		{
+			if (hr.checkForBeat(rec.samples[idx]))
+			{
+				beats.push_back((uint32_t)idx);
+				bpm.push_back(hr.getLastHR());
+			}
+		}
+
+		// The detection has a fixed delay against the reference (filter delay, zero crossing
+		// instead of peak), remove it with the median distance to the nearest label
+		std::vector<int32_t> offsets;
+		for (size_t b = 0; b < beats.size(); b++)
+		{
+			std::vector<uint32_t>::const_iterator next = std::lower_bound(rec.labels.begin(), rec.labels.end(), beats[b]);
+			int32_t best = INT32_MAX;
+			if (next != rec.labels.end())
+			{
+				best = (int32_t)(beats[b] - *next);
+			}
+			if ((next != rec.labels.begin()) && (abs((int32_t)(beats[b] - *(next - 1))) < abs(best)))
+			{
+				best = (int32_t)(beats[b] - *(next - 1));
+			}
+			offsets.push_back(best);
+		}
+		int32_t offset = 0;
+		if (!offsets.empty())
+		{
+			std::nth_element(offsets.begin(), offsets.begin() + offsets.size() / 2, offsets.end());
+			offset = offsets[offsets.size() / 2];
+		}
+
+		// Match detections and labels in time order within the tolerance
+		int32_t tolerance = (int32_t)((uint64_t)toleranceMs * 1000 / rec.periodUs);
+		size_t b = 0;
+		size_t l = 0;
+		while ((b < beats.size()) && (l < rec.labels.size()))
+		{
+			int32_t diff = (int32_t)(beats[b] - rec.labels[l]) - offset;
+			if (diff < -tolerance)
+			{
+				cand->falsePos++;
+				b++;
+			}
+			else if (diff > tolerance)
+			{
+				cand->falseNeg++;
+				l++;
+			}
+			else
+			{
+				cand->truePos++;
+				if ((bpm[b] != 0) && (l > 0))
+				{
+					double ref = 60000000.0 / ((double)(rec.labels[l] - rec.labels[l - 1]) * rec.periodUs);
+					cand->bpmErrSum += fabs(bpm[b] - ref);
+					cand->bpmCount++;
+				}
+				b++;
+				l++;
+			}
+		}
+		cand->falsePos += (uint32_t)(beats.size() - b);
+		cand->falseNeg += (uint32_t)(rec.labels.size() - l);
+	}
+	uint32_t denominator = 2 * cand->truePos + cand->falsePos + cand->falseNeg;
+	cand->f1 = denominator ? (2.0f * cand->truePos / denominator) : 0.0f;
+	cand->bpmErr = cand->bpmCount ? (float)(cand->bpmErrSum / cand->bpmCount) : 999.0f;
+}
+
+static void worker(void)
+{
+	size_t idx;
+	while ((idx = nextCandidate.fetch_add(1)) < candidates.size())
+	{
+		evaluate(&candidates[idx]);
+	}
+}
+
+/**
+ * Write the parameter set as a header for HEART_RATE::setParams()
+ */
+static bool writeBest(const char *path, const CANDIDATE &best)
+{
+	FILE *out = fopen(path, "w");
+	if (out == NULL)
+	{
+		return false;
+	}
+	fprintf(out, "// Generated by hr_tune: F1 %.4f, mean heart rate error %.2f BPM\n", best.f1, best.bpmErr);
+	if (best.cutoffHz > 0)
+	{
+		fprintf(out, "// Decimation %u, FIR cutoff %.1f Hz at %.1f samples/s\n", decimation, best.cutoffHz, 1000000.0 / recordings[0].periodUs);
+	}
+	else
+	{
+		fprintf(out, "// Decimation %u, default FIR\n", decimation);
+	}
+	fprintf(out, "#ifndef HR_TUNED_PARAMS_H\n#define HR_TUNED_PARAMS_H\n\n#include <heartRate.h>\n\n");
+	fprintf(out, "/** Tuned beat detection parameters, use with HEART_RATE::setParams() */\n");
+	fprintf(out, "inline HR_PARAMS hrTunedParams(void)\n{\n\tHR_PARAMS params;\n");
+	fprintf(out, "\tparams.ampMin = %ld;\n", (long)best.params.ampMin);
+	fprintf(out, "\tparams.ampMax = %ld;\n", (long)best.params.ampMax);
+	fprintf(out, "\tparams.dcShift = %u;\n", best.params.dcShift);
+	fprintf(out, "\tparams.firHalf = %u;\n", best.params.firHalf);
+	fprintf(out, "\tconst int16_t coeffs[%u] = {", best.params.firHalf + 1);
+	for (uint8_t i = 0; i <= best.params.firHalf; i++)
+	{
+		fprintf(out, "%s%d", i ? ", " : "", best.params.firCoeffs[i]);
+	}
+	fprintf(out, "};\n\tfor (uint8_t i = 0; i <= params.firHalf; i++)\n\t{\n\t\tparams.firCoeffs[i] = coeffs[i];\n\t}\n");
+	fprintf(out, "\treturn params;\n}\n#endif\n");
+	fclose(out);
+	return true;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] recording...\n", name);
+	fprintf(stderr, "  -a list   minimum beat amplitude values (default %d)\n", HR_AMP_MIN);
+	fprintf(stderr, "  -A list   maximum beat amplitude values (default %d)\n", HR_AMP_MAX);
+	fprintf(stderr, "  -s list   DC estimator shift values (default %d)\n", HR_DC_SHIFT);
+	fprintf(stderr, "  -c list   FIR cutoff frequencies in Hz, 0 for the default FIR (default 0)\n");
+	fprintf(stderr, "  -f list   FIR center tap index for designed FIR's, 1 to %d (default 11)\n", HR_FIR_MAX_COEFFS - 1);
+	fprintf(stderr, "  -r rate   sample rate of recordings without timestamps (default 250)\n");
+	fprintf(stderr, "  -d factor decimation ahead of the beat detection (default 1)\n");
+	fprintf(stderr, "  -t ms     tolerance for matching a beat with a label (default 100)\n");
+	fprintf(stderr, "  -j n      number of threads (default number of cores)\n");
+	fprintf(stderr, "  -n n      number of parameter sets listed (default 10)\n");
+	fprintf(stderr, "  -o file   header file for the best parameter set\n");
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<float> ampMins(1, HR_AMP_MIN);
+	std::vector<float> ampMaxs(1, HR_AMP_MAX);
+	std::vector<float> dcShifts(1, HR_DC_SHIFT);
+	std::vector<float> cutoffs(1, 0);
+	std::vector<float> firHalfs(1, 11);
+	unsigned threads = std::thread::hardware_concurrency();
+	unsigned listed = 10;
+	const char *outFile = NULL;
+	std::vector<const char *> files;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const char *opt = argv[arg];
+		if ((opt[0] != '-') || (opt[1] == 0) || (opt[2] != 0))
+		{
+			files.push_back(opt);
+			continue;
+		}
+		if ((arg + 1) >= argc)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++arg];
+		switch (opt[1])
+		{
+		case 'a':
+			ampMins = parseList(value);
+			break;
+		case 'A':
+			ampMaxs = parseList(value);
+			break;
+		case 's':
+			dcShifts = parseList(value);
+			break;
+		case 'c':
+			cutoffs = parseList(value);
+			break;
+		case 'f':
+			firHalfs = parseList(value);
+			break;
+		case 'r':
+			sampleRate = (float)atof(value);
+			break;
+		case 'd':
+			decimation = (uint8_t)atoi(value);
+			break;
+		case 't':
+			toleranceMs = (uint32_t)atoi(value);
+			break;
+		case 'j':
+			threads = (unsigned)atoi(value);
+			break;
+		case 'n':
+			listed = (unsigned)atoi(value);
+			break;
+		case 'o':
+			outFile = value;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (files.empty() || (sampleRate <= 0.0))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	for (size_t f = 0; f < firHalfs.size(); f++)
+	{
+		if ((firHalfs[f] < 1) || (firHalfs[f] > (HR_FIR_MAX_COEFFS - 1)) || (firHalfs[f] != floorf(firHalfs[f])))
+		{
+			fprintf(stderr, "FIR center tap index %g out of range, 1 to %d\n", firHalfs[f], HR_FIR_MAX_COEFFS - 1);
+			return 1;
+		}
+	}
+
+	recordings.resize(files.size());
+	for (size_t idx = 0; idx < files.size(); idx++)
+	{
+		if (!loadRecording(files[idx], &recordings[idx]))
+		{
+			fprintf(stderr, "Could not read %s or %s.labels\n", files[idx], files[idx]);
+			return 2;
+		}
+	}
+	// One parameter set and one designed FIR for all recordings, the sample rates must match
+	for (size_t idx = 1; idx < recordings.size(); idx++)
+	{
+		uint32_t diff = (recordings[idx].periodUs > recordings[0].periodUs) ? recordings[idx].periodUs - recordings[0].periodUs
+																			: recordings[0].periodUs - recordings[idx].periodUs;
+		if ((diff * 100) > recordings[0].periodUs)
+		{
+			fprintf(stderr, "%s has a sample period of %u us, %s of %u us, tune recordings of one sample rate together\n",
+					recordings[idx].name.c_str(), recordings[idx].periodUs, recordings[0].name.c_str(), recordings[0].periodUs);
+			return 1;
+		}
+	}
+
+	// Build the grid, sets that HEART_RATE rejects are skipped
+	HEART_RATE check;
+	check.setDecimation(decimation);
+	for (size_t c = 0; c < cutoffs.size(); c++)
+	{
+		for (size_t f = 0; f < ((cutoffs[c] > 0) ? firHalfs.size() : 1); f++)
+		{
+			for (size_t s = 0; s < dcShifts.size(); s++)
+			{
+				for (size_t a = 0; a < ampMins.size(); a++)
+				{
+					for (size_t m = 0; m < ampMaxs.size(); m++)
+					{
+						CANDIDATE cand;
+						cand.params.ampMin = (int32_t)ampMins[a];
+						cand.params.ampMax = (int32_t)ampMaxs[m];
+						cand.params.dcShift = (uint8_t)dcShifts[s];
+						cand.cutoffHz = cutoffs[c];
+						if (cutoffs[c] > 0)
+						{
+							cand.params.firHalf = (uint8_t)firHalfs[f];
+							designFir(&cand.params, cutoffs[c], 1000000.0f / recordings[0].periodUs);
+						}
+						if (check.setParams(cand.params))
+						{
+							candidates.push_back(cand);
+						}
+					}
+				}
+			}
+		}
+	}
+	if (candidates.empty())
+	{
+		fprintf(stderr, "No valid parameter set in the grid\n");
+		return 1;
+	}
+
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	std::vector<std::thread> pool;
+	for (unsigned id = 0; id < threads; id++)
+	{
+		pool.push_back(std::thread(worker));
+	}
+	for (size_t idx = 0; idx < pool.size(); idx++)
+	{
+		pool[idx].join();
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const CANDIDATE &a, const CANDIDATE &b) {
+		return (a.f1 != b.f1) ? (a.f1 > b.f1) : (a.bpmErr < b.bpmErr);
+	});
+	printf("%zu parameter sets, %zu recordings, %u threads\n", candidates.size(), recordings.size(), threads);
+	printf("    F1  BPM err     TP     FP     FN  ampMin  ampMax  dcShift  cutoff  firHalf\n");
+	for (size_t idx = 0; (idx < candidates.size()) && (idx < listed); idx++)
+	{
+		const CANDIDATE &cand = candidates[idx];
+		printf("%.4f  %7.2f %6u %6u %6u  %6ld  %6ld  %7u  %6.1f  %7u\n", cand.f1, cand.bpmErr, cand.truePos, cand.falsePos, cand.falseNeg,
+			   (long)cand.params.ampMin, (long)cand.params.ampMax, cand.params.dcShift, cand.cutoffHz, cand.params.firHalf);
+	}
+	if ((outFile != NULL) && !writeBest(outFile, candidates[0]))
+	{
+		fprintf(stderr, "Could not write %s\n", outFile);
+		return 2;
+	}
+	return 0;
+}
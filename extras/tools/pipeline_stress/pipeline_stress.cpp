@@ -0,0 +1,276 @@
+/**
+ * @file pipeline_stress.cpp
+ * @brief Stress test of PPG_PIPELINE driven through notify()
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * A producer thread makes samples available in bursts and calls notify(),
+ * extra threads call notify() without new data. Every sample carries its
+ * sequence number in the timestamp. After each phase the counters of the
+ * pipeline are checked against what the producer made and the consumer saw:
+ * - every sample was acquired exactly once
+ * - the stop phase calls end() without waiting, end() must process the queued samples
+ * - acquired = processed + dropped
+ * - the consumer got the processed samples in order, without duplicates,
+ *   and the gaps in the sequence add up to the dropped samples
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -pthread -I../../../src pipeline_stress.cpp ../../../src/ppgPipeline.cpp ../../../src/heartRate.cpp ../../../src/bpmSmoother.cpp ../../../src/hrDecimator.cpp ../../../src/hrMorph.cpp ../../../src/ppgSynth.cpp ../../../src/ppgThread.cpp ../../../src/ppgPlatform.cpp -o pipeline_stress
+ *
+ * Usage:
+ * pipeline_stress [-n samples] [-x notifiers] [-z]
+ */
+
+#include <ppgPipeline.h>
+#include <ppgSynth.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Time to wait for the pipeline to drain after the last sample */
+#define STRESS_DRAIN_MS 5000
+
+/**
+ * Sample source shared by the producer and the acquisition task
+ */
+struct SOURCE
+{
+	std::vector<uint16_t> waveform;	 ///< Signal that is replayed
+	std::atomic<uint32_t> available; ///< Samples made available by the producer
+	uint32_t read;					 ///< Samples read by the acquisition task
+};
+
+/**
+ * What the consumer saw
+ */
+struct CONSUMER
+{
+	uint32_t received = 0;	 ///< Samples passed to the result callback
+	uint32_t gaps = 0;		 ///< Samples missing in the sequence
+	uint32_t misordered = 0; ///< Samples not newer than the previous one
+	int64_t last = -1;		 ///< Sequence number of the previous sample
+	uint32_t beats = 0;		 ///< Beats detected
+};
+
+/**
+ * Load of one phase
+ */
+struct PHASE
+{
+	const char *name; ///< Name for the output
+	uint16_t burst;	  ///< Samples per notify()
+	uint32_t pauseUs; ///< Pause of the producer after each burst
+	bool mayDrop;	  ///< Flag if the load is allowed to overflow the queue
+	bool stopEarly;	  ///< Flag if end() is called right after the last sample, end() must process what was queued
+};
+
+static bool readSample(void *ctx, PPG_SAMPLE *sample)
+{
+	SOURCE *source = (SOURCE *)ctx;
+	if (source->read == source->available.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	sample->timestamp = source->read;
+	sample->value = source->waveform[source->read % source->waveform.size()];
+	source->read++;
+	return true;
+}
+
+static void onResult(void *ctx, const PPG_SAMPLE &sample, bool beat)
+{
+	CONSUMER *consumer = (CONSUMER *)ctx;
+	int64_t seq = sample.timestamp;
+	if (seq <= consumer->last)
+	{
+		consumer->misordered++;
+	}
+	else
+	{
+		consumer->gaps += (uint32_t)(seq - consumer->last - 1);
+		consumer->last = seq;
+	}
+	consumer->received++;
+	consumer->beats += beat;
+}
+
+/**
+ * Run one phase through a new pipeline
+ * @return number of failed checks
+ */
+static uint32_t runPhase(const PHASE &phase, uint32_t numSamples, unsigned notifiers, bool zeroDrops, const std::vector<uint16_t> &waveform)
+{
+	SOURCE source;
+	source.waveform = waveform;
+	source.available = 0;
+	source.read = 0;
+	CONSUMER consumer;
+	HEART_RATE hr;
+	hr.setSamplePeriod(8000);
+
+	PPG_PIPELINE pipeline(readSample, &source);
+	pipeline.setHeartRate(&hr);
+	pipeline.setResultCb(onResult, &consumer);
+	if (!pipeline.begin())
+	{
+		printf("%-8s pipeline start failed\n", phase.name);
+		return 1;
+	}
+
+	std::atomic<bool> producing(true);
+	std::vector<std::thread> pool;
+	for (unsigned idx = 0; idx < notifiers; idx++)
+	{
+		pool.push_back(std::thread([&pipeline, &producing] {
+			while (producing.load(std::memory_order_relaxed))
+			{
+				pipeline.notify();
+				std::this_thread::yield();
+			}
+		}));
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t made = 0; made < numSamples;)
+	{
+		made = (numSamples - made > phase.burst) ? made + phase.burst : numSamples;
+		source.available.store(made, std::memory_order_release);
+		pipeline.notify();
+		if (phase.pauseUs != 0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(phase.pauseUs));
+		}
+	}
+	producing = false;
+	for (size_t idx = 0; idx < pool.size(); idx++)
+	{
+		pool[idx].join();
+	}
+
+	// Wait until every sample is acquired and either processed or dropped
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+	if (!phase.stopEarly)
+	{
+		deadline += std::chrono::milliseconds(STRESS_DRAIN_MS);
+	}
+	while (((pipeline.getAcquired() != numSamples) || ((pipeline.getProcessed() + pipeline.getDropped()) != numSamples)) &&
+		   (std::chrono::steady_clock::now() < deadline))
+	{
+		pipeline.notify();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	pipeline.end();
+
+	uint32_t acquired = pipeline.getAcquired();
+	uint32_t processed = pipeline.getProcessed();
+	uint32_t dropped = pipeline.getDropped();
+	printf("%-8s %u samples in %.3f s: acquired %u, processed %u, dropped %u, max depth %u, %u beats\n", phase.name, numSamples, elapsed,
+		   acquired, processed, dropped, pipeline.getMaxDepth(), consumer.beats);
+
+	uint32_t failed = 0;
+	if (phase.stopEarly ? (acquired != source.read) : ((acquired != numSamples) || (source.read != numSamples)))
+	{
+		printf("  FAIL acquired %u of %u samples\n", acquired, numSamples);
+		failed++;
+	}
+	if ((processed + dropped) != acquired)
+	{
+		printf("  FAIL processed + dropped %u, acquired %u\n", processed + dropped, acquired);
+		failed++;
+	}
+	if (consumer.received != processed)
+	{
+		printf("  FAIL consumer got %u samples, processed %u\n", consumer.received, processed);
+		failed++;
+	}
+	if (consumer.misordered != 0)
+	{
+		printf("  FAIL %u samples out of order or duplicated\n", consumer.misordered);
+		failed++;
+	}
+	// Samples missing at the end of the sequence are dropped as well
+	uint32_t missing = consumer.gaps + (uint32_t)(acquired - 1 - consumer.last);
+	if (missing != dropped)
+	{
+		printf("  FAIL %u samples missing in the sequence, dropped %u\n", missing, dropped);
+		failed++;
+	}
+	if ((dropped != 0) && !phase.mayDrop && zeroDrops)
+	{
+		printf("  FAIL %u samples dropped at a load the queue should hold\n", dropped);
+		failed++;
+	}
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t numSamples = 200000;
+	unsigned notifiers = 2;
+	bool zeroDrops = false;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-n") == 0) && ((arg + 1) < argc))
+		{
+			numSamples = (uint32_t)atol(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-x") == 0) && ((arg + 1) < argc))
+		{
+			notifiers = (unsigned)atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "-z") == 0)
+		{
+			zeroDrops = true;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-n samples] [-x notifiers] [-z]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (numSamples == 0)
+	{
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	// Resting heart rate preset at 125 Hz, 16 bit like the sensor values
+	PPG_SYNTH_CONFIG config;
+	PPG_SYNTH synth;
+	PPG_SYNTH::getPreset(0, &config, 125);
+	synth.begin(config);
+	std::vector<uint16_t> waveform(7500);
+	for (size_t idx = 0; idx < waveform.size(); idx++)
+	{
+		int32_t value = synth.next();
+		waveform[idx] = (uint16_t)((value < 0) ? 0 : ((value > 65535) ? 65535 : value));
+	}
+
+	const PHASE phases[] = {
+		{"paced", 16, 200, false, false},
+		{"single", 1, 0, true, false},
+		{"burst", 64, 0, true, false},
+		{"flood", PPG_PIPELINE_QUEUE_SIZE * 4, 0, true, false},
+		{"stop", 64, 0, true, true},
+	};
+	uint32_t failed = 0;
+	for (size_t idx = 0; idx < sizeof(phases) / sizeof(phases[0]); idx++)
+	{
+		failed += runPhase(phases[idx], numSamples, notifiers, zeroDrops, waveform);
+	}
+	if (failed != 0)
+	{
+		printf("%u checks failed\n", failed);
+		return 2;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Build pipeline_stress and run the PPG_PIPELINE stress test
+# Usage: pipeline_stress.sh [pipeline_stress options]
+# Exits with the result of pipeline_stress, non-zero if the build or a check failed.
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+SRC=$DIR/../../../src
+BIN=$(mktemp -d)
+trap 'rm -rf "$BIN"' EXIT
+
+g++ -std=c++11 -O2 -pthread -I"$SRC" "$DIR/pipeline_stress.cpp" "$SRC/ppgPipeline.cpp" "$SRC/heartRate.cpp" "$SRC/bpmSmoother.cpp" \
+	"$SRC/hrDecimator.cpp" "$SRC/hrMorph.cpp" "$SRC/ppgSynth.cpp" "$SRC/ppgThread.cpp" "$SRC/ppgPlatform.cpp" -o "$BIN/pipeline_stress" || exit 1
+"$BIN/pipeline_stress" "$@"
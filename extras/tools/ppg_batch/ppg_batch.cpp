@@ -0,0 +1,371 @@
+/**
+ * @file ppg_batch.cpp
+ * @brief Parallel offline analysis of recorded PPG sessions with HEART_RATE
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * Every recording is streamed line by line through its own HEART_RATE
+ * instance. Recordings are spread over a thread pool, each worker has its own
+ * queue and steals from the other queues when its own is empty.
+ *
+ * Input formats, one sample per line
+ * - Plot-Poll serial output: bio value
+ * - Captures with timestamps: timestamp in us, bio value (comma separated)
+ *
+ * Output
+ * - <outdir>/<recording>.beats.csv per recording:
+ *   sample, time_ms, rr_us, bpm, smoothed_bpm, confidence
+ * - One summary line per recording and the aggregate throughput on stdout
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -pthread -I../../../src ppg_batch.cpp ../../../src/heartRate.cpp ../../../src/bpmSmoother.cpp ../../../src/hrDecimator.cpp ../../../src/hrMorph.cpp ../../../src/ppgPlatform.cpp -o ppg_batch
+ *
+ * Usage:
+ * ppg_batch [-j threads] [-r samples/s] [-o outdir] recording...
+ */
+
+#include <heartRate.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/** Number of timestamp deltas used to estimate the sample period of captures */
+#define PERIOD_ESTIMATE_SAMPLES 64
+
+/**
+ * Result of one recording
+ */
+struct SESSION_RESULT
+{
+	uint64_t samples = 0;	///< Number of samples
+	uint32_t beats = 0;		///< Number of detected beats
+	uint64_t bpmSum = 0;	///< Sum of the smoothed heart rate at the beats
+	uint32_t durationMs = 0; ///< Length of the recording
+	bool ok = false;		///< Flag if the recording could be read
+};
+
+/**
+ * Per worker queue of recording indices
+ * The owner takes from the front, other workers steal from the back
+ */
+class WORK_QUEUE
+{
+public:
+	void push(size_t job)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(job);
+	}
+
+	bool pop(size_t *job)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_jobs.empty())
+		{
+			return false;
+		}
+		*job = _jobs.front();
+		_jobs.pop_front();
+		return true;
+	}
+
+	bool steal(size_t *job)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_jobs.empty())
+		{
+			return false;
+		}
+		*job = _jobs.back();
+		_jobs.pop_back();
+		return true;
+	}
+
+private:
+	std::mutex _mutex;		   ///< Protects _jobs
+	std::deque<size_t> _jobs; ///< Recording indices
+};
+
+static std::vector<std::string> recordings;
+static std::vector<SESSION_RESULT> results;
+static std::vector<WORK_QUEUE> queues;
+static std::vector<uint64_t> workerSamples;
+static std::mutex printMutex;
+static std::string outDir;
+static float sampleRate = 250.0;
+
+/**
+ * Parse one line of a recording
+ * @return number of values found, 0 for empty or comment lines
+ */
+static int parseLine(const char *line, uint32_t *timestamp, int32_t *value)
+{
+	char *end;
+	while ((*line == ' ') || (*line == '\t'))
+	{
+		line++;
+	}
+	if ((*line < '0') || (*line > '9'))
+	{
+		return 0;
+	}
+	long first = strtol(line, &end, 10);
+	while ((*end == ' ') || (*end == '\t'))
+	{
+		end++;
+	}
+	if ((*end == ',') || (*end == ';'))
+	{
+		*timestamp = (uint32_t)first;
+		*value = (int32_t)strtol(end + 1, NULL, 10);
+		return 2;
+	}
+	*value = (int32_t)first;
+	return 1;
+}
+
+/**
+ * Feed one sample and write the beat table row if a beat was found
+ */
+static inline void addSample(HEART_RATE *hr, int32_t value, uint32_t periodUs, SESSION_RESULT *result, FILE *out)
+{
+	uint64_t sample = result->samples++;
+	if (!hr->checkForBeat(value))
+	{
+		return;
+	}
+	result->beats++;
+	result->bpmSum += hr->getSmoothedHR();
+	if (out != NULL)
+	{
+		fprintf(out, "%llu,%llu,%lu,%d,%d,%d\n", (unsigned long long)sample, (unsigned long long)(sample * periodUs / 1000),
+				(unsigned long)hr->getLastRR(), hr->getLastHR(), hr->getSmoothedHR(), hr->getHRConfidence());
+	}
+}
+
+/**
+ * Stream one recording through HEART_RATE
+ */
+static void analyze(size_t job, size_t worker)
+{
+	SESSION_RESULT *result = &results[job];
+	FILE *in = fopen(recordings[job].c_str(), "r");
+	if (in == NULL)
+	{
+		return;
+	}
+	FILE *out = NULL;
+	if (!outDir.empty())
+	{
+		std::string name = recordings[job];
+		size_t slash = name.find_last_of('/');
+		if (slash != std::string::npos)
+		{
+			name = name.substr(slash + 1);
+		}
+		out = fopen((outDir + "/" + name + ".beats.csv").c_str(), "w");
+		if (out != NULL)
+		{
+			fprintf(out, "sample,time_ms,rr_us,bpm,smoothed_bpm,confidence\n");
+		}
+	}
+
+	HEART_RATE hr;
+	uint32_t periodUs = (uint32_t)(1000000.0 / sampleRate + 0.5);
+	hr.setSamplePeriod(periodUs);
+
+	// Captures with timestamps: hold the first samples until the period is estimated
+	std::vector<int32_t> held;
+	std::vector<uint32_t> deltas;
+	uint32_t lastTimestamp = 0;
+	uint32_t timestamp = 0;
+	int32_t value = 0;
+	char line[128];
+	bool more;
+	while ((more = (fgets(line, sizeof(line), in) != NULL)))
+	{
+		int fields = parseLine(line, &timestamp, &value);
+		if (fields == 0)
+		{
+			continue;
+		}
+		held.push_back(value);
+		if (fields == 1)
+		{
+			break;
+		}
+		if (held.size() > 1)
+		{
+			deltas.push_back(timestamp - lastTimestamp);
+		}
+		lastTimestamp = timestamp;
+		if (deltas.size() >= PERIOD_ESTIMATE_SAMPLES)
+		{
+			break;
+		}
+	}
+	if (!deltas.empty())
+	{
+		std::sort(deltas.begin(), deltas.end());
+		periodUs = deltas[deltas.size() / 2];
+		hr.setSamplePeriod(periodUs);
+	}
+
+	for (size_t idx = 0; idx < held.size(); idx++)
+	{
+		addSample(&hr, held[idx], periodUs, result, out);
+	}
+	while (more && (fgets(line, sizeof(line), in) != NULL))
+	{
+		if (parseLine(line, &timestamp, &value) != 0)
+		{
+			addSample(&hr, value, periodUs, result, out);
+		}
+	}
+	fclose(in);
+	if (out != NULL)
+	{
+		fclose(out);
+	}
+	result->durationMs = (uint32_t)(result->samples * periodUs / 1000);
+	result->ok = true;
+	workerSamples[worker] += result->samples;
+
+	std::lock_guard<std::mutex> lock(printMutex);
+	printf("%s: %llu samples, %.1f s, %u beats, mean %u BPM\n", recordings[job].c_str(), (unsigned long long)result->samples,
+		   result->durationMs / 1000.0, result->beats, result->beats ? (unsigned)(result->bpmSum / result->beats) : 0);
+}
+
+/**
+ * Worker thread, own queue first, then steal
+ */
+static void worker(size_t id)
+{
+	size_t job;
+	size_t numQueues = queues.size();
+	while (true)
+	{
+		if (queues[id].pop(&job))
+		{
+			analyze(job, id);
+			continue;
+		}
+		bool stolen = false;
+		for (size_t offset = 1; offset < numQueues; offset++)
+		{
+			if (queues[(id + offset) % numQueues].steal(&job))
+			{
+				stolen = true;
+				break;
+			}
+		}
+		if (!stolen)
+		{
+			return;
+		}
+		analyze(job, id);
+	}
+}
+
+static long fileSize(const std::string &path)
+{
+	struct stat info;
+	return (stat(path.c_str(), &info) == 0) ? (long)info.st_size : 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned threads = std::thread::hardware_concurrency();
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-j") == 0) && ((arg + 1) < argc))
+		{
+			threads = (unsigned)atoi(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-r") == 0) && ((arg + 1) < argc))
+		{
+			sampleRate = (float)atof(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-o") == 0) && ((arg + 1) < argc))
+		{
+			outDir = argv[++arg];
+		}
+		else
+		{
+			recordings.push_back(argv[arg]);
+		}
+	}
+	if (recordings.empty() || (sampleRate <= 0.0))
+	{
+		fprintf(stderr, "Usage: %s [-j threads] [-r samples/s] [-o outdir] recording...\n", argv[0]);
+		return 1;
+	}
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	if (threads > recordings.size())
+	{
+		threads = (unsigned)recordings.size();
+	}
+
+	// Largest recordings first, dealt round robin, stealing evens out the rest
+	std::vector<size_t> order(recordings.size());
+	std::vector<long> sizes(recordings.size());
+	for (size_t idx = 0; idx < recordings.size(); idx++)
+	{
+		order[idx] = idx;
+		sizes[idx] = fileSize(recordings[idx]);
+	}
+	std::sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+	results.resize(recordings.size());
+	queues = std::vector<WORK_QUEUE>(threads);
+	workerSamples.assign(threads, 0);
+	for (size_t idx = 0; idx < order.size(); idx++)
+	{
+		queues[idx % threads].push(order[idx]);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (unsigned id = 0; id < threads; id++)
+	{
+		pool.push_back(std::thread(worker, (size_t)id));
+	}
+	for (size_t idx = 0; idx < pool.size(); idx++)
+	{
+		pool[idx].join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t totalSamples = 0;
+	uint32_t failed = 0;
+	for (size_t idx = 0; idx < results.size(); idx++)
+	{
+		totalSamples += results[idx].samples;
+		if (!results[idx].ok)
+		{
+			fprintf(stderr, "Could not read %s\n", recordings[idx].c_str());
+			failed++;
+		}
+	}
+	printf("%zu recordings, %llu samples in %.3f s with %u threads\n", recordings.size(), (unsigned long long)totalSamples, seconds, threads);
+	printf("Throughput %.0f samples/s, %.0f samples/s per thread\n", totalSamples / seconds, totalSamples / seconds / threads);
+	for (unsigned id = 0; id < threads; id++)
+	{
+		printf("Thread %u: %llu samples\n", id, (unsigned long long)workerSamples[id]);
+	}
+	return failed ? 2 : 0;
+}
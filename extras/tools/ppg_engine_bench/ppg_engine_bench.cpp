@@ -0,0 +1,224 @@
+/**
+ * @file ppg_engine_bench.cpp
+ * @brief Throughput benchmark of the sharded multi-stream engine PPG_ENGINE
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * Simulates a gateway: producer threads push sample batches of many synthetic
+ * streams into PPG_ENGINE as fast as the engine accepts them. Every second the
+ * throughput and queue depth of each shard are printed, at the end the total
+ * throughput and the mean heart rate of all streams.
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -pthread -I../../../src ppg_engine_bench.cpp ../../../src/ppgEngine.cpp ../../../src/heartRate.cpp ../../../src/bpmSmoother.cpp ../../../src/hrDecimator.cpp ../../../src/hrMorph.cpp ../../../src/ppgSynth.cpp ../../../src/ppgThread.cpp ../../../src/ppgPlatform.cpp -o ppg_engine_bench
+ *
+ * Usage:
+ * ppg_engine_bench [-s streams] [-w shards] [-p producers] [-b batch] [-t seconds] [-q]
+ */
+
+#include <ppgEngine.h>
+#include <ppgSynth.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Length of the synthetic signal every stream replays, 60 s at 125 Hz */
+#define SIGNAL_SAMPLES 7500
+/** Sample period of the synthetic signal */
+#define SAMPLE_PERIOD_US 8000
+
+static PPG_ENGINE engine;
+static std::vector<int32_t> waveform;
+static std::vector<int> lastBpm;
+static std::atomic<bool> producing(true);
+static uint32_t numStreams = 10000;
+static uint16_t batchSize = PPG_ENGINE_BATCH_SIZE;
+
+/**
+ * Beat callback, stores the heart rate of the stream
+ * Every stream belongs to one shard, only its worker writes the entry
+ */
+static void onBeat(void *, uint32_t stream, uint32_t, int bpm)
+{
+	lastBpm[stream] = bpm;
+}
+
+/**
+ * Producer thread, pushes the streams id % producers == id round robin
+ * Streams start at different positions of the signal, a full queue is retried
+ */
+static void producer(unsigned id, unsigned producers)
+{
+	std::vector<uint32_t> position;
+	for (uint32_t stream = id; stream < numStreams; stream += producers)
+	{
+		position.push_back((stream * 7919) % SIGNAL_SAMPLES);
+	}
+	int32_t batch[PPG_ENGINE_BATCH_SIZE];
+	while (producing.load(std::memory_order_relaxed))
+	{
+		size_t slot = 0;
+		for (uint32_t stream = id; stream < numStreams; stream += producers, slot++)
+		{
+			uint32_t pos = position[slot];
+			for (uint16_t idx = 0; idx < batchSize; idx++)
+			{
+				batch[idx] = waveform[pos];
+				pos = (pos + 1 < SIGNAL_SAMPLES) ? pos + 1 : 0;
+			}
+			while (!engine.push(stream, batch, batchSize))
+			{
+				if (!producing.load(std::memory_order_relaxed))
+				{
+					return;
+				}
+				std::this_thread::yield();
+			}
+			position[slot] = pos;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned cores = std::thread::hardware_concurrency();
+	unsigned shards = (cores > 2) ? cores - cores / 4 : 1;
+	unsigned producers = (cores > 2) ? cores / 4 : 1;
+	unsigned seconds = 10;
+	bool quiet = false;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-s") == 0) && ((arg + 1) < argc))
+		{
+			numStreams = (uint32_t)atol(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-w") == 0) && ((arg + 1) < argc))
+		{
+			shards = (unsigned)atoi(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-p") == 0) && ((arg + 1) < argc))
+		{
+			producers = (unsigned)atoi(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-b") == 0) && ((arg + 1) < argc))
+		{
+			batchSize = (uint16_t)atoi(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-t") == 0) && ((arg + 1) < argc))
+		{
+			seconds = (unsigned)atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "-q") == 0)
+		{
+			quiet = true;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-s streams] [-w shards] [-p producers] [-b batch] [-t seconds] [-q]\n", argv[0]);
+			return 1;
+		}
+	}
+	if ((numStreams == 0) || (shards == 0) || (producers == 0) || (producers > numStreams) || (batchSize == 0) ||
+		(batchSize > PPG_ENGINE_BATCH_SIZE) || (seconds == 0))
+	{
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	}
+
+	// Resting heart rate preset, 65 BPM
+	PPG_SYNTH_CONFIG config;
+	PPG_SYNTH synth;
+	PPG_SYNTH::getPreset(0, &config, 1000000.0 / SAMPLE_PERIOD_US);
+	synth.begin(config);
+	waveform.resize(SIGNAL_SAMPLES);
+	for (uint32_t idx = 0; idx < SIGNAL_SAMPLES; idx++)
+	{
+		waveform[idx] = synth.next();
+	}
+
+	lastBpm.assign(numStreams, 0);
+	engine.setBeatCb(onBeat, NULL);
+	if (!engine.begin(numStreams, (uint16_t)shards, SAMPLE_PERIOD_US))
+	{
+		fprintf(stderr, "Engine start failed, shards must be 1 to %d and not more than streams\n", PPG_ENGINE_MAX_SHARDS);
+		return 1;
+	}
+	printf("%u streams, %u shards, %u producers, batches of %u samples\n", numStreams, shards, producers, batchSize);
+
+	PPG_ENGINE_STATS stats;
+	for (uint16_t shard = 0; shard < shards; shard++)
+	{
+		engine.getShardStats(shard, &stats);
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (unsigned id = 0; id < producers; id++)
+	{
+		pool.push_back(std::thread(producer, id, producers));
+	}
+	for (unsigned second = 1; second <= seconds; second++)
+	{
+		std::this_thread::sleep_until(start + std::chrono::seconds(second));
+		uint64_t total = 0;
+		for (uint16_t shard = 0; shard < shards; shard++)
+		{
+			engine.getShardStats(shard, &stats);
+			total += stats.samplesPerSec;
+			if (!quiet)
+			{
+				printf("%3u s shard %3u: %10u samples/s, depth %4u, max depth %4u\n", second, shard, stats.samplesPerSec, stats.depth, stats.maxDepth);
+			}
+		}
+		printf("%3u s total: %llu samples/s\n", second, (unsigned long long)total);
+	}
+	producing = false;
+	for (size_t idx = 0; idx < pool.size(); idx++)
+	{
+		pool[idx].join();
+	}
+	bool flushed = engine.flush(10000);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t samples = 0;
+	uint64_t beats = 0;
+	uint64_t rejected = 0;
+	for (uint16_t shard = 0; shard < shards; shard++)
+	{
+		engine.getShardStats(shard, &stats);
+		samples += stats.samples;
+		beats += stats.beats;
+		rejected += stats.dropped;
+		printf("Shard %u: %llu samples, %llu beats, %llu full queue rejects, max depth %u\n", shard, (unsigned long long)stats.samples,
+			   (unsigned long long)stats.beats, (unsigned long long)stats.dropped, stats.maxDepth);
+	}
+	engine.end();
+
+	uint64_t bpmSum = 0;
+	uint32_t bpmCount = 0;
+	for (uint32_t stream = 0; stream < numStreams; stream++)
+	{
+		if (lastBpm[stream] != 0)
+		{
+			bpmSum += lastBpm[stream];
+			bpmCount++;
+		}
+	}
+	printf("%llu samples in %.3f s: %.0f samples/s, %.0f samples/s per shard\n", (unsigned long long)samples, elapsed, samples / elapsed,
+		   samples / elapsed / shards);
+	printf("%llu beats, %u of %u streams with heart rate, mean %u BPM (signal %.0f BPM)\n", (unsigned long long)beats, bpmCount, numStreams,
+		   bpmCount ? (unsigned)(bpmSum / bpmCount) : 0, config.bpm);
+	printf("%llu pushes retried on a full queue\n", (unsigned long long)rejected);
+	if (!flushed)
+	{
+		fprintf(stderr, "Queues not drained\n");
+		return 2;
+	}
+	return 0;
+}
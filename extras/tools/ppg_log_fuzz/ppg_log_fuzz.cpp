@@ -0,0 +1,247 @@
+/**
+ * @file ppg_log_fuzz.cpp
+ * @brief Power loss fuzz test of PPG_LOG on the NOR flash simulator
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * Every run is one power cycle of a device: the log is recovered with begin()
+ * from the flash image of the previous run, all records are read back and
+ * checked, then records are appended with random flushes until the simulated
+ * power loss of PPG_LOG_FILE_FLASH hits after a random number of programmed
+ * bytes. Every record carries a running number.
+ * The read back must show the numbers strictly increasing, so no record is
+ * duplicated or out of order, and every record that was confirmed by a
+ * successful flush() must be there unless the ring overwrote it.
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -I../../../src ppg_log_fuzz.cpp ../../../src/ppgLog.cpp ../../../src/ppgLogHost.cpp -o ppg_log_fuzz
+ *
+ * Usage:
+ * ppg_log_fuzz [-n runs] [-r seed] [-f image]
+ */
+
+#include <ppgLogHost.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Size of the simulated flash, small so that the ring wraps often */
+#define FUZZ_FLASH_SIZE (32 * 1024)
+/** Sector size of the simulated flash */
+#define FUZZ_SECTOR_SIZE 4096
+/** Highest number of bytes programmed before the power loss */
+#define FUZZ_MAX_BYTES (PPG_LOG_PAGE_SIZE * 12)
+/** Time between two records in ms */
+#define FUZZ_RECORD_MS 7
+
+/**
+ * Records confirmed by a successful flush(), first and last running number
+ */
+struct RANGE
+{
+	uint32_t first; ///< First record of the range
+	uint32_t last;	///< Last record of the range
+};
+
+/** Small deterministic generator, the same seed gives the same runs on every host */
+static uint32_t rngState = 1;
+
+static uint32_t rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+/**
+ * Read the whole log back and check order and completeness
+ * @return TRUE if the log is consistent
+ */
+static bool verify(PPG_LOG &log, std::vector<RANGE> *durable, uint32_t minPages, uint32_t run)
+{
+	std::vector<uint32_t> numbers;
+	PPG_LOG_RECORD record;
+	log.rewind();
+	while (log.next(&record))
+	{
+		if ((record.type != PPG_LOG_BEAT) || (record.len != 6))
+		{
+			printf("Run %u: unexpected record type %u length %u\n", run, record.type, record.len);
+			return false;
+		}
+		uint32_t number = record.data[0] | ((uint32_t)record.data[1] << 8) | ((uint32_t)record.data[2] << 16) | ((uint32_t)record.data[3] << 24);
+		uint16_t check = record.data[4] | ((uint16_t)record.data[5] << 8);
+		if ((check != (uint16_t)(number * 40503)) || (record.timestamp != number * FUZZ_RECORD_MS))
+		{
+			printf("Run %u: record %u corrupted\n", run, number);
+			return false;
+		}
+		if (!numbers.empty() && (number <= numbers.back()))
+		{
+			printf("Run %u: record %u after record %u, out of order or duplicated\n", run, number, numbers.back());
+			return false;
+		}
+		numbers.push_back(number);
+	}
+	if (log.getPages() < minPages)
+	{
+		printf("Run %u: only %u pages in the log, expected at least %u\n", run, log.getPages(), minPages);
+		return false;
+	}
+	if (numbers.empty())
+	{
+		if (!durable->empty() && (minPages != 0))
+		{
+			printf("Run %u: log is empty\n", run);
+			return false;
+		}
+		return true;
+	}
+
+	// Confirmed records older than the oldest record were overwritten by the ring
+	uint32_t oldest = numbers.front();
+	size_t keep = 0;
+	for (size_t idx = 0; idx < durable->size(); idx++)
+	{
+		RANGE range = (*durable)[idx];
+		if (range.last < oldest)
+		{
+			continue;
+		}
+		range.first = std::max(range.first, oldest);
+		size_t found = std::upper_bound(numbers.begin(), numbers.end(), range.last) - std::lower_bound(numbers.begin(), numbers.end(), range.first);
+		if (found != (size_t)(range.last - range.first + 1))
+		{
+			printf("Run %u: %u of the confirmed records %u to %u lost\n", run, (uint32_t)(range.last - range.first + 1 - found), range.first,
+				   range.last);
+			return false;
+		}
+		(*durable)[keep++] = range;
+	}
+	durable->resize(keep);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t runs = 3000;
+	uint32_t seed = 1;
+	std::string path;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-n") == 0) && ((arg + 1) < argc))
+		{
+			runs = (uint32_t)atol(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-r") == 0) && ((arg + 1) < argc))
+		{
+			seed = (uint32_t)atol(argv[++arg]);
+		}
+		else if ((strcmp(argv[arg], "-f") == 0) && ((arg + 1) < argc))
+		{
+			path = argv[++arg];
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-n runs] [-r seed] [-f image]\n", argv[0]);
+			return 1;
+		}
+	}
+	bool keepImage = !path.empty();
+	if (path.empty())
+	{
+		char name[] = "/tmp/ppg_log_fuzz_XXXXXX";
+		int fd = mkstemp(name);
+		if (fd < 0)
+		{
+			fprintf(stderr, "Could not create the flash image\n");
+			return 1;
+		}
+		close(fd);
+		path = name;
+	}
+	// Start with an erased flash
+	unlink(path.c_str());
+	rngState = (seed != 0) ? seed : 1;
+
+	std::vector<RANGE> durable;
+	uint32_t nextNumber = 1;
+	uint32_t pagesWritten = 0;
+	uint32_t powerLosses = 0;
+	uint32_t maxPages = FUZZ_FLASH_SIZE / PPG_LOG_PAGE_SIZE - FUZZ_SECTOR_SIZE / PPG_LOG_PAGE_SIZE;
+	bool failed = false;
+	for (uint32_t run = 0; (run < runs) && !failed; run++)
+	{
+		PPG_LOG_FILE_FLASH flash(path.c_str(), FUZZ_FLASH_SIZE, FUZZ_SECTOR_SIZE);
+		PPG_LOG log(&flash);
+		if (!flash.isOpen() || !log.begin())
+		{
+			printf("Run %u: begin() failed\n", run);
+			failed = true;
+			break;
+		}
+		// The ring keeps at least all sectors but the one that is erased next.
+		// Before it wraps, every power loss may cost the position of the page it tore.
+		if (!verify(log, &durable, std::min(pagesWritten - powerLosses, maxPages), run))
+		{
+			failed = true;
+			break;
+		}
+
+		// Most runs end with a power loss, some run until a clean shutdown
+		bool powerLoss = (rng() % 8) != 0;
+		flash.setPowerFail(powerLoss ? (int32_t)(rng() % FUZZ_MAX_BYTES) : -1);
+		uint32_t confirmed = nextNumber;
+		uint32_t records = rng() % 600;
+		bool ok = true;
+		for (uint32_t idx = 0; (idx < records) && ok; idx++)
+		{
+			uint32_t number = nextNumber++;
+			ok = log.logBeat(number * FUZZ_RECORD_MS, number, (uint16_t)(number * 40503));
+			if (ok && ((rng() % 40) == 0))
+			{
+				ok = log.flush();
+				if (ok)
+				{
+					RANGE range = {confirmed, number};
+					durable.push_back(range);
+					confirmed = number + 1;
+				}
+			}
+		}
+		if (ok && !powerLoss)
+		{
+			ok = log.flush();
+			if (ok && (confirmed < nextNumber))
+			{
+				RANGE range = {confirmed, nextNumber - 1};
+				durable.push_back(range);
+			}
+		}
+		if (!ok)
+		{
+			powerLosses++;
+		}
+		pagesWritten += log.getPagesWritten();
+	}
+	if (!keepImage)
+	{
+		unlink(path.c_str());
+	}
+	if (failed)
+	{
+		printf("FAIL with seed %u\n", seed);
+		return 2;
+	}
+	printf("%u runs, %u power losses, %u records, %u pages written, no record lost or out of order\n", runs, powerLosses, nextNumber - 1,
+		   pagesWritten);
+	return 0;
+}
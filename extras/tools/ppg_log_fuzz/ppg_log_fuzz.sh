@@ -0,0 +1,12 @@
+#!/bin/bash
+# Build ppg_log_fuzz and run the power loss fuzz test of PPG_LOG
+# Usage: ppg_log_fuzz.sh [ppg_log_fuzz options]
+# Exits with the result of ppg_log_fuzz, non-zero if the build or a check failed.
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+SRC=$DIR/../../../src
+BIN=$(mktemp -d)
+trap 'rm -rf "$BIN"' EXIT
+
+g++ -std=c++11 -O2 -I"$SRC" "$DIR/ppg_log_fuzz.cpp" "$SRC/ppgLog.cpp" "$SRC/ppgLogHost.cpp" -o "$BIN/ppg_log_fuzz" || exit 1
+"$BIN/ppg_log_fuzz" -f "$BIN/flash.img" "$@"
@@ -0,0 +1,279 @@
+/**
+ * @file ppg_trace.cpp
+ * @brief Convert a PPG_TRACER dump to Chrome/Perfetto trace JSON with latency percentiles
+ *
+ * @author   Bernd Giesecke
+ *
+ * Host tool (Linux/macOS), not part of the Arduino library build.
+ * Reads the output of PPG_TRACER::dump(), e.g. a serial log, other lines are
+ * skipped. Writes a trace JSON file that can be opened with chrome://tracing or
+ * ui.perfetto.dev and prints the latency of every trace point after the sensor
+ * interrupt of the same trace id.
+ *
+ * Build from this directory:
+ * g++ -std=c++11 -O2 -I../../../src ppg_trace.cpp -o ppg_trace
+ *
+ * Usage:
+ * ppg_trace [-o trace.json] dump...
+ */
+
+#include <ppgTrace.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of trace points with statistics, PPG_TRACE_USER and above are grouped */
+#define NUM_POINTS (PPG_TRACE_USER + 1)
+
+/**
+ * Trace entry with unwrapped timestamp
+ */
+struct ENTRY
+{
+	uint64_t time; ///< Timestamp in microseconds, without 32 bit wrap
+	uint32_t id;   ///< Trace id
+	uint8_t point; ///< Trace point
+	uint8_t arg;   ///< Point specific value
+};
+
+static const char *pointName(uint8_t point)
+{
+	switch (point)
+	{
+	case PPG_TRACE_ISR:
+		return "isr";
+	case PPG_TRACE_I2C_START:
+		return "i2c start";
+	case PPG_TRACE_I2C_END:
+		return "i2c end";
+	case PPG_TRACE_FILTER:
+		return "filter";
+	case PPG_TRACE_BEAT:
+		return "beat";
+	case PPG_TRACE_CONSUMER:
+		return "consumer";
+	}
+	return "user";
+}
+
+/**
+ * Read all dumps of a file, the ids of later dumps are moved above the earlier ones
+ */
+static bool readDump(const char *path, std::vector<ENTRY> *entries)
+{
+	FILE *in = fopen(path, "r");
+	if (in == NULL)
+	{
+		return false;
+	}
+	char line[128];
+	uint64_t lastTime = 0;
+	uint32_t idBase = 0;
+	uint32_t maxId = 0;
+	bool inDump = false;
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		if (strncmp(line, "PPG_TRACE_END", 13) == 0)
+		{
+			inDump = false;
+			idBase = maxId + 1;
+			continue;
+		}
+		if (strncmp(line, "PPG_TRACE,", 10) == 0)
+		{
+			inDump = true;
+			continue;
+		}
+		unsigned long time;
+		unsigned id;
+		unsigned point;
+		unsigned arg;
+		if (!inDump || (sscanf(line, "T,%lu,%u,%u,%u", &time, &id, &point, &arg) != 4))
+		{
+			continue;
+		}
+		// micros() wraps after 71 minutes
+		uint64_t unwrapped = (lastTime & ~0xFFFFFFFFULL) | (uint32_t)time;
+		if ((entries->size() > 0) && (unwrapped + 0x80000000ULL < lastTime))
+		{
+			unwrapped += 0x100000000ULL;
+		}
+		lastTime = unwrapped;
+		ENTRY entry;
+		entry.time = unwrapped;
+		entry.id = idBase + id;
+		entry.point = (uint8_t)point;
+		entry.arg = (uint8_t)arg;
+		entries->push_back(entry);
+		maxId = std::max(maxId, entry.id);
+	}
+	fclose(in);
+	return true;
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, uint8_t percent)
+{
+	size_t rank = (sorted.size() * percent + 99) / 100;
+	return sorted[(rank > 0) ? (rank - 1) : 0];
+}
+
+static void printStats(const char *name, std::vector<uint64_t> *values)
+{
+	if (values->empty())
+	{
+		return;
+	}
+	std::sort(values->begin(), values->end());
+	printf("%-22s %8zu %8llu %8llu %8llu %8llu\n", name, values->size(), (unsigned long long)percentile(*values, 50),
+		   (unsigned long long)percentile(*values, 90), (unsigned long long)percentile(*values, 99),
+		   (unsigned long long)values->back());
+}
+
+int main(int argc, char **argv)
+{
+	const char *outFile = "trace.json";
+	std::vector<ENTRY> entries;
+	int files = 0;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-o") == 0) && ((arg + 1) < argc))
+		{
+			outFile = argv[++arg];
+			continue;
+		}
+		std::vector<ENTRY> fileEntries;
+		if (!readDump(argv[arg], &fileEntries))
+		{
+			fprintf(stderr, "Could not read %s\n", argv[arg]);
+			return 2;
+		}
+		// Ids of different files must not mix
+		uint32_t idBase = 0;
+		for (size_t idx = 0; idx < entries.size(); idx++)
+		{
+			idBase = std::max(idBase, entries[idx].id + 1);
+		}
+		for (size_t idx = 0; idx < fileEntries.size(); idx++)
+		{
+			fileEntries[idx].id += idBase;
+			entries.push_back(fileEntries[idx]);
+		}
+		files++;
+	}
+	if (files == 0)
+	{
+		fprintf(stderr, "Usage: %s [-o trace.json] dump...\n", argv[0]);
+		return 1;
+	}
+	if (entries.empty())
+	{
+		fprintf(stderr, "No trace entries found\n");
+		return 2;
+	}
+
+	// Latency of the first occurrence of every point after the interrupt of its id
+	std::map<uint32_t, uint64_t> isrTime;
+	std::map<uint32_t, uint64_t> lastTime;
+	std::map<std::pair<uint32_t, uint8_t>, bool> seen;
+	std::vector<uint64_t> latency[NUM_POINTS];
+	std::vector<uint64_t> i2cRead;
+	std::vector<uint64_t> endToEnd;
+	std::vector<ENTRY> i2cOpen;
+	uint32_t withoutIsr = 0;
+
+	FILE *out = fopen(outFile, "w");
+	if (out == NULL)
+	{
+		fprintf(stderr, "Could not write %s\n", outFile);
+		return 2;
+	}
+	uint64_t origin = entries[0].time;
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (uint8_t point = 0; point < NUM_POINTS; point++)
+	{
+		if ((point > PPG_TRACE_CONSUMER) && (point < PPG_TRACE_USER))
+		{
+			continue;
+		}
+		fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", point, pointName(point));
+	}
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":100,\"args\":{\"name\":\"isr to last point\"}}");
+
+	for (size_t idx = 0; idx < entries.size(); idx++)
+	{
+		const ENTRY &entry = entries[idx];
+		uint8_t point = (entry.point < PPG_TRACE_USER) ? entry.point : PPG_TRACE_USER;
+		fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"id\":%u,\"arg\":%u}}",
+				pointName(point), (unsigned long long)(entry.time - origin), point, entry.id, entry.arg);
+
+		if (point == PPG_TRACE_ISR)
+		{
+			isrTime[entry.id] = entry.time;
+			continue;
+		}
+		if (point == PPG_TRACE_I2C_START)
+		{
+			i2cOpen.push_back(entry);
+		}
+		if (point == PPG_TRACE_I2C_END)
+		{
+			// Pair with the last open read of the same id and register
+			for (size_t open = i2cOpen.size(); open-- > 0;)
+			{
+				if ((i2cOpen[open].id == entry.id) && (i2cOpen[open].arg == entry.arg))
+				{
+					uint64_t duration = entry.time - i2cOpen[open].time;
+					i2cRead.push_back(duration);
+					fprintf(out, ",\n{\"name\":\"i2c read 0x%02X\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u}",
+							entry.arg, (unsigned long long)(i2cOpen[open].time - origin), (unsigned long long)duration, PPG_TRACE_I2C_START);
+					i2cOpen.erase(i2cOpen.begin() + open);
+					break;
+				}
+			}
+		}
+		std::map<uint32_t, uint64_t>::iterator isr = isrTime.find(entry.id);
+		if (isr == isrTime.end())
+		{
+			withoutIsr++;
+			continue;
+		}
+		lastTime[entry.id] = entry.time;
+		std::pair<uint32_t, uint8_t> key(entry.id, point);
+		if (!seen[key])
+		{
+			seen[key] = true;
+			latency[point].push_back(entry.time - isr->second);
+			if (point == PPG_TRACE_CONSUMER)
+			{
+				endToEnd.push_back(entry.time - isr->second);
+			}
+		}
+	}
+	for (std::map<uint32_t, uint64_t>::iterator chain = lastTime.begin(); chain != lastTime.end(); chain++)
+	{
+		uint64_t start = isrTime[chain->first];
+		fprintf(out, ",\n{\"name\":\"id %u\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":100}", chain->first,
+				(unsigned long long)(start - origin), (unsigned long long)(chain->second - start));
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+
+	printf("%zu entries, %zu interrupts, %u entries without interrupt\n", entries.size(), isrTime.size(), withoutIsr);
+	printf("Latency after the interrupt in us\n");
+	printf("%-22s %8s %8s %8s %8s %8s\n", "point", "count", "p50", "p90", "p99", "max");
+	for (uint8_t point = PPG_TRACE_I2C_START; point < NUM_POINTS; point++)
+	{
+		printStats(pointName(point), &latency[point]);
+	}
+	printf("Duration in us\n");
+	printStats("i2c read", &i2cRead);
+	printStats("isr to consumer", &endToEnd);
+	printf("Trace written to %s\n", outFile);
+	return 0;
+}
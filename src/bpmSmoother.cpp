@@ -0,0 +1,123 @@
+/**
+ * @file bpmSmoother.cpp
+ * @brief Running median heart rate smoothing with outlier rejection
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "bpmSmoother.h"
+
+BPM_SMOOTHER::BPM_SMOOTHER(void)
+{
+	reset();
+}
+
+void BPM_SMOOTHER::reset(void)
+{
+	_head = 0;
+	_count = 0;
+	_rejectRun = 0;
+	_history = 0;
+}
+
+bool BPM_SMOOTHER::addInterval(uint32_t rrUs)
+{
+	uint32_t rr = (rrUs + 500) / 1000;
+
+	// Physiological range
+	bool accept = (rr >= (60000 / BPM_SMOOTH_MAX_BPM)) && (rr <= (60000 / BPM_SMOOTH_MIN_BPM));
+
+	// Deviation from the recent median
+	if (accept && (_count >= 3))
+	{
+		uint32_t med = median();
+		uint32_t dev = (rr > med) ? (rr - med) : (med - rr);
+		if ((dev * 100) > (med * BPM_SMOOTH_MAX_DEV))
+		{
+			accept = false;
+		}
+	}
+
+	_history <<= 1;
+	if (!accept)
+	{
+		_rejectRun++;
+		if (_rejectRun < BPM_SMOOTH_MAX_REJECT)
+		{
+			return false;
+		}
+		// The rhythm changed, restart the window
+		_head = 0;
+		_count = 0;
+		if ((rr < (60000 / BPM_SMOOTH_MAX_BPM)) || (rr > (60000 / BPM_SMOOTH_MIN_BPM)))
+		{
+			return false;
+		}
+	}
+	_rejectRun = 0;
+	_history |= 1;
+
+	uint8_t pos;
+	if (_count == BPM_SMOOTH_WINDOW)
+	{
+		// Remove the oldest interval from the sorted window
+		uint16_t oldest = _ring[_head];
+		for (pos = 0; pos < _count; pos++)
+		{
+			if (_sorted[pos] == oldest)
+			{
+				break;
+			}
+		}
+		for (; pos < (_count - 1); pos++)
+		{
+			_sorted[pos] = _sorted[pos + 1];
+		}
+		_head = (_head + 1) % BPM_SMOOTH_WINDOW;
+		_count--;
+	}
+
+	// Insert the new interval into the sorted window
+	pos = _count;
+	while ((pos > 0) && (_sorted[pos - 1] > rr))
+	{
+		_sorted[pos] = _sorted[pos - 1];
+		pos--;
+	}
+	_sorted[pos] = (uint16_t)rr;
+	_ring[(_head + _count) % BPM_SMOOTH_WINDOW] = (uint16_t)rr;
+	_count++;
+	return true;
+}
+
+uint16_t BPM_SMOOTHER::median(void)
+{
+	if ((_count & 1) != 0)
+	{
+		return _sorted[_count / 2];
+	}
+	return (_sorted[_count / 2 - 1] + _sorted[_count / 2]) / 2;
+}
+
+int BPM_SMOOTHER::getBPM(void)
+{
+	if (_count < 3)
+	{
+		return 0;
+	}
+	uint16_t med = median();
+	return (int)((60000UL + med / 2) / med);
+}
+
+uint8_t BPM_SMOOTHER::getConfidence(void)
+{
+	uint8_t accepted = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		if ((_history & (1 << i)) != 0)
+		{
+			accepted++;
+		}
+	}
+	return (uint8_t)(((uint16_t)accepted * 100 / 8) * _count / BPM_SMOOTH_WINDOW);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file bpmSmoother.h
+ * @brief Running median heart rate smoothing with outlier rejection
+ *
+ * @author   Bernd Giesecke
+ *
+ * Beat to beat intervals are checked against the physiological range and
+ * against the median of the recent intervals. Accepted intervals go into a
+ * small running median window. Insert and removal work on a sorted copy of
+ * the window, the cost per beat is bounded by BPM_SMOOTH_WINDOW.
+ */
+#ifndef BPM_SMOOTHER_H
+#define BPM_SMOOTHER_H
+
+#include "ppgPlatform.h"
+
+/** Number of intervals in the running median window */
+#define BPM_SMOOTH_WINDOW 7
+/** Lowest accepted heart rate */
+#define BPM_SMOOTH_MIN_BPM 30
+/** Highest accepted heart rate */
+#define BPM_SMOOTH_MAX_BPM 220
+/** Maximum deviation of an interval from the median in percent */
+#define BPM_SMOOTH_MAX_DEV 25
+/** Number of rejected intervals in a row after which the window restarts */
+#define BPM_SMOOTH_MAX_REJECT 4
+
+/**
+ * Heart rate smoothing
+ */
+class BPM_SMOOTHER
+{
+public:
+	BPM_SMOOTHER(void);
+
+	/**
+	 * Add a beat to beat interval
+	 * @param rrUs
+	 * 		Interval in microseconds
+	 * @return result
+	 * 		TRUE if the interval was accepted
+	 * 		FALSE if the interval was rejected as outlier
+	 */
+	bool addInterval(uint32_t rrUs);
+	/**
+	 * Clear the window
+	 */
+	void reset(void);
+	/**
+	 * Get smoothed heart rate
+	 * @return median heart rate in beats/minute, 0 until 3 intervals were accepted
+	 */
+	int getBPM(void);
+	/**
+	 * Get confidence of the smoothed heart rate
+	 * @return 0 to 100, based on the fill level of the window and the
+	 * 		share of accepted intervals of the last 8 beats
+	 */
+	uint8_t getConfidence(void);
+
+private:
+	uint16_t median(void);
+
+	uint16_t _ring[BPM_SMOOTH_WINDOW];	 ///< Accepted intervals in ms, in order of arrival
+	uint16_t _sorted[BPM_SMOOTH_WINDOW]; ///< Accepted intervals in ms, sorted
+	uint8_t _head = 0;					 ///< Position of the oldest interval in _ring
+	uint8_t _count = 0;					 ///< Number of intervals in the window
+	uint8_t _rejectRun = 0;				 ///< Number of rejected intervals in a row
+	uint8_t _history = 0;				 ///< Accept (1) / reject (0) bits of the last 8 beats
+};
+#endif
@@ -0,0 +1,262 @@
+/**
+ * @file busArbiter.cpp
+ * @brief Priority and deadline based arbitration of a shared I2C bus
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "busArbiter.h"
+
+#ifdef PPG_HAS_THREADS
+
+BUS_ARBITER::BUS_ARBITER(void)
+{
+}
+
+int8_t BUS_ARBITER::addClient(const char *name, uint8_t priority)
+{
+	_mutex.lock();
+	if (_numClients >= BUS_ARBITER_MAX_CLIENTS)
+	{
+		_mutex.unlock();
+		return -1;
+	}
+	int8_t client = _numClients;
+	CLIENT *entry = &_clients[client];
+	entry->name = name;
+	entry->priority = priority;
+	entry->waiting = false;
+	entry->hasDeadline = false;
+	memset(&entry->stats, 0, sizeof(BUS_ARBITER_STATS));
+	_numClients++;
+	_mutex.unlock();
+	return client;
+}
+
+bool BUS_ARBITER::acquire(int8_t client, uint32_t deadlineUs, uint32_t timeoutMs)
+{
+	if ((client < 0) || (client >= _numClients))
+	{
+		return false;
+	}
+	CLIENT *entry = &_clients[client];
+
+	_mutex.lock();
+	uint32_t now = micros();
+	entry->hasDeadline = deadlineUs != 0;
+	entry->deadline = now + deadlineUs;
+	entry->waitStart = now;
+	if ((_owner == -1) && (selectNext() == -1))
+	{
+		// Bus is free and nobody waits
+		grant(client, now);
+		_mutex.unlock();
+		return true;
+	}
+	// Clear a grant left over from an earlier timeout
+	entry->granted.take(0);
+	entry->waiting = true;
+	entry->sequence = _sequence++;
+	_mutex.unlock();
+
+	uint32_t waitStart = millis();
+	while (true)
+	{
+		uint32_t waited = millis() - waitStart;
+		bool signaled = (waited < timeoutMs) && entry->granted.take(timeoutMs - waited);
+		_mutex.lock();
+		if (_owner == client)
+		{
+			_mutex.unlock();
+			return true;
+		}
+		if (!signaled)
+		{
+			// Timeout, leave the queue
+			entry->waiting = false;
+			entry->stats.timeouts++;
+			_mutex.unlock();
+			return false;
+		}
+		_mutex.unlock();
+	}
+}
+
+void BUS_ARBITER::release(int8_t client)
+{
+	_mutex.lock();
+	if (_owner != client)
+	{
+		_mutex.unlock();
+		return;
+	}
+	_owner = -1;
+	int8_t next = selectNext();
+	if (next != -1)
+	{
+		grant(next, micros());
+		_clients[next].granted.give();
+	}
+	_mutex.unlock();
+}
+
+bool BUS_ARBITER::higherWaiting(int8_t client)
+{
+	bool result = false;
+	_mutex.lock();
+	if ((client >= 0) && (client < _numClients))
+	{
+		for (uint8_t idx = 0; idx < _numClients; idx++)
+		{
+			if (_clients[idx].waiting && (_clients[idx].priority > _clients[client].priority))
+			{
+				result = true;
+				break;
+			}
+		}
+	}
+	_mutex.unlock();
+	return result;
+}
+
+bool BUS_ARBITER::transferChunked(int8_t client, BUS_CHUNK_FN fn, void *ctx, uint32_t totalLen, uint16_t chunkLen, uint32_t timeoutMs)
+{
+	if (chunkLen == 0)
+	{
+		return false;
+	}
+	if (!acquire(client, 0, timeoutMs))
+	{
+		return false;
+	}
+	uint32_t offset = 0;
+	while (offset < totalLen)
+	{
+		uint16_t len = ((totalLen - offset) > chunkLen) ? chunkLen : (uint16_t)(totalLen - offset);
+		if (!fn(ctx, offset, len))
+		{
+			release(client);
+			return false;
+		}
+		offset += len;
+		if ((offset < totalLen) && higherWaiting(client))
+		{
+			// Chunk boundary, let the higher priority client use the bus
+			_mutex.lock();
+			_clients[client].stats.preemptions++;
+			_mutex.unlock();
+			release(client);
+			if (!acquire(client, 0, timeoutMs))
+			{
+				return false;
+			}
+		}
+	}
+	release(client);
+	return true;
+}
+
+bool BUS_ARBITER::getStats(int8_t client, BUS_ARBITER_STATS *stats)
+{
+	if ((client < 0) || (client >= _numClients))
+	{
+		return false;
+	}
+	_mutex.lock();
+	*stats = _clients[client].stats;
+	_mutex.unlock();
+	return true;
+}
+
+const char *BUS_ARBITER::getName(int8_t client)
+{
+	if ((client < 0) || (client >= _numClients))
+	{
+		return NULL;
+	}
+	return _clients[client].name;
+}
+
+uint8_t BUS_ARBITER::getClients(void)
+{
+	return _numClients;
+}
+
+void BUS_ARBITER::resetStats(void)
+{
+	_mutex.lock();
+	for (uint8_t idx = 0; idx < _numClients; idx++)
+	{
+		memset(&_clients[idx].stats, 0, sizeof(BUS_ARBITER_STATS));
+	}
+	_mutex.unlock();
+}
+
+int8_t BUS_ARBITER::selectNext(void)
+{
+	int8_t best = -1;
+	for (uint8_t idx = 0; idx < _numClients; idx++)
+	{
+		CLIENT *entry = &_clients[idx];
+		if (!entry->waiting)
+		{
+			continue;
+		}
+		if (best == -1)
+		{
+			best = idx;
+			continue;
+		}
+		CLIENT *current = &_clients[best];
+		if (entry->priority != current->priority)
+		{
+			if (entry->priority > current->priority)
+			{
+				best = idx;
+			}
+			continue;
+		}
+		// Same priority, earliest deadline first, clients with deadline before clients without
+		if (entry->hasDeadline != current->hasDeadline)
+		{
+			if (entry->hasDeadline)
+			{
+				best = idx;
+			}
+			continue;
+		}
+		if (entry->hasDeadline && (entry->deadline != current->deadline))
+		{
+			if ((int32_t)(entry->deadline - current->deadline) < 0)
+			{
+				best = idx;
+			}
+			continue;
+		}
+		// Same deadline, first come first served
+		if ((int32_t)(entry->sequence - current->sequence) < 0)
+		{
+			best = idx;
+		}
+	}
+	return best;
+}
+
+void BUS_ARBITER::grant(int8_t client, uint32_t now)
+{
+	CLIENT *entry = &_clients[client];
+	uint32_t wait = now - entry->waitStart;
+	entry->waiting = false;
+	entry->stats.acquisitions++;
+	entry->stats.totalWaitUs += wait;
+	if (wait > entry->stats.maxWaitUs)
+	{
+		entry->stats.maxWaitUs = wait;
+	}
+	if (entry->hasDeadline && ((int32_t)(now - entry->deadline) > 0))
+	{
+		entry->stats.deadlineMisses++;
+	}
+	_owner = client;
+}
+#endif
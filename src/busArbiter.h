@@ -0,0 +1,171 @@
+/**
+ * @file busArbiter.h
+ * @brief Priority and deadline based arbitration of a shared I2C bus
+ *
+ * @author   Bernd Giesecke
+ *
+ * Several drivers (PPG sensor, IMU, fuel gauge, display) share one TwoWire
+ * bus. Each driver registers as a client with a priority. A transaction
+ * acquires the bus before and releases it after the transfer. When the bus
+ * is released it is granted to the waiting client with the highest priority,
+ * between clients of the same priority to the earliest deadline.
+ * Long low priority transfers are split into chunks, between two chunks the
+ * bus is handed to waiting clients with a higher priority.
+ * Only available on targets with threads (PPG_HAS_THREADS), the arbiter does
+ * not touch the bus itself, so it can be run on Linux with simulated devices.
+ */
+#ifndef BUS_ARBITER_H
+#define BUS_ARBITER_H
+
+#include "ppgThread.h"
+
+#ifdef PPG_HAS_THREADS
+
+/** Maximum number of clients of one arbiter */
+#define BUS_ARBITER_MAX_CLIENTS 8
+
+/**
+ * Wait time statistics of one client
+ */
+struct BUS_ARBITER_STATS
+{
+	uint32_t acquisitions;	 ///< Number of granted transactions
+	uint32_t timeouts;		 ///< Number of acquisitions that timed out
+	uint32_t deadlineMisses; ///< Number of transactions granted after their deadline
+	uint32_t preemptions;	 ///< Number of times a chunked transfer gave the bus to a higher priority client
+	uint32_t maxWaitUs;		 ///< Longest wait for the bus in us
+	uint64_t totalWaitUs;	 ///< Sum of all waits for the bus in us
+};
+
+/**
+ * Shared bus arbiter
+ */
+class BUS_ARBITER
+{
+public:
+	/**
+	 * Chunk transfer function
+	 * @param ctx
+	 * 		User context
+	 * @param offset
+	 * 		Offset of the chunk in the complete transfer
+	 * @param len
+	 * 		Length of the chunk
+	 * @return result
+	 * 		FALSE to abort the transfer
+	 */
+	typedef bool (*BUS_CHUNK_FN)(void *ctx, uint32_t offset, uint16_t len);
+
+	BUS_ARBITER(void);
+
+	/**
+	 * Register a client
+	 * @param name
+	 * 		Name of the client, used only for the statistics output
+	 * @param priority
+	 * 		Priority of the client, higher value is served first
+	 * @return client ID or -1 if BUS_ARBITER_MAX_CLIENTS are already registered
+	 */
+	int8_t addClient(const char *name, uint8_t priority);
+	/**
+	 * Wait for and take the bus
+	 * @param client
+	 * 		Client ID from addClient()
+	 * @param deadlineUs
+	 * 		Time in us from now by which the transaction should have started, 0 for no deadline.
+	 * 		Orders clients of the same priority and counts deadline misses
+	 * @param timeoutMs
+	 * 		Maximum wait time in milliseconds
+	 * @return result
+	 * 		TRUE if the bus was granted, FALSE on timeout or invalid client
+	 */
+	bool acquire(int8_t client, uint32_t deadlineUs = 0, uint32_t timeoutMs = 1000);
+	/**
+	 * Release the bus and grant it to the next waiting client
+	 * @param client
+	 * 		Client ID from addClient()
+	 */
+	void release(int8_t client);
+	/**
+	 * Check if a client with a higher priority is waiting for the bus
+	 * @param client
+	 * 		Client ID of the current bus owner
+	 * @return result
+	 * 		TRUE if the owner should release the bus at the next chunk boundary
+	 */
+	bool higherWaiting(int8_t client);
+	/**
+	 * Run a long transfer in chunks
+	 * The bus is acquired for the first chunk. After every chunk it is handed to
+	 * waiting clients with a higher priority and acquired again.
+	 * @param client
+	 * 		Client ID from addClient()
+	 * @param fn
+	 * 		Function that transfers one chunk
+	 * @param ctx
+	 * 		User context for fn
+	 * @param totalLen
+	 * 		Length of the complete transfer
+	 * @param chunkLen
+	 * 		Maximum length of one chunk
+	 * @param timeoutMs
+	 * 		Maximum wait time for each acquisition in milliseconds
+	 * @return result
+	 * 		TRUE if all chunks were transferred, FALSE on timeout or if fn failed
+	 */
+	bool transferChunked(int8_t client, BUS_CHUNK_FN fn, void *ctx, uint32_t totalLen, uint16_t chunkLen, uint32_t timeoutMs = 1000);
+	/**
+	 * Get wait time statistics of a client
+	 * @param client
+	 * 		Client ID from addClient()
+	 * @param stats
+	 * 		Pointer to the structure to fill
+	 * @return result
+	 * 		FALSE if the client ID is invalid
+	 */
+	bool getStats(int8_t client, BUS_ARBITER_STATS *stats);
+	/**
+	 * Get name of a client
+	 * @param client
+	 * 		Client ID from addClient()
+	 * @return name given to addClient() or NULL if the client ID is invalid
+	 */
+	const char *getName(int8_t client);
+	/**
+	 * Get number of registered clients
+	 * @return number of clients
+	 */
+	uint8_t getClients(void);
+	/**
+	 * Reset the statistics of all clients
+	 */
+	void resetStats(void);
+
+private:
+	/**
+	 * State of one client
+	 */
+	struct CLIENT
+	{
+		const char *name;		 ///< Client name
+		uint8_t priority;		 ///< Client priority
+		bool waiting;			 ///< Flag if the client waits for the bus
+		uint32_t waitStart;		 ///< Start of the wait in us
+		uint32_t deadline;		 ///< Absolute deadline in us
+		bool hasDeadline;		 ///< Flag if deadline is valid
+		uint32_t sequence;		 ///< Arrival order of the wait
+		BUS_ARBITER_STATS stats; ///< Wait time statistics
+		PPG_SIGNAL granted;		 ///< Set when the bus is granted to the client
+	};
+
+	int8_t selectNext(void);
+	void grant(int8_t client, uint32_t now);
+
+	PPG_MUTEX _mutex;						  ///< Protects the arbiter state
+	CLIENT _clients[BUS_ARBITER_MAX_CLIENTS]; ///< Registered clients
+	uint8_t _numClients = 0;				  ///< Number of registered clients
+	int8_t _owner = -1;						  ///< Client that owns the bus, -1 if the bus is free
+	uint32_t _sequence = 0;					  ///< Arrival counter for waiting clients
+};
+#endif
+#endif
@@ -76,18 +76,53 @@
 // int16_t cbuf[32];
 // uint8_t offset = 0;
 
-/** Coefficients for FIR calculation */ 
-static const uint16_t FIRCoeffs[12] = {172, 321, 579, 927, 1360, 1858, 2390, 2916, 3391, 3768, 4012, 4096};
+/** Coefficients for FIR calculation, in flash on AVR */ 
+static const uint16_t FIRCoeffs[HR_FIR_MAX_COEFFS] PROGMEM = {172, 321, 579, 927, 1360, 1858, 2390, 2916, 3391, 3768, 4012, 4096};
+
+#if HR_USE_PARAMS
+/**
+ * Beat detection parameters with the defaults of the original PBA implementation
+ */
+HR_PARAMS::HR_PARAMS(void)
+{
+	ampMin = HR_AMP_MIN;
+	ampMax = HR_AMP_MAX;
+	dcShift = HR_DC_SHIFT;
+	firHalf = HR_FIR_MAX_COEFFS - 1;
+	for (uint8_t i = 0; i < HR_FIR_MAX_COEFFS; i++)
+	{
+		firCoeffs[i] = (int16_t)pgm_read_word(&FIRCoeffs[i]);
+	}
+}
+#endif
 
 /**
  * Heart Rate Monitor
  */
-HEART_RATE::HEART_RATE()
+template <class POLICY>
+HEART_RATE_T<POLICY>::HEART_RATE_T()
 {
 	// Constructor
 	lastBeat = 0;
 	delta = 0;
+	deltaSamples = 0;
+	sampleCount = 0;
+	lastBeatSample = 0;
+	samplePeriod = 0;
+	beatSeen = false;
 	beatsPerMinute = 0;
+	IR_AC_Max = POLICY::fromRaw(20);
+	IR_AC_Min = POLICY::fromRaw(-20);
+	for (uint8_t i = 0; i < HR_FIR_LINE; i++)
+	{
+		cbuf[i] = 0;
+	}
+#if HR_USE_PARAMS
+	applyParams();
+#else
+	ampMin = POLICY::fromRaw(HR_AMP_MIN);
+	ampMax = POLICY::fromRaw(HR_AMP_MAX);
+#endif
 }
 
 /**
@@ -99,7 +134,32 @@ HEART_RATE::HEART_RATE()
  *      True if a heart beat was detected
  *      False if no heart beat was detected
  */
-bool HEART_RATE::checkForBeat(int32_t sample)
+template <class POLICY>
+bool HEART_RATE_T<POLICY>::checkForBeat(int32_t sample)
+{
+	sampleCount++;
+
+#if HR_USE_DECIMATION
+	//  Decimate, the beat detection runs only on every decimated sample
+	if (!decimator.addSample(sample, &sample))
+	{
+		return false;
+	}
+#endif
+	return detectBeat(sample);
+}
+
+/**
+ * Beat detection on a (decimated) sample
+ * Kept apart from checkForBeat(), so the samples dropped by the decimation
+ * return without the setup of the detection.
+ * @param sample
+ *      Measured value
+ * @return beatDetected
+ *      True if a heart beat was detected
+ */
+template <class POLICY>
+bool HEART_RATE_T<POLICY>::detectBeat(int32_t sample)
 {
 	bool beatDetected = false;
 
@@ -107,8 +167,8 @@ bool HEART_RATE::checkForBeat(int32_t sample)
 	IR_AC_Signal_Previous = IR_AC_Signal_Current;
 
 	//  Process next data sample
-	IR_Average_Estimated = averageDCEstimator(&ir_avg_reg, sample);
-	IR_AC_Signal_Current = lowPassFIRFilter(sample - IR_Average_Estimated);
+	IR_AC_Signal_Current = lowPassFIRFilter(averageDCEstimator(&ir_avg_reg, sample));
+	PPG_TRACE_POINT(PPG_TRACE_FILTER, 0);
 
 	//  Detect positive zero crossing (rising edge)
 	if ((IR_AC_Signal_Previous < 0) & (IR_AC_Signal_Current >= 0))
@@ -122,7 +182,7 @@ bool HEART_RATE::checkForBeat(int32_t sample)
 		IR_AC_Signal_max = 0;
 
 		//if ((IR_AC_Max - IR_AC_Min) > 100 & (IR_AC_Max - IR_AC_Min) < 1000)
-		if (((IR_AC_Max - IR_AC_Min) > 20) & ((IR_AC_Max - IR_AC_Min) < 1000))
+		if (((IR_AC_Max - IR_AC_Min) > ampMin) & ((IR_AC_Max - IR_AC_Min) < ampMax))
 		{
 			//Heart beat!!!
 			beatDetected = true;
@@ -149,8 +209,16 @@ bool HEART_RATE::checkForBeat(int32_t sample)
 		IR_AC_Signal_min = IR_AC_Signal_Current;
 	}
 
+#if HR_USE_MORPH
+	if (morph != NULL)
+	{
+		morph->addSample(sampleCount, sample, POLICY::toRaw(IR_AC_Signal_Current), beatDetected);
+	}
+#endif
+
 	if (beatDetected)
 	{
+		PPG_TRACE_POINT(PPG_TRACE_BEAT, 0);
 		calcHR();
 	}
 	else
@@ -161,73 +229,360 @@ bool HEART_RATE::checkForBeat(int32_t sample)
 	return (beatDetected);
 }
 
-void HEART_RATE::calcHR(void)
+template <class POLICY>
+void HEART_RATE_T<POLICY>::calcHR(void)
 {
 	//We sensed a beat!
-	delta = millis() - lastBeat;
-	lastBeat = millis();
+	uint32_t now = micros();
+	deltaSamples = sampleCount - lastBeatSample;
+	lastBeatSample = sampleCount;
+	if (samplePeriod != 0)
+	{
+		// Timing from the sample count, independent of when the samples are processed
+		delta = deltaSamples * samplePeriod;
+	}
+	else
+	{
+		delta = now - lastBeat;
+	}
+	lastBeat = now;
+
+	if (!beatSeen)
+	{
+		// First beat, no interval yet
+		beatSeen = true;
+		delta = 0;
+		deltaSamples = 0;
+		beatsPerMinute = 0;
+		return;
+	}
 
-	beatsPerMinute = (60000 / delta);
+	if (delta == 0)
+	{
+		beatsPerMinute = 0;
+		return;
+	}
+	beatsPerMinute = (60000000UL / delta);
+	smoother.addInterval(delta);
 }
 
 /** 
  * @brief Get last calculated heart rate
  * @return last calculated heart rate
  */
-int HEART_RATE::getLastHR(void)
+template <class POLICY>
+int HEART_RATE_T<POLICY>::getLastHR(void)
 {
 	return beatsPerMinute;
 }
 
+#if HR_USE_DECIMATION
 /**
- * Average DC Estimator
- * @param *p
- *      ???
- * @param x
- *      ???
+ * @brief Set decimation ahead of the beat detection
+ * At the higher bio sensor data rates the beat detection does not need the full
+ * bandwidth. The samples are low pass filtered and decimated before they go into
+ * the DC estimator and the beat detector. The low pass FIR of the beat detector is
+ * shortened by the same factor, so its response in Hz stays the same.
+ * The DC estimator and the amplitude limits work on the decimated samples. Factors
+ * that bring the rate down to about 60 samples/s keep the detection quality, e.g. 2
+ * for BIO_SENS_RATE_125 or 4 for BIO_SENS_RATE_250. Lower rates save more time but
+ * the DC estimator follows more slowly and the beat timing gets coarser, with 25 to
+ * 30 samples/s breathing and fast heart rates are tracked noticeably worse.
+ * The beat timing (getLastRR(), getLastRRSamples()) stays in input samples.
+ * @param factor
+ *      1 (off) or 2 to HR_DECIM_MAX_FACTOR
  * @return result
- *      ???
+ *      FALSE if the factor is out of range
  */
-int16_t HEART_RATE::averageDCEstimator(int32_t *p, uint16_t x)
+template <class POLICY>
+bool HEART_RATE_T<POLICY>::setDecimation(uint8_t factor)
 {
-	*p += ((((long)x << 15) - *p) >> 4);
-	return (*p >> 15);
+	if (!decimator.setFactor(factor))
+	{
+		return false;
+	}
+	applyParams();
+	return true;
 }
+#endif
 
+#if HR_USE_PARAMS
 /**
- * Low Pass FIR Filter
- * @param din
- *      ???
+ * @brief Set the beat detection parameters
+ * Replaces the amplitude window, the DC estimator shift and the low pass FIR of the
+ * beat detection, e.g. for a different sensor placement or LED current. The running
+ * detection state is kept, the filters settle within a few samples.
+ * If decimation is enabled, the FIR is shortened the same way as the default FIR.
+ * @param newParams
+ *      New parameters
  * @return result
- *      ???
+ *      FALSE if a parameter is out of range, the parameters are not changed then
  */
-int16_t HEART_RATE::lowPassFIRFilter(int16_t din)
+template <class POLICY>
+bool HEART_RATE_T<POLICY>::setParams(const HR_PARAMS &newParams)
 {
-	cbuf[offset] = din;
+	if ((newParams.ampMin < 0) || (newParams.ampMax <= newParams.ampMin) || (newParams.ampMax > 32767))
+	{
+		return false;
+	}
+	if ((newParams.dcShift < 1) || (newParams.dcShift > 15) || (newParams.firHalf >= HR_FIR_MAX_COEFFS))
+	{
+		return false;
+	}
+	params = newParams;
+	applyParams();
+	return true;
+}
 
-	int32_t z = mul16(FIRCoeffs[11], cbuf[(offset - 11) & 0x1F]);
+/**
+ * @brief Get the beat detection parameters
+ * @return parameters in use, the FIR before shortening for decimation
+ */
+template <class POLICY>
+const HR_PARAMS &HEART_RATE_T<POLICY>::getParams(void)
+{
+	return params;
+}
+
+/**
+ * Derive the working values of the beat detection from the parameters
+ * The low pass FIR must keep its response in Hz at a reduced rate.
+ * With decimation it is shortened by the decimation factor by resampling
+ * the coefficient curve and keeping the DC gain, so the amplitude limits
+ * of the beat detection stay valid.
+ */
+template <class POLICY>
+void HEART_RATE_T<POLICY>::applyParams(void)
+{
+	ampMin = POLICY::fromRaw(params.ampMin);
+	ampMax = POLICY::fromRaw(params.ampMax);
 
-	for (uint8_t i = 0; i < 11; i++)
+#if HR_USE_DECIMATION
+	uint8_t factor = decimator.getFactor();
+#else
+	uint8_t factor = 1;
+#endif
+	uint8_t half = params.firHalf;
+	if ((factor == 1) || (half == 0))
 	{
-		z += mul16(FIRCoeffs[i], cbuf[(offset - i) & 0x1F] + cbuf[(offset - 22 + i) & 0x1F]);
+		firHalf = half;
+		for (uint8_t i = 0; i <= half; i++)
+		{
+			firCoeffs[i] = params.firCoeffs[i];
+		}
+		return;
+	}
+	firHalf = (half + factor / 2) / factor;
+	if (firHalf < 1)
+	{
+		firHalf = 1;
 	}
+	float gainOrig = params.firCoeffs[half];
+	for (uint8_t i = 0; i < half; i++)
+	{
+		gainOrig += 2.0 * params.firCoeffs[i];
+	}
+	float coeffs[HR_FIR_MAX_COEFFS];
+	float gainNew = 0.0;
+	for (uint8_t i = 0; i <= firHalf; i++)
+	{
+		// Position of the new tap on the original curve
+		float pos = (float)half - (float)(firHalf - i) * half / (firHalf + 0.5);
+		uint8_t idx = (uint8_t)pos;
+		float frac = pos - idx;
+		coeffs[i] = params.firCoeffs[idx];
+		if (idx < half)
+		{
+			coeffs[i] += frac * (params.firCoeffs[idx + 1] - params.firCoeffs[idx]);
+		}
+		gainNew += (i == firHalf) ? coeffs[i] : 2.0 * coeffs[i];
+	}
+	for (uint8_t i = 0; i <= firHalf; i++)
+	{
+		firCoeffs[i] = (int16_t)(coeffs[i] * gainOrig / gainNew + 0.5);
+	}
+}
+#endif
+
+#if HR_USE_MORPH
+/**
+ * @brief Attach a pulse morphology feature extractor
+ * Every filtered sample of the beat detection is passed to the extractor.
+ * After checkForBeat() returned TRUE, HR_MORPH::getFeatures() returns the
+ * features of the pulse completed by this beat.
+ * @param newMorph
+ *      Pointer to the extractor, NULL to detach it
+ */
+template <class POLICY>
+void HEART_RATE_T<POLICY>::setMorph(HR_MORPH *newMorph)
+{
+	morph = newMorph;
+}
+#endif
+
+/**
+ * @brief Get smoothed heart rate
+ * Median of the recent beat intervals. Intervals outside of the physiological range
+ * or too far from the median are rejected. Unlike getLastHR() the value is kept
+ * between beats.
+ * @return smoothed heart rate, 0 until enough beats were detected
+ */
+template <class POLICY>
+int HEART_RATE_T<POLICY>::getSmoothedHR(void)
+{
+	return smoother.getBPM();
+}
+
+/**
+ * @brief Get confidence of the smoothed heart rate
+ * @return 0 to 100
+ */
+template <class POLICY>
+uint8_t HEART_RATE_T<POLICY>::getHRConfidence(void)
+{
+	return smoother.getConfidence();
+}
+
+/**
+ * @brief Get last beat to beat (RR) interval
+ * The interval is updated whenever checkForBeat() returns true
+ * @return interval between the last two beats in microseconds, 0 if less than two beats were detected
+ */
+template <class POLICY>
+uint32_t HEART_RATE_T<POLICY>::getLastRR(void)
+{
+	return delta;
+}
 
-	offset++;
-	offset %= 32; //Wrap condition
+/**
+ * @brief Get last beat to beat (RR) interval in samples
+ * @return number of samples between the last two beats, 0 if less than two beats were detected
+ */
+template <class POLICY>
+uint32_t HEART_RATE_T<POLICY>::getLastRRSamples(void)
+{
+	return deltaSamples;
+}
 
-	return (z >> 15);
+/**
+ * @brief Set the sample period used for the beat timing
+ * By default the beat timing is taken from micros() when checkForBeat() is called.
+ * If the samples are buffered or processed offline, the timing should be derived
+ * from the sample count instead.
+ * @param periodUs
+ *      Sample period in microseconds (e.g. 8000 for BIO_SENS_RATE_125), 0 to use micros()
+ */
+template <class POLICY>
+void HEART_RATE_T<POLICY>::setSamplePeriod(uint32_t periodUs)
+{
+	samplePeriod = periodUs;
 }
 
 /**
- * Integer multiplier
+ * Average DC Estimator
+ * @param *p
+ *      DC estimator register
  * @param x
- *      ???
- * @param y
- *      ???
+ *      Sample value
  * @return result
- *      ???
+ *      Sample value without DC part
+ */
+template <class POLICY>
+typename POLICY::sample_t HEART_RATE_T<POLICY>::averageDCEstimator(typename POLICY::dc_t *p, int32_t x)
+{
+#if HR_USE_PARAMS
+	return POLICY::removeDC(p, x, params.dcShift);
+#else
+	return POLICY::removeDC(p, x, HR_DC_SHIFT);
+#endif
+}
+
+/**
+ * Get a coefficient of the low pass FIR
+ * @param idx
+ *      Index 0 to the center tap
+ * @return coefficient (Q15)
+ */
+template <class POLICY>
+inline int16_t HEART_RATE_T<POLICY>::firCoeff(uint8_t idx)
+{
+#if HR_USE_PARAMS
+	return firCoeffs[idx];
+#else
+	// Fixed default filter, read directly from flash
+	return (int16_t)pgm_read_word(&FIRCoeffs[idx]);
+#endif
+}
+
+/**
+ * Low pass FIR with a fixed number of coefficients
+ * The loop has constant bounds, the compiler unrolls it.
+ * @return FIR accumulator
  */
-int32_t HEART_RATE::mul16(int16_t x, int16_t y)
+template <class POLICY>
+template <uint8_t HALF>
+inline typename POLICY::acc_t HEART_RATE_T<POLICY>::firKernel(void)
 {
-	return ((long)x * (long)y);
+	typename POLICY::acc_t z = POLICY::mul(firCoeff(HALF), cbuf[(offset - HALF) & (HR_FIR_LINE - 1)]);
+
+	for (uint8_t i = 0; i < HALF; i++)
+	{
+		z += POLICY::mulPair(firCoeff(i), cbuf[(offset - i) & (HR_FIR_LINE - 1)], cbuf[(offset - 2 * HALF + i) & (HR_FIR_LINE - 1)]);
+	}
+	return z;
 }
+
+/**
+ * Low Pass FIR Filter
+ * @param din
+ *      AC part of the sample value
+ * @return result
+ *      Filtered AC signal
+ */
+template <class POLICY>
+typename POLICY::sample_t HEART_RATE_T<POLICY>::lowPassFIRFilter(sample_t din)
+{
+	offset = (offset + 1) & (HR_FIR_LINE - 1);
+	cbuf[offset] = din;
+
+	typename POLICY::acc_t z;
+#if HR_USE_PARAMS
+	// Fixed length kernels for the default FIR and its shortened versions for decimation 2 to 10
+	switch (firHalf)
+	{
+	case 11:
+		z = firKernel<11>();
+		break;
+	case 6:
+		z = firKernel<6>();
+		break;
+	case 4:
+		z = firKernel<4>();
+		break;
+	case 3:
+		z = firKernel<3>();
+		break;
+	case 2:
+		z = firKernel<2>();
+		break;
+	case 1:
+		z = firKernel<1>();
+		break;
+	default:
+		z = POLICY::mul(firCoeff(firHalf), cbuf[(offset - firHalf) & (HR_FIR_LINE - 1)]);
+		for (uint8_t i = 0; i < firHalf; i++)
+		{
+			z += POLICY::mulPair(firCoeff(i), cbuf[(offset - i) & (HR_FIR_LINE - 1)], cbuf[(offset - 2 * firHalf + i) & (HR_FIR_LINE - 1)]);
+		}
+		break;
+	}
+#else
+	z = firKernel<HR_FIR_MAX_COEFFS - 1>();
+#endif
+
+	return POLICY::fromAcc(z);
+}
+
+template class HEART_RATE_T<HR_POLICY_Q15>;
+template class HEART_RATE_T<HR_POLICY_Q31>;
+template class HEART_RATE_T<HR_POLICY_FLOAT>;
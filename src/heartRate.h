@@ -57,50 +57,316 @@
  * ownership rights.
  * 
  */
+#ifndef HEART_RATE_H
+#define HEART_RATE_H
 
 #if (ARDUINO >= 100)
 #include "Arduino.h"
-#else
+#elif defined(ARDUINO)
 #include "WProgram.h"
+#else
+#include "ppgPlatform.h"
+#endif
+
+#include "ppgConfig.h"
+#include "bpmSmoother.h"
+#if HR_USE_DECIMATION
+#include "hrDecimator.h"
+#endif
+#if HR_USE_MORPH
+#include "hrMorph.h"
+#endif
+#include "ppgTrace.h"
+
+/**
+ * Arithmetic policy Q15 (default)
+ * 16 bit signal path with 32 bit accumulator, best choice for 8 bit MCU's.
+ * Identical to the original PBA implementation.
+ */
+struct HR_POLICY_Q15
+{
+	typedef int16_t sample_t; ///< AC signal and FIR delay line
+	typedef int32_t acc_t;	  ///< FIR accumulator
+	typedef int32_t dc_t;	  ///< DC estimator register
+
+	/** DC estimator, returns AC part of sample x */
+	static sample_t removeDC(dc_t *p, int32_t x, uint8_t shift)
+	{
+		if (x < 0)
+		{
+			x = 0;
+		}
+		if (x > 0xFFFF)
+		{
+			x = 0xFFFF;
+		}
+		*p += (((x << 15) - *p) >> shift);
+		int32_t ac = x - (*p >> 15);
+		if (ac > 32767)
+		{
+			ac = 32767;
+		}
+		if (ac < -32768)
+		{
+			ac = -32768;
+		}
+		return (sample_t)ac;
+	}
+	/** Multiply a Q15 coefficient with the sum of a symmetric tap pair */
+	static acc_t mulPair(int16_t coeff, sample_t a, sample_t b)
+	{
+		return ((long)coeff * (long)(int16_t)(a + b));
+	}
+	/** Multiply a Q15 coefficient with a single tap */
+	static acc_t mul(int16_t coeff, sample_t a)
+	{
+		return ((long)coeff * (long)a);
+	}
+	/** Scale FIR accumulator back to signal */
+	static sample_t fromAcc(acc_t z)
+	{
+		return (sample_t)(z >> 15);
+	}
+	/** Convert a value in sensor counts to signal units */
+	static sample_t fromRaw(int32_t raw)
+	{
+		return (sample_t)raw;
+	}
+	/** Convert signal units to sensor counts, rounded down */
+	static int32_t toRaw(sample_t s)
+	{
+		return s;
+	}
+};
+
+/**
+ * Arithmetic policy Q31
+ * 32 bit signal path with 8 fractional bits and 64 bit accumulator.
+ * No truncation for sensor values near full scale.
+ */
+struct HR_POLICY_Q31
+{
+	typedef int32_t sample_t; ///< AC signal (Q8) and FIR delay line
+	typedef int64_t acc_t;	  ///< FIR accumulator
+	typedef int64_t dc_t;	  ///< DC estimator register (Q24)
+
+	/** DC estimator, returns AC part of sample x */
+	static sample_t removeDC(dc_t *p, int32_t x, uint8_t shift)
+	{
+		*p += ((((int64_t)x << 24) - *p) >> shift);
+		return (sample_t)((((int64_t)x << 24) - *p) >> 16);
+	}
+	/** Multiply a Q15 coefficient with the sum of a symmetric tap pair */
+	static acc_t mulPair(int16_t coeff, sample_t a, sample_t b)
+	{
+		return (int64_t)coeff * ((int64_t)a + b);
+	}
+	/** Multiply a Q15 coefficient with a single tap */
+	static acc_t mul(int16_t coeff, sample_t a)
+	{
+		return (int64_t)coeff * a;
+	}
+	/** Scale FIR accumulator back to signal */
+	static sample_t fromAcc(acc_t z)
+	{
+		return (sample_t)(z >> 15);
+	}
+	/** Convert a value in sensor counts to signal units */
+	static sample_t fromRaw(int32_t raw)
+	{
+		return raw * 256;
+	}
+	/** Convert signal units to sensor counts, rounded down */
+	static int32_t toRaw(sample_t s)
+	{
+		return s >> 8;
+	}
+};
+
+/**
+ * Arithmetic policy float
+ * For MCU's with FPU (ESP32, nRF52, SAMD51)
+ */
+struct HR_POLICY_FLOAT
+{
+	typedef float sample_t; ///< AC signal and FIR delay line
+	typedef float acc_t;	///< FIR accumulator
+	typedef float dc_t;		///< DC estimator register
+
+	/** DC estimator, returns AC part of sample x */
+	static sample_t removeDC(dc_t *p, int32_t x, uint8_t shift)
+	{
+		*p += ((float)x - *p) / (float)(1UL << shift);
+		return (float)x - *p;
+	}
+	/** Multiply a Q15 coefficient with the sum of a symmetric tap pair */
+	static acc_t mulPair(int16_t coeff, sample_t a, sample_t b)
+	{
+		return coeff * (1.0f / 32768.0f) * (a + b);
+	}
+	/** Multiply a Q15 coefficient with a single tap */
+	static acc_t mul(int16_t coeff, sample_t a)
+	{
+		return coeff * (1.0f / 32768.0f) * a;
+	}
+	/** Scale FIR accumulator back to signal */
+	static sample_t fromAcc(acc_t z)
+	{
+		return z;
+	}
+	/** Convert a value in sensor counts to signal units */
+	static sample_t fromRaw(int32_t raw)
+	{
+		return (float)raw;
+	}
+	/** Convert signal units to sensor counts, rounded down */
+	static int32_t toRaw(sample_t s)
+	{
+		return (int32_t)floorf(s);
+	}
+};
+
+/** Default lower limit of the beat amplitude in sensor counts, can be overridden at compile time */
+#ifndef HR_AMP_MIN
+#define HR_AMP_MIN 20
+#endif
+/** Default upper limit of the beat amplitude in sensor counts, can be overridden at compile time */
+#ifndef HR_AMP_MAX
+#define HR_AMP_MAX 1000
+#endif
+/** Default shift of the DC estimator, can be overridden at compile time */
+#ifndef HR_DC_SHIFT
+#define HR_DC_SHIFT 4
+#endif
+/** Maximum number of FIR coefficients, one half of the symmetric filter plus the center tap */
+#define HR_FIR_MAX_COEFFS 12
+/** Length of the FIR delay line, power of 2 above the 23 taps of the longest filter, the ring index wraps with a mask */
+#define HR_FIR_LINE 32
+
+#if HR_USE_PARAMS
+/**
+ * Beat detection parameters
+ * The constructor fills in the defaults of the original PBA implementation.
+ */
+struct HR_PARAMS
+{
+	/** Minimum peak to peak amplitude of a beat in sensor counts */
+	int32_t ampMin;
+	/** Maximum peak to peak amplitude of a beat in sensor counts, larger swings are treated as motion */
+	int32_t ampMax;
+	/** DC estimator shift 1 to 15, the DC estimate follows with a time constant of 2^dcShift samples */
+	uint8_t dcShift;
+	/** Index of the center tap of the low pass FIR, 0 to HR_FIR_MAX_COEFFS - 1 */
+	uint8_t firHalf;
+	/** Low pass FIR coefficients (Q15), one half of the symmetric filter, firCoeffs[firHalf] is the center tap */
+	int16_t firCoeffs[HR_FIR_MAX_COEFFS];
+
+	HR_PARAMS(void);
+};
 #endif
 
 /**
  * Heart rate calculation
+ * The arithmetic policy sets the types of the signal path and the filter kernels.
+ * Use HEART_RATE for the default Q15 policy.
  */
-class HEART_RATE
+template <class POLICY>
+class HEART_RATE_T
 {
 public:
-	HEART_RATE(void);
+	/** Type of the AC signal */
+	typedef typename POLICY::sample_t sample_t;
+
+	HEART_RATE_T(void);
 
 	bool checkForBeat(int32_t sample);
 	int getLastHR(void);
+	int getSmoothedHR(void);
+	uint8_t getHRConfidence(void);
+	uint32_t getLastRR(void);
+	uint32_t getLastRRSamples(void);
+	void setSamplePeriod(uint32_t periodUs);
+#if HR_USE_DECIMATION
+	bool setDecimation(uint8_t factor);
+#endif
+#if HR_USE_PARAMS
+	bool setParams(const HR_PARAMS &newParams);
+	const HR_PARAMS &getParams(void);
+#endif
+#if HR_USE_MORPH
+	void setMorph(HR_MORPH *newMorph);
+#endif
 
 private:
+	bool detectBeat(int32_t sample);
 	void calcHR(void);
-	int16_t averageDCEstimator(int32_t *p, uint16_t x);
-	int16_t lowPassFIRFilter(int16_t din);
-	int32_t mul16(int16_t x, int16_t y);
-
-	/** Time at which last beat occured */
-	long lastBeat;
-	/** Time between two heart beats */
-	long delta;
+#if HR_USE_PARAMS
+	void applyParams(void);
+#endif
+	sample_t averageDCEstimator(typename POLICY::dc_t *p, int32_t x);
+	sample_t lowPassFIRFilter(sample_t din);
+	template <uint8_t HALF>
+	typename POLICY::acc_t firKernel(void);
+	int16_t firCoeff(uint8_t idx);
+
+	/** Time at which last beat occured in microseconds */
+	uint32_t lastBeat;
+	/** Time between two heart beats in microseconds */
+	uint32_t delta;
+	/** Number of samples between two heart beats */
+	uint32_t deltaSamples;
+	/** Number of samples processed */
+	uint32_t sampleCount;
+	/** Sample number of last beat */
+	uint32_t lastBeatSample;
+	/** Sample period in microseconds, 0 to use micros() */
+	uint32_t samplePeriod;
+	/** Flag if a first beat was detected */
+	bool beatSeen;
 	/** Calculated heart rate */
 	int beatsPerMinute;
+	/** Running median of the heart rate */
+	BPM_SMOOTHER smoother;
+#if HR_USE_DECIMATION
+	/** Optional decimation ahead of the beat detection */
+	HR_DECIMATOR decimator;
+#endif
+#if HR_USE_MORPH
+	/** Optional pulse morphology features, NULL if not used */
+	HR_MORPH *morph = NULL;
+#endif
 
-	int16_t IR_AC_Max = 20;
-	int16_t IR_AC_Min = -20;
+	sample_t IR_AC_Max;
+	sample_t IR_AC_Min;
 
-	int16_t IR_AC_Signal_Current = 0;
-	int16_t IR_AC_Signal_Previous;
-	int16_t IR_AC_Signal_min = 0;
-	int16_t IR_AC_Signal_max = 0;
-	int16_t IR_Average_Estimated;
+	sample_t IR_AC_Signal_Current = 0;
+	sample_t IR_AC_Signal_Previous;
+	sample_t IR_AC_Signal_min = 0;
+	sample_t IR_AC_Signal_max = 0;
 
 	int16_t positiveEdge = 0;
 	int16_t negativeEdge = 0;
-	int32_t ir_avg_reg = 0;
+	typename POLICY::dc_t ir_avg_reg = 0;
+
+	/** Minimum beat amplitude in signal units */
+	sample_t ampMin;
+	/** Maximum beat amplitude in signal units */
+	sample_t ampMax;
+#if HR_USE_PARAMS
+	/** Beat detection parameters */
+	HR_PARAMS params;
+	/** FIR coefficients (Q15) in use, shortened if decimation is enabled */
+	int16_t firCoeffs[HR_FIR_MAX_COEFFS];
+	/** Index of the center tap of the FIR */
+	uint8_t firHalf;
+#endif
 
-	int16_t cbuf[32];
+	/** FIR delay line, ring buffer */
+	sample_t cbuf[HR_FIR_LINE];
+	/** Position of the newest sample in cbuf */
 	uint8_t offset = 0;
-};
\ No newline at end of file
+};
+
+/** Heart rate calculation with the default Q15 arithmetic */
+typedef HEART_RATE_T<HR_POLICY_Q15> HEART_RATE;
+#endif
@@ -0,0 +1,222 @@
+/**
+ * @file hrAutocorr.cpp
+ * @brief Heart rate period detection by incremental autocorrelation
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "hrAutocorr.h"
+
+/** Sample values are limited to 12 bit so that the lag products fit into 32 bit */
+#define HR_ACF_SAMPLE_LIMIT 2047
+
+HR_AUTOCORR::HR_AUTOCORR(float sampleRate, uint8_t decimation)
+{
+	// The lag of the lowest heart rate + 1 must fit into the history
+	float minDecimation = ceilf(sampleRate * 60.0 / HR_ACF_MIN_BPM / (HR_ACF_MAX_LAG - 1));
+	if (decimation < minDecimation)
+	{
+		decimation = (minDecimation > 16.0) ? 16 : (uint8_t)minDecimation;
+	}
+	if (decimation < 1)
+	{
+		decimation = 1;
+	}
+	if (decimation > 16)
+	{
+		decimation = 16;
+	}
+	_decimation = decimation;
+
+	float rate = sampleRate / decimation;
+	float lag = rate * 60.0 / HR_ACF_MAX_BPM;
+	_minLag = (lag < 2.0) ? 2 : (uint8_t)lag;
+	lag = rate * 60.0 / HR_ACF_MIN_BPM + 1.0;
+	_maxLag = (lag > HR_ACF_MAX_LAG) ? HR_ACF_MAX_LAG : (uint8_t)lag;
+	if (_minLag >= _maxLag)
+	{
+		_minLag = _maxLag - 1;
+	}
+	_bpmScale = (uint32_t)(sampleRate * 60.0 * 16.0);
+
+	for (uint8_t i = 0; i < (HR_ACF_MAX_LAG + 2); i++)
+	{
+		_hist[i] = 0;
+		_acf[i] = 0;
+	}
+}
+
+bool HR_AUTOCORR::addSample(int32_t sample)
+{
+	// Decimate by averaging
+	_decimAcc += sample;
+	_decimCount++;
+	if (_decimCount < _decimation)
+	{
+		return false;
+	}
+	int32_t value = _decimAcc / _decimation;
+	_decimAcc = 0;
+	_decimCount = 0;
+
+	// Remove DC with a running average (time constant 32 samples)
+	if (!_dcValid)
+	{
+		_dcReg = value << 8;
+		_dcValid = true;
+	}
+	_dcReg += ((value << 8) - _dcReg) >> 5;
+	value -= (_dcReg >> 8);
+	if (value > HR_ACF_SAMPLE_LIMIT)
+	{
+		value = HR_ACF_SAMPLE_LIMIT;
+	}
+	if (value < -HR_ACF_SAMPLE_LIMIT)
+	{
+		value = -HR_ACF_SAMPLE_LIMIT;
+	}
+
+	// Store sample in history
+	_histIdx++;
+	if (_histIdx >= (HR_ACF_MAX_LAG + 2))
+	{
+		_histIdx = 0;
+	}
+	_hist[_histIdx] = (int16_t)value;
+	if (_histFill < (HR_ACF_MAX_LAG + 2))
+	{
+		_histFill++;
+	}
+
+	// Update the running lag products, lag 0 for normalization and the
+	// lags one below and above the range for the peak interpolation
+	_acf[0] += (value * value - _acf[0]) >> HR_ACF_LEAK_SHIFT;
+	int16_t idx = _histIdx - (_minLag - 1);
+	if (idx < 0)
+	{
+		idx += HR_ACF_MAX_LAG + 2;
+	}
+	for (uint8_t lag = _minLag - 1; lag <= (_maxLag + 1); lag++)
+	{
+		if (lag < _histFill)
+		{
+			int32_t product = value * _hist[idx];
+			_acf[lag] += (product - _acf[lag]) >> HR_ACF_LEAK_SHIFT;
+		}
+		idx--;
+		if (idx < 0)
+		{
+			idx = HR_ACF_MAX_LAG + 1;
+		}
+	}
+	_dirty = true;
+	return true;
+}
+
+void HR_AUTOCORR::findPeak(void)
+{
+	_dirty = false;
+	_period = 0;
+	_confidence = 0;
+	if ((_histFill < (_maxLag + 2)) || (_acf[0] <= 0))
+	{
+		return;
+	}
+
+	// Highest local maximum in the lag range
+	int32_t best = 0;
+	for (uint8_t lag = _minLag; lag <= _maxLag; lag++)
+	{
+		if ((_acf[lag] > best) && (_acf[lag] >= _acf[lag - 1]) && (_acf[lag] >= _acf[lag + 1]))
+		{
+			best = _acf[lag];
+		}
+	}
+	if (best <= 0)
+	{
+		return;
+	}
+
+	// Multiples of the period correlate nearly as well as the period itself,
+	// take the shortest lag that comes close to the highest maximum
+	uint8_t peak = 0;
+	int32_t limit = best - (best >> 3);
+	for (uint8_t lag = _minLag; lag <= _maxLag; lag++)
+	{
+		if ((_acf[lag] >= limit) && (_acf[lag] >= _acf[lag - 1]) && (_acf[lag] >= _acf[lag + 1]))
+		{
+			peak = lag;
+			break;
+		}
+	}
+	if (peak == 0)
+	{
+		return;
+	}
+
+	// Parabolic interpolation, result in Q4
+	int32_t a = _acf[peak - 1];
+	int32_t b = _acf[peak];
+	int32_t c = _acf[peak + 1];
+	int32_t denom = a - 2 * b + c;
+	int32_t delta = 0;
+	if (denom < 0)
+	{
+		// Scale down to avoid overflow of the Q4 multiplication
+		delta = ((a - c) / 2 * 16) / denom;
+		if (delta > 8)
+		{
+			delta = 8;
+		}
+		if (delta < -8)
+		{
+			delta = -8;
+		}
+	}
+	_period = (uint16_t)(((int32_t)peak * 16 + delta) * _decimation);
+
+	int32_t confidence = (b / 16 * 100) / (_acf[0] / 16 + 1);
+	if (confidence > 100)
+	{
+		confidence = 100;
+	}
+	_confidence = (uint8_t)confidence;
+}
+
+uint16_t HR_AUTOCORR::getPeriod(void)
+{
+	if (_dirty)
+	{
+		findPeak();
+	}
+	return _period;
+}
+
+uint16_t HR_AUTOCORR::getBPM(void)
+{
+	uint16_t period = getPeriod();
+	if (period == 0)
+	{
+		return 0;
+	}
+	return (uint16_t)((_bpmScale + period / 2) / period);
+}
+
+uint8_t HR_AUTOCORR::getConfidence(void)
+{
+	if (_dirty)
+	{
+		findPeak();
+	}
+	return _confidence;
+}
+
+uint8_t HR_AUTOCORR::getDecimation(void)
+{
+	return _decimation;
+}
+
+uint16_t HR_AUTOCORR::getMinBPM(void)
+{
+	return (uint16_t)((_bpmScale / 16 + (uint32_t)_maxLag * _decimation - 1) / ((uint32_t)_maxLag * _decimation));
+}
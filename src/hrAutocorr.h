@@ -0,0 +1,106 @@
+/**
+ * @file hrAutocorr.h
+ * @brief Heart rate period detection by incremental autocorrelation
+ *
+ * @author   Bernd Giesecke
+ *
+ * Alternative to the PBA zero crossing detector in heartRate.h that is less
+ * sensitive to single disturbed beats, e.g. under motion.
+ * - Bio samples are decimated and DC corrected on input
+ * - For every lag in the physiological range a leaky running sum of the
+ *   lag product is updated per sample, the autocorrelation is never
+ *   recomputed from the sample history
+ * - Integer math only, memory is bounded by HR_ACF_MAX_LAG
+ */
+#ifndef HR_AUTOCORR_H
+#define HR_AUTOCORR_H
+
+#include "ppgPlatform.h"
+
+/** Highest lag in (decimated) samples, limits RAM usage */
+#define HR_ACF_MAX_LAG 48
+/** Leak of the running lag products, time constant is 2^HR_ACF_LEAK_SHIFT samples */
+#define HR_ACF_LEAK_SHIFT 6
+
+/** Lowest heart rate detected */
+#define HR_ACF_MIN_BPM 40
+/** Highest heart rate detected */
+#define HR_ACF_MAX_BPM 220
+
+/**
+ * Autocorrelation based heart rate period detection
+ */
+class HR_AUTOCORR
+{
+public:
+	/**
+	 * HR_AUTOCORR constructor
+	 * @param sampleRate
+	 * 		Bio sensor sample rate in samples/s (e.g. 125.0 for BIO_SENS_RATE_125)
+	 * @param decimation
+	 * 		Number of input samples averaged into one autocorrelation sample (1 to 16).
+	 * 		Values below the smallest factor that covers HR_ACF_MIN_BPM within
+	 * 		HR_ACF_MAX_LAG are raised to it, e.g. 4 for 125 samples/s or 8 for 250 samples/s.
+	 * 		0 selects this smallest factor
+	 */
+	HR_AUTOCORR(float sampleRate, uint8_t decimation = 0);
+
+	/**
+	 * Add a bio sensor sample
+	 * @param sample
+	 * 		Raw bio sensor value
+	 * @return result
+	 * 		TRUE if the autocorrelation was updated (once every decimation samples)
+	 */
+	bool addSample(int32_t sample);
+	/**
+	 * Get the dominant period
+	 * @return period in input samples (not decimated) in Q4 format (1/16 sample resolution),
+	 * 		0 if no period was found in the heart rate range
+	 */
+	uint16_t getPeriod(void);
+	/**
+	 * Get heart rate from the dominant period
+	 * @return heart rate in beats/minute, 0 if no period was found
+	 */
+	uint16_t getBPM(void);
+	/**
+	 * Get confidence of the dominant period
+	 * @return normalized autocorrelation at the dominant lag, 0 to 100
+	 */
+	uint8_t getConfidence(void);
+	/**
+	 * Get the decimation factor in use
+	 * @return input samples per autocorrelation sample
+	 */
+	uint8_t getDecimation(void);
+	/**
+	 * Get the lowest heart rate the lag range covers
+	 * @return heart rate in beats/minute, above HR_ACF_MIN_BPM only if the
+	 * 		sample rate is too high even for a decimation of 16
+	 */
+	uint16_t getMinBPM(void);
+
+private:
+	void findPeak(void);
+
+	uint8_t _decimation; ///< Input samples per autocorrelation sample
+	uint8_t _decimCount = 0; ///< Samples in decimation accumulator
+	int32_t _decimAcc = 0; ///< Decimation accumulator
+	int32_t _dcReg = 0; ///< DC estimator register (Q8)
+	bool _dcValid = false; ///< Flag if DC estimator is initialized
+
+	uint8_t _minLag; ///< Lag of highest heart rate
+	uint8_t _maxLag; ///< Lag of lowest heart rate
+	uint32_t _bpmScale; ///< 60 * sample rate * 16 for the BPM calculation from Q4 period
+
+	int16_t _hist[HR_ACF_MAX_LAG + 2]; ///< Sample history
+	uint8_t _histIdx = 0;			   ///< Position of the newest sample in the history
+	uint8_t _histFill = 0;			   ///< Number of valid samples in the history
+	int32_t _acf[HR_ACF_MAX_LAG + 2];  ///< Running lag products, index is the lag
+
+	bool _dirty = false;	///< Flag if the peak needs to be searched again
+	uint16_t _period = 0;	///< Last period in Q4 input samples
+	uint8_t _confidence = 0; ///< Last confidence
+};
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file hrDecimator.cpp
+ * @brief Anti-alias filter and polyphase decimation for the heart rate detection
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "hrDecimator.h"
+
+HR_DECIMATOR::HR_DECIMATOR(void)
+{
+	setFactor(1);
+}
+
+bool HR_DECIMATOR::setFactor(uint8_t factor)
+{
+	if ((factor < 1) || (factor > HR_DECIM_MAX_FACTOR))
+	{
+		return false;
+	}
+	_factor = factor;
+	_phase = 0;
+	_primed = false;
+	for (uint8_t j = 0; j < HR_DECIM_PHASES; j++)
+	{
+		_acc[j] = 0;
+	}
+	if (factor == 1)
+	{
+		return true;
+	}
+
+	// Windowed sinc low pass, cut off at 80% of the new Nyquist frequency.
+	// Calculated once here, the filter itself runs in integer math.
+	uint8_t taps = factor * HR_DECIM_PHASES;
+	float fc = 0.4 / factor;
+	float center = (taps - 1) / 2.0;
+	float sum = 0.0;
+	float h[HR_DECIM_MAX_FACTOR * HR_DECIM_PHASES];
+	for (uint8_t k = 0; k < taps; k++)
+	{
+		float x = k - center;
+		float sinc = 2.0 * fc * ((x == 0.0) ? 1.0 : (sin(2.0 * PI * fc * x) / (2.0 * PI * fc * x)));
+		float window = 0.54 - 0.46 * cos(2.0 * PI * k / (taps - 1));
+		h[k] = sinc * window;
+		sum += h[k];
+	}
+	// Normalize to unity gain at DC
+	for (uint8_t k = 0; k < taps; k++)
+	{
+		// Tap k = j * factor + (factor - 1 - phase) is used by input phase for output q + j
+		_coeffs[factor - 1 - k % factor][k / factor] = (int16_t)(h[k] / sum * 16384.0 + ((h[k] < 0.0) ? -0.5 : 0.5));
+	}
+	return true;
+}
+
+uint8_t HR_DECIMATOR::getFactor(void)
+{
+	return _factor;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file hrDecimator.h
+ * @brief Anti-alias filter and polyphase decimation for the heart rate detection
+ *
+ * @author   Bernd Giesecke
+ *
+ * The heart rate detection does not need the bandwidth of the higher bio sensor
+ * data rates. HR_DECIMATOR low pass filters and decimates the samples by a factor
+ * of 2 to HR_DECIM_MAX_FACTOR before they go into the DC estimator and beat detector.
+ *
+ * The filter has HR_DECIM_PHASES * factor taps. Every input sample is multiplied
+ * with one coefficient of each polyphase branch and added to the outputs it
+ * contributes to, so no delay line is needed and the cost per input sample is
+ * HR_DECIM_PHASES multiplications, independent of the decimation factor.
+ */
+#ifndef HR_DECIMATOR_H
+#define HR_DECIMATOR_H
+
+#include "ppgPlatform.h"
+
+/** Highest decimation factor */
+#define HR_DECIM_MAX_FACTOR 10
+/** Number of taps per polyphase branch */
+#define HR_DECIM_PHASES 4
+
+/**
+ * Polyphase decimator
+ */
+class HR_DECIMATOR
+{
+public:
+	HR_DECIMATOR(void);
+
+	/**
+	 * Set decimation factor and calculate the anti-alias filter
+	 * @param factor
+	 * 		Decimation factor, 1 (off) or 2 to HR_DECIM_MAX_FACTOR
+	 * @return result
+	 * 		FALSE if the factor is out of range
+	 */
+	bool setFactor(uint8_t factor);
+	/**
+	 * Get decimation factor
+	 * @return decimation factor, 1 if decimation is off
+	 */
+	uint8_t getFactor(void);
+	/**
+	 * Add an input sample
+	 * @param sample
+	 * 		Input sample (0 to 65535)
+	 * @param output
+	 * 		Pointer to int32_t variable for the decimated sample
+	 * @return result
+	 * 		TRUE if a decimated sample was written to output
+	 */
+	bool addSample(int32_t sample, int32_t *output);
+
+private:
+	uint8_t _factor = 1; ///< Decimation factor
+	uint8_t _phase = 0;	 ///< Position of the next input sample in the decimation cycle
+	bool _primed = false; ///< Flag if the accumulators were initialized with the first sample
+
+	int16_t _coeffs[HR_DECIM_MAX_FACTOR][HR_DECIM_PHASES]; ///< Filter coefficients (Q14) by input phase
+	int32_t _acc[HR_DECIM_PHASES];							///< Partial sums of the next outputs
+};
+
+/**
+ * Inline, it runs for every input sample. The coefficients of an input
+ * phase are stored next to each other.
+ */
+inline bool HR_DECIMATOR::addSample(int32_t sample, int32_t *output)
+{
+	if (_factor == 1)
+	{
+		*output = sample;
+		return true;
+	}
+
+	if (!_primed)
+	{
+		// Start from the first sample instead of 0 to avoid a large step into the
+		// DC estimator. Each output gets the share of the taps it has not seen yet.
+		for (uint8_t j = 0; j < HR_DECIM_PHASES; j++)
+		{
+			_acc[j] = (int32_t)(HR_DECIM_PHASES - 1 - j) * _factor * (sample * 16384 / (_factor * HR_DECIM_PHASES));
+		}
+		_primed = true;
+	}
+
+	// Input sample n = q * factor + phase contributes to output q + j
+	// with coefficient j * factor + (factor - 1 - phase)
+	const int16_t *c = _coeffs[_phase];
+	for (uint8_t j = 0; j < HR_DECIM_PHASES; j++)
+	{
+		_acc[j] += (int32_t)c[j] * sample;
+	}
+
+	_phase++;
+	if (_phase < _factor)
+	{
+		return false;
+	}
+	_phase = 0;
+
+	*output = (_acc[0] + 8192) >> 14;
+	for (uint8_t j = 0; j < (HR_DECIM_PHASES - 1); j++)
+	{
+		_acc[j] = _acc[j + 1];
+	}
+	_acc[HR_DECIM_PHASES - 1] = 0;
+	return true;
+}
+#endif
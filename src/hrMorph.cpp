@@ -0,0 +1,245 @@
+/**
+ * @file hrMorph.cpp
+ * @brief Per beat pulse morphology features
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "hrMorph.h"
+
+HR_MORPH::HR_MORPH(void)
+{
+	reset();
+}
+
+void HR_MORPH::reset(void)
+{
+	memset(&_last, 0, sizeof(HR_MORPH_FEATURES));
+	_lastValid = false;
+	_count = 0;
+	_started = false;
+	_crossed = false;
+	_haveFoot = false;
+}
+
+bool HR_MORPH::getFeatures(HR_MORPH_FEATURES *features)
+{
+	if (!_lastValid)
+	{
+		return false;
+	}
+	*features = _last;
+	return true;
+}
+
+uint32_t HR_MORPH::getCount(void)
+{
+	return _count;
+}
+
+bool HR_MORPH::addSample(uint32_t sampleIndex, int32_t value, int32_t ac, bool beat)
+{
+	if (!_started)
+	{
+		_started = true;
+		_crossed = false;
+		_haveFoot = false;
+		_smooth = value << HR_MORPH_SMOOTH_SHIFT;
+		_lastIndex = sampleIndex;
+		_lastValue = value;
+		_lastAc = ac;
+		_lastSlope = 0;
+		_lastSlope2 = 0;
+		_footIndex = sampleIndex;
+		_footValue = value;
+		_area = 0;
+		_upSlope = 0;
+		setPeak(sampleIndex, value, 0);
+		return false;
+	}
+
+	// Light low pass, the features need the shape of the sensor value
+	_smooth += value - (_smooth >> HR_MORPH_SMOOTH_SHIFT);
+	value = _smooth >> HR_MORPH_SMOOTH_SHIFT;
+
+	uint32_t step = sampleIndex - _lastIndex;
+	if (step == 0)
+	{
+		step = 1;
+	}
+	int32_t slope = (value - _lastValue) / (int32_t)step;
+	_area += (value - _footValue) * (int32_t)step;
+
+	bool completed = false;
+	if ((_lastAc > 0) && (ac <= 0))
+	{
+		// Falling zero crossing, the systolic peak is over
+		_peakLocked = true;
+	}
+
+	if ((_lastAc < 0) && (ac >= 0))
+	{
+		// Rising zero crossing, the foot candidate is final
+		completed = finishPulse(sampleIndex, beat);
+
+		// Next pulse starts at the foot candidate, its upstroke was tracked since then.
+		// Before the first crossing the candidate is the lowest value since the start,
+		// e.g. in the settling of the AC filter, it is a foot only from the second crossing on.
+		uint32_t sinceFoot = sampleIndex - _minIndex;
+		_area -= _minArea + (int32_t)sinceFoot * (_minValue - _footValue);
+		_footIndex = _minIndex;
+		_footValue = _minValue;
+		_haveFoot = _crossed;
+		_crossed = true;
+		_upSlope = (_minSlope > slope) ? _minSlope : slope;
+		setPeak(_riseIndex, _riseValue, _riseSlope);
+		if (value < _riseValue)
+		{
+			setMin(sampleIndex, value);
+		}
+		else if (value > _peakValue)
+		{
+			setPeak(sampleIndex, value, _upSlope);
+		}
+	}
+	else
+	{
+		if (!_peakLocked && (slope > _upSlope))
+		{
+			_upSlope = slope;
+		}
+		if (!_peakLocked && (value > _peakValue))
+		{
+			setPeak(sampleIndex, value, _upSlope);
+		}
+		else
+		{
+			if (!_haveNotch && (_lastIndex > _peakIndex))
+			{
+				if ((_minIndex > _peakIndex) && ((value - _minValue) * HR_MORPH_NOTCH_HYST > (_peakValue - _minValue)))
+				{
+					// First local minimum after the peak, the value rose again by a part of the descent
+					_haveNotch = true;
+					_notchIndex = _minIndex;
+					_notchValue = _minValue;
+				}
+				else if (!_peakLocked && (_lastSlope < 0) && (_lastSlope > _lastSlope2) && (_lastSlope > slope))
+				{
+					// Descent slows down and speeds up again
+					if (!_haveInfl || (_lastSlope > _inflSlope))
+					{
+						_haveInfl = true;
+						_inflIndex = _lastIndex;
+						_inflValue = _lastValue;
+						_inflSlope = _lastSlope;
+					}
+				}
+			}
+			if (value < _minValue)
+			{
+				setMin(sampleIndex, value);
+			}
+			else
+			{
+				if (slope > _minSlope)
+				{
+					_minSlope = slope;
+				}
+				if (value > _riseValue)
+				{
+					_riseIndex = sampleIndex;
+					_riseValue = value;
+					_riseSlope = _minSlope;
+				}
+			}
+		}
+	}
+
+	_lastSlope2 = _lastSlope;
+	_lastSlope = slope;
+	_lastIndex = sampleIndex;
+	_lastValue = value;
+	_lastAc = ac;
+	return completed;
+}
+
+bool HR_MORPH::finishPulse(uint32_t sampleIndex, bool beat)
+{
+	_lastValid = false;
+	if (!_haveFoot)
+	{
+		return false;
+	}
+	uint32_t duration = _minIndex - _footIndex;
+	if ((duration == 0) || (duration > HR_MORPH_MAX_LENGTH) || (_peakIndex <= _footIndex) || (_peakIndex >= _minIndex))
+	{
+		return false;
+	}
+
+	HR_MORPH_FEATURES rec;
+	int32_t amplitude = _peakValue - _footValue;
+	rec.beatSample = sampleIndex;
+	rec.amplitude = (amplitude > 0xFFFF) ? 0xFFFF : (uint16_t)amplitude;
+	rec.riseTime = (uint16_t)(_peakIndex - _footIndex);
+	rec.duration = (uint16_t)duration;
+	rec.maxSlope = (_peakSlope > 0xFFFF) ? 0xFFFF : (uint16_t)((_peakSlope > 0) ? _peakSlope : 0);
+	rec.notchType = 0;
+	rec.notchDelay = 0;
+	rec.notchHeight = 0;
+
+	// A local minimum at the foot candidate is no notch, the inflection is used then
+	uint32_t notchIndex = 0;
+	int32_t notchValue = 0;
+	if (_haveNotch && (_notchIndex < _minIndex))
+	{
+		rec.notchType = HR_MORPH_NOTCH;
+		notchIndex = _notchIndex;
+		notchValue = _notchValue;
+	}
+	else if (_haveInfl && (_inflIndex < _minIndex))
+	{
+		rec.notchType = HR_MORPH_INFLECTION;
+		notchIndex = _inflIndex;
+		notchValue = _inflValue;
+	}
+	if ((rec.notchType != 0) && (amplitude > 0))
+	{
+		int32_t height = (int32_t)(((int64_t)(notchValue - _footValue) * 100) / amplitude);
+		rec.notchDelay = (uint16_t)(notchIndex - _peakIndex);
+		rec.notchHeight = (height < 0) ? 0 : ((height > 100) ? 100 : (uint8_t)height);
+	}
+
+	// Baseline is the straight line between both feet
+	rec.area = (int32_t)(_minArea - ((int64_t)(_minValue - _footValue) * (int64_t)duration) / 2);
+
+	if (!beat)
+	{
+		return false;
+	}
+	_last = rec;
+	_lastValid = true;
+	_count++;
+	return true;
+}
+
+void HR_MORPH::setPeak(uint32_t sampleIndex, int32_t value, int32_t slope)
+{
+	_peakIndex = sampleIndex;
+	_peakValue = value;
+	_peakSlope = slope;
+	_peakLocked = false;
+	_haveNotch = false;
+	_haveInfl = false;
+	setMin(sampleIndex, value);
+}
+
+void HR_MORPH::setMin(uint32_t sampleIndex, int32_t value)
+{
+	_minIndex = sampleIndex;
+	_minValue = value;
+	_minArea = _area;
+	_minSlope = 0;
+	_riseIndex = sampleIndex;
+	_riseValue = value;
+	_riseSlope = 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file hrMorph.h
+ * @brief Per beat pulse morphology features
+ *
+ * @author   Bernd Giesecke
+ *
+ * HR_MORPH is attached to HEART_RATE with setMorph() and gets every sample of the
+ * beat detection. The features are updated incrementally with each sample, no
+ * samples are buffered. They are taken from the sensor value with a light low pass,
+ * the filtered AC signal of the beat detection is too much high passed for the
+ * pulse shape and is only used for the cycle timing.
+ * A pulse goes from one foot (minimum before the upstroke) to the next. Its record
+ * is complete at the beat after its second foot, i.e. one beat after its own upstroke.
+ * - Amplitude from foot to systolic peak
+ * - Rise time from foot to peak and steepest upstroke slope
+ * - Dicrotic notch, the first local minimum after the peak or, if the notch is
+ *   smoothed out, the point where the descent is slowest (inflection).
+ *   The notch is only a few counts deep, with sensor noise in the same range
+ *   the first noise dip is reported as notch.
+ * - Area above the straight line between both feet
+ *
+ * Times are in input samples of HEART_RATE, also if decimation is enabled.
+ * Values are in sensor counts.
+ */
+#ifndef HR_MORPH_H
+#define HR_MORPH_H
+
+#include "ppgPlatform.h"
+
+/** Longest pulse in input samples, longer cycles are dropped */
+#define HR_MORPH_MAX_LENGTH 65535
+/** Low pass of the sensor value, time constant of 2^HR_MORPH_SMOOTH_SHIFT samples */
+#ifndef HR_MORPH_SMOOTH_SHIFT
+#define HR_MORPH_SMOOTH_SHIFT 1
+#endif
+/** A local minimum after the peak counts as notch if the value rises again by 1/HR_MORPH_NOTCH_HYST of the descent */
+#ifndef HR_MORPH_NOTCH_HYST
+#define HR_MORPH_NOTCH_HYST 64
+#endif
+
+/** Dicrotic notch is a local minimum */
+#define HR_MORPH_NOTCH 0x01
+/** Dicrotic notch is an inflection of the descent */
+#define HR_MORPH_INFLECTION 0x02
+
+/**
+ * Features of one pulse, 20 bytes
+ */
+struct HR_MORPH_FEATURES
+{
+	uint32_t beatSample;  ///< Input sample of the beat that completed the record
+	uint16_t amplitude;	  ///< Foot to systolic peak in sensor counts
+	uint16_t riseTime;	  ///< Foot to systolic peak in samples
+	uint16_t duration;	  ///< Foot to next foot in samples
+	uint16_t maxSlope;	  ///< Steepest upstroke in sensor counts per sample
+	uint16_t notchDelay;  ///< Systolic peak to dicrotic notch in samples, 0 if no notch was found
+	uint8_t notchHeight;  ///< Dicrotic notch above the foot in percent of the amplitude
+	uint8_t notchType;	  ///< HR_MORPH_NOTCH, HR_MORPH_INFLECTION or 0 if no notch was found
+	int32_t area;		  ///< Area above the foot to foot baseline in sensor counts * samples
+};
+
+/**
+ * Streaming pulse morphology extractor
+ */
+class HR_MORPH
+{
+public:
+	HR_MORPH(void);
+
+	/**
+	 * Add a sample, called by HEART_RATE::checkForBeat()
+	 * @param sampleIndex
+	 * 		Input sample count of HEART_RATE
+	 * @param value
+	 * 		Sensor value (decimated if decimation is enabled)
+	 * @param ac
+	 * 		Filtered AC signal of the beat detection in sensor counts
+	 * @param beat
+	 * 		TRUE if HEART_RATE detected a beat with this sample
+	 * @return result
+	 * 		TRUE if a feature record was completed with this sample
+	 */
+	bool addSample(uint32_t sampleIndex, int32_t value, int32_t ac, bool beat);
+	/**
+	 * Get the features of the pulse completed by the last beat
+	 * Call after HEART_RATE::checkForBeat() returned TRUE
+	 * @param features
+	 * 		Pointer to the record to fill
+	 * @return result
+	 * 		FALSE if the last beat did not complete a record, e.g. the first beat
+	 */
+	bool getFeatures(HR_MORPH_FEATURES *features);
+	/**
+	 * Get number of completed records
+	 * @return number of records since the start or the last reset()
+	 */
+	uint32_t getCount(void);
+	/**
+	 * Forget the current pulse, e.g. after the sensor was moved
+	 */
+	void reset(void);
+
+private:
+	bool finishPulse(uint32_t sampleIndex, bool beat);
+	void setPeak(uint32_t sampleIndex, int32_t value, int32_t slope);
+	void setMin(uint32_t sampleIndex, int32_t value);
+
+	HR_MORPH_FEATURES _last;  ///< Last completed record
+	bool _lastValid = false;  ///< Flag if the last beat completed a record
+	uint32_t _count = 0;	  ///< Number of completed records
+
+	bool _started = false;	  ///< Flag if a first sample was added
+	bool _crossed = false;	  ///< Flag if a rising zero crossing was seen, the foot candidate before it is no real foot
+	bool _haveFoot = false;	  ///< Flag if the foot of the current pulse is known
+	int32_t _smooth = 0;	  ///< Low pass register, sensor value << HR_MORPH_SMOOTH_SHIFT
+	uint32_t _lastIndex = 0;  ///< Sample index of the previous sample
+	int32_t _lastValue = 0;	  ///< Previous low passed value
+	int32_t _lastAc = 0;	  ///< Previous AC value
+	int32_t _lastSlope = 0;	  ///< Slope of the previous sample
+	int32_t _lastSlope2 = 0;  ///< Slope of the sample before
+
+	uint32_t _footIndex = 0;  ///< Foot of the current pulse
+	int32_t _footValue = 0;	  ///< Foot value of the current pulse
+	int32_t _area = 0;		  ///< Sum of value - foot value since the foot
+
+	uint32_t _peakIndex = 0;  ///< Systolic peak of the current pulse
+	int32_t _peakValue = 0;	  ///< Systolic peak value
+	int32_t _upSlope = 0;	  ///< Steepest slope since the foot
+	int32_t _peakSlope = 0;	  ///< Steepest slope between the foot and the peak
+	bool _peakLocked = false; ///< Flag if the peak is final, set at the falling zero crossing of the AC signal
+
+	bool _haveNotch = false;  ///< Flag if a local minimum after the peak was found
+	uint32_t _notchIndex = 0; ///< First local minimum after the peak
+	int32_t _notchValue = 0;  ///< Value of the local minimum
+	bool _haveInfl = false;	  ///< Flag if an inflection after the peak was found
+	uint32_t _inflIndex = 0;  ///< Slowest descent after the peak
+	int32_t _inflValue = 0;	  ///< Value at the slowest descent
+	int32_t _inflSlope = 0;	  ///< Slope at the slowest descent
+
+	uint32_t _minIndex = 0;	  ///< Lowest value since the peak, candidate for the next foot
+	int32_t _minValue = 0;	  ///< Value of the candidate
+	int32_t _minArea = 0;	  ///< _area at the candidate
+	int32_t _minSlope = 0;	  ///< Steepest slope since the candidate
+	uint32_t _riseIndex = 0;  ///< Highest value since the candidate, peak of the next pulse
+	int32_t _riseValue = 0;	  ///< Highest value since the candidate
+	int32_t _riseSlope = 0;	  ///< Steepest slope between the candidate and the highest value
+};
+#endif
@@ -0,0 +1,176 @@
+/**
+ * @file hrNlms.cpp
+ * @brief Adaptive noise canceller with reference channels (fixed-point NLMS)
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "hrNlms.h"
+
+/** Lower limit of the normalization power, keeps the step bounded for quiet references */
+#define HR_NLMS_MIN_POWER 256
+/** Limit of the normalized step, keeps the update inside 64 bit */
+#define HR_NLMS_MAX_GAIN (1LL << 40)
+
+HR_NLMS::HR_NLMS(uint8_t numRefs, uint8_t taps, uint16_t stepQ15)
+{
+	if (numRefs < 1)
+	{
+		numRefs = 1;
+	}
+	if (numRefs > HR_NLMS_MAX_REFS)
+	{
+		numRefs = HR_NLMS_MAX_REFS;
+	}
+	if (taps < 1)
+	{
+		taps = 1;
+	}
+	if (taps > HR_NLMS_MAX_TAPS)
+	{
+		taps = HR_NLMS_MAX_TAPS;
+	}
+	_numRefs = numRefs;
+	_taps = taps;
+	_step = stepQ15;
+	reset();
+}
+
+void HR_NLMS::reset(void)
+{
+	_primed = false;
+	_bioDC = 0;
+	_pos = 0;
+	_noise = 0;
+	for (uint8_t r = 0; r < HR_NLMS_MAX_REFS; r++)
+	{
+		_refDC[r] = 0;
+		_power[r] = 0;
+		for (uint8_t t = 0; t < HR_NLMS_MAX_TAPS; t++)
+		{
+			_x[r][t] = 0;
+			_w[r][t] = 0;
+		}
+	}
+}
+
+void HR_NLMS::setStep(uint16_t stepQ15)
+{
+	_step = stepQ15;
+}
+
+int32_t HR_NLMS::process(int32_t bio, int32_t ref)
+{
+	return process(bio, &ref);
+}
+
+int32_t HR_NLMS::process(int32_t bio, const int32_t *refs)
+{
+	if (!_primed)
+	{
+		// Start the DC estimators at the first values instead of 0
+		_bioDC = bio * 256;
+		for (uint8_t r = 0; r < _numRefs; r++)
+		{
+			_refDC[r] = refs[r] * 256;
+		}
+		_primed = true;
+	}
+
+	// Shift the new reference samples in, keep the power of each channel up to date
+	_pos = (_pos + 1) % _taps;
+	for (uint8_t r = 0; r < _numRefs; r++)
+	{
+		int16_t x = removeDC(&_refDC[r], refs[r]);
+		int16_t old = _x[r][_pos];
+		_power[r] += (int32_t)x * x - (int32_t)old * old;
+		_x[r][_pos] = x;
+	}
+
+	// Estimate of the disturbance
+	int16_t d = removeDC(&_bioDC, bio);
+	int64_t acc = 0;
+	for (uint8_t r = 0; r < _numRefs; r++)
+	{
+		uint8_t idx = _pos;
+		for (uint8_t t = 0; t < _taps; t++)
+		{
+			acc += (int64_t)_w[r][t] * _x[r][idx];
+			idx = (idx == 0) ? (_taps - 1) : (idx - 1);
+		}
+	}
+	_noise = (int32_t)(acc >> 16);
+	int32_t error = d - _noise;
+	if (_step == 0)
+	{
+		return bio - _noise;
+	}
+
+	// Normalized update per channel, so weak references adapt as fast as strong ones.
+	// The step is shared by the channels, the power is rounded down to a power of 2.
+	int64_t stepError = (int64_t)_step * error * (1LL << 17) / _numRefs;
+	for (uint8_t r = 0; r < _numRefs; r++)
+	{
+		int64_t power = (_power[r] > HR_NLMS_MIN_POWER) ? _power[r] : HR_NLMS_MIN_POWER;
+		uint8_t shift = 0;
+		while ((power >> shift) > 1)
+		{
+			shift++;
+		}
+		// gain (Q32) = step * error / power
+		int64_t gain = stepError >> shift;
+		if (gain > HR_NLMS_MAX_GAIN)
+		{
+			gain = HR_NLMS_MAX_GAIN;
+		}
+		if (gain < -HR_NLMS_MAX_GAIN)
+		{
+			gain = -HR_NLMS_MAX_GAIN;
+		}
+		uint8_t idx = _pos;
+		for (uint8_t t = 0; t < _taps; t++)
+		{
+			// Rounded, truncation would let the weights drift
+			_w[r][t] += (int32_t)((gain * _x[r][idx] + 32768) >> 16);
+			idx = (idx == 0) ? (_taps - 1) : (idx - 1);
+		}
+	}
+	return bio - _noise;
+}
+
+int32_t HR_NLMS::getLastNoise(void)
+{
+	return _noise;
+}
+
+int32_t HR_NLMS::getWeight(uint8_t ref, uint8_t tap)
+{
+	if ((ref >= _numRefs) || (tap >= _taps))
+	{
+		return 0;
+	}
+	return _w[ref][tap];
+}
+
+/**
+ * DC estimator
+ * @param reg
+ * 		DC estimator register (Q8)
+ * @param x
+ * 		Sample value
+ * @return AC part of the sample, limited to 16 bit
+ */
+int16_t HR_NLMS::removeDC(int32_t *reg, int32_t x)
+{
+	*reg += ((x * 256) - *reg) >> HR_NLMS_DC_SHIFT;
+	int32_t ac = x - (*reg >> 8);
+	if (ac > 32767)
+	{
+		ac = 32767;
+	}
+	if (ac < -32768)
+	{
+		ac = -32768;
+	}
+	return (int16_t)ac;
+}
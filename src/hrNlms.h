@@ -0,0 +1,116 @@
+/**
+ * @file hrNlms.h
+ * @brief Adaptive noise canceller with reference channels (fixed-point NLMS)
+ *
+ * @author   Bernd Giesecke
+ *
+ * Ambient light flicker and motion couple into the bio sensor signal. If the
+ * disturbance is also measured on a reference channel (ambient light value of
+ * the VCNL4020C, accelerometer axes), HR_NLMS learns the coupling with a
+ * normalized LMS filter and subtracts it from the bio signal before it goes
+ * into HEART_RATE::checkForBeat().
+ * - Up to HR_NLMS_MAX_REFS reference channels with up to HR_NLMS_MAX_TAPS taps each
+ * - Integer math only, 16 bit signals, 32 bit weights, 64 bit accumulator
+ * - The step is normalized by the power of each reference channel rounded to
+ *   a power of 2, no division per sample
+ * - Cost per sample is refs * taps multiply-accumulates for the filter and the same for the update
+ */
+#ifndef HR_NLMS_H
+#define HR_NLMS_H
+
+#include "ppgPlatform.h"
+
+/** Highest number of reference channels */
+#define HR_NLMS_MAX_REFS 4
+/** Highest number of taps per reference channel */
+#define HR_NLMS_MAX_TAPS 8
+/** Default adaptation step (Q15), 1/512 */
+#define HR_NLMS_DEFAULT_STEP 64
+/**
+ * DC estimator shift of the bio and reference channels.
+ * Only the DC level is removed, the disturbance is estimated with its low
+ * frequencies, otherwise they would stay in the output.
+ */
+#ifndef HR_NLMS_DC_SHIFT
+#define HR_NLMS_DC_SHIFT 10
+#endif
+
+/**
+ * Adaptive noise canceller
+ */
+class HR_NLMS
+{
+public:
+	/**
+	 * HR_NLMS constructor
+	 * @param numRefs
+	 * 		Number of reference channels, 1 to HR_NLMS_MAX_REFS
+	 * @param taps
+	 * 		Number of taps per reference channel, 1 to HR_NLMS_MAX_TAPS.
+	 * 		1 is enough for a disturbance that couples without delay (ambient light),
+	 * 		more taps follow a coupling with delay or filtering (motion)
+	 * @param stepQ15
+	 * 		Adaptation step (Q15), larger steps adapt faster but leave more residual noise
+	 */
+	HR_NLMS(uint8_t numRefs = 1, uint8_t taps = 4, uint16_t stepQ15 = HR_NLMS_DEFAULT_STEP);
+
+	/**
+	 * Remove the disturbance from a bio sensor sample
+	 * @param bio
+	 * 		Raw bio sensor value
+	 * @param refs
+	 * 		Reference values sampled together with the bio value, one per channel
+	 * @return bio value without the part that is correlated with the references
+	 */
+	int32_t process(int32_t bio, const int32_t *refs);
+	/**
+	 * Remove the disturbance from a bio sensor sample, single reference channel
+	 * @param bio
+	 * 		Raw bio sensor value
+	 * @param ref
+	 * 		Reference value sampled together with the bio value
+	 * @return bio value without the part that is correlated with the reference
+	 */
+	int32_t process(int32_t bio, int32_t ref);
+	/**
+	 * Set the adaptation step
+	 * @param stepQ15
+	 * 		Adaptation step (Q15), 0 freezes the weights
+	 */
+	void setStep(uint16_t stepQ15);
+	/**
+	 * Get the disturbance removed from the last sample
+	 * @return estimated disturbance in sensor counts
+	 */
+	int32_t getLastNoise(void);
+	/**
+	 * Get a filter weight
+	 * @param ref
+	 * 		Reference channel
+	 * @param tap
+	 * 		Tap, 0 is the current sample
+	 * @return weight (Q16)
+	 */
+	int32_t getWeight(uint8_t ref, uint8_t tap);
+	/**
+	 * Clear weights, delay lines and DC estimators
+	 */
+	void reset(void);
+
+private:
+	int16_t removeDC(int32_t *reg, int32_t x);
+
+	uint8_t _numRefs;  ///< Number of reference channels
+	uint8_t _taps;	   ///< Taps per reference channel
+	uint16_t _step;	   ///< Adaptation step (Q15)
+	bool _primed;	   ///< Flag if the DC estimators are initialized
+
+	int32_t _bioDC;						///< DC estimator register of the bio channel (Q8)
+	int32_t _refDC[HR_NLMS_MAX_REFS];	///< DC estimator registers of the references (Q8)
+	int16_t _x[HR_NLMS_MAX_REFS][HR_NLMS_MAX_TAPS]; ///< Reference delay lines
+	int32_t _w[HR_NLMS_MAX_REFS][HR_NLMS_MAX_TAPS]; ///< Filter weights (Q16)
+	uint8_t _pos;						///< Position of the newest sample in the delay lines
+	int64_t _power[HR_NLMS_MAX_REFS];	///< Sum of the squares of the delay line samples per channel
+	int32_t _noise;						///< Disturbance removed from the last sample
+};
+#endif
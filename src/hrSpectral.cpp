@@ -0,0 +1,321 @@
+/**
+ * @file hrSpectral.cpp
+ * @brief Spectral heart rate estimation (windowed fixed-point FFT)
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "hrSpectral.h"
+
+int16_t HR_SPECTRAL::_sinTable[HR_SPECTRAL_FFT_SIZE * 3 / 4];
+int16_t HR_SPECTRAL::_hannTable[HR_SPECTRAL_FFT_SIZE / 2];
+bool HR_SPECTRAL::_tablesReady = false;
+
+HR_SPECTRAL::HR_SPECTRAL(float sampleRate, uint8_t decimation)
+{
+	_frame = 0;
+	if (decimation < 1)
+	{
+		decimation = 1;
+	}
+	if (decimation > 16)
+	{
+		decimation = 16;
+	}
+	_decimation = decimation;
+
+	_binHz = (sampleRate / decimation) / HR_SPECTRAL_FFT_SIZE;
+	_binMin = (uint16_t)((HR_SPECTRAL_MIN_BPM / 60.0) / _binHz);
+	_binMax = (uint16_t)((HR_SPECTRAL_MAX_BPM / 60.0) / _binHz + 1);
+	// Keep one bin on each side for the peak interpolation
+	if (_binMin < 2)
+	{
+		_binMin = 2;
+	}
+	if (_binMax > (HR_SPECTRAL_FFT_SIZE / 2 - 2))
+	{
+		_binMax = HR_SPECTRAL_FFT_SIZE / 2 - 2;
+	}
+
+	initTables();
+}
+
+void HR_SPECTRAL::initTables(void)
+{
+	if (_tablesReady)
+	{
+		return;
+	}
+	for (uint16_t i = 0; i < (HR_SPECTRAL_FFT_SIZE * 3 / 4); i++)
+	{
+		_sinTable[i] = (int16_t)(32767.0 * sin(2.0 * PI * i / HR_SPECTRAL_FFT_SIZE));
+	}
+	for (uint16_t i = 0; i < (HR_SPECTRAL_FFT_SIZE / 2); i++)
+	{
+		_hannTable[i] = (int16_t)(32767.0 * 0.5 * (1.0 - cos(2.0 * PI * i / (HR_SPECTRAL_FFT_SIZE - 1))));
+	}
+	_tablesReady = true;
+}
+
+bool HR_SPECTRAL::addSample(int32_t sample)
+{
+	// Decimate by averaging
+	_decimAcc += sample;
+	_decimCount++;
+	if (_decimCount < _decimation)
+	{
+		return false;
+	}
+	int32_t value = _decimAcc / _decimation;
+	_decimAcc = 0;
+	_decimCount = 0;
+
+	// Remove DC with a running average (time constant 64 samples)
+	if (!_dcValid)
+	{
+		_dcReg = value << 8;
+		_dcValid = true;
+	}
+	_dcReg += ((value << 8) - _dcReg) >> 6;
+	value -= (_dcReg >> 8);
+	if (value > 32767)
+	{
+		value = 32767;
+	}
+	if (value < -32768)
+	{
+		value = -32768;
+	}
+
+	_ring[_writeIdx] = (int16_t)value;
+	_writeIdx = (_writeIdx + 1) & (2 * HR_SPECTRAL_FFT_SIZE - 1);
+
+	if (_filled < HR_SPECTRAL_FFT_SIZE)
+	{
+		_filled++;
+		if (_filled < HR_SPECTRAL_FFT_SIZE)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		_hopCount++;
+		if (_hopCount < HR_SPECTRAL_HOP)
+		{
+			return false;
+		}
+	}
+	_hopCount = 0;
+
+	uint16_t frame = ((_writeIdx - HR_SPECTRAL_FFT_SIZE) & (2 * HR_SPECTRAL_FFT_SIZE - 1)) | HR_SPECTRAL_FRAME_READY;
+#ifdef PPG_HAS_THREADS
+	uint16_t previous = _frame.exchange(frame);
+#else
+	// Runs in the interrupt or in the same task as process(), nothing can come in between
+	uint16_t previous = _frame;
+	_frame = frame;
+#endif
+	if (previous & HR_SPECTRAL_FRAME_READY)
+	{
+		// Previous frame was not processed, it is replaced by the new one
+		_overruns++;
+	}
+	return true;
+}
+
+bool HR_SPECTRAL::frameReady(void)
+{
+	return (_frame & HR_SPECTRAL_FRAME_READY) != 0;
+}
+
+bool HR_SPECTRAL::process(void)
+{
+	// Take the frame and clear the flag in one step, a newer frame is either taken or stays ready
+#ifdef PPG_HAS_THREADS
+	uint16_t frame = _frame.exchange(0);
+#else
+	noInterrupts();
+	uint16_t frame = _frame;
+	_frame = 0;
+	interrupts();
+#endif
+	if ((frame & HR_SPECTRAL_FRAME_READY) == 0)
+	{
+		return false;
+	}
+	uint16_t start = frame & (2 * HR_SPECTRAL_FFT_SIZE - 1);
+
+	// Window the frame directly out of the sample ring
+	int16_t maxAbs = 1;
+	for (uint16_t i = 0; i < HR_SPECTRAL_FFT_SIZE; i++)
+	{
+		uint16_t w = (i < (HR_SPECTRAL_FFT_SIZE / 2)) ? i : (HR_SPECTRAL_FFT_SIZE - 1 - i);
+		int16_t x = _ring[(start + i) & (2 * HR_SPECTRAL_FFT_SIZE - 1)];
+		_re[i] = (int16_t)(((int32_t)x * _hannTable[w]) >> 15);
+		_im[i] = 0;
+		int16_t a = _re[i] < 0 ? -_re[i] : _re[i];
+		if (a > maxAbs)
+		{
+			maxAbs = a;
+		}
+	}
+
+	// Block scaling, use the full Q15 range before the transform
+	uint8_t shift = 0;
+	while ((maxAbs << shift) < 0x2000)
+	{
+		shift++;
+	}
+	if (shift != 0)
+	{
+		for (uint16_t i = 0; i < HR_SPECTRAL_FFT_SIZE; i++)
+		{
+			_re[i] = _re[i] << shift;
+		}
+	}
+
+	fft();
+
+	// Search the peak in the power spectrum of the heart rate band
+	uint32_t bandPower = 0;
+	uint32_t peakPower = 0;
+	uint16_t peakBin = 0;
+	for (uint16_t k = _binMin; k <= _binMax; k++)
+	{
+		uint32_t p = (uint32_t)((int32_t)_re[k] * _re[k]) + (uint32_t)((int32_t)_im[k] * _im[k]);
+		bandPower += p >> 8;
+		if (p > peakPower)
+		{
+			peakPower = p;
+			peakBin = k;
+		}
+	}
+	if ((peakBin == 0) || (bandPower == 0))
+	{
+		_confidence = 0;
+		return false;
+	}
+
+	// Harmonic check, the 2nd harmonic can be stronger than the fundamental
+	// if the pulse shape has a pronounced dicrotic notch
+	uint16_t subBin = peakBin / 2;
+	if (subBin >= _binMin)
+	{
+		uint32_t subPower = 0;
+		uint16_t subPeak = subBin;
+		for (uint16_t k = subBin - 1; k <= subBin + 1; k++)
+		{
+			uint32_t p = (uint32_t)((int32_t)_re[k] * _re[k]) + (uint32_t)((int32_t)_im[k] * _im[k]);
+			if (p > subPower)
+			{
+				subPower = p;
+				subPeak = k;
+			}
+		}
+		// Sub harmonic magnitude above half of the peak magnitude
+		if (subPower > (peakPower >> 2))
+		{
+			peakBin = subPeak;
+			peakPower = subPower;
+		}
+	}
+
+	// Parabolic interpolation on the magnitudes around the peak
+	float mag[3];
+	uint32_t peakArea = 0;
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		uint16_t k = peakBin - 1 + i;
+		uint32_t p = (uint32_t)((int32_t)_re[k] * _re[k]) + (uint32_t)((int32_t)_im[k] * _im[k]);
+		peakArea += p >> 8;
+		mag[i] = sqrt((float)p);
+	}
+	float denom = mag[0] - 2.0 * mag[1] + mag[2];
+	float delta = 0.0;
+	if (denom != 0.0)
+	{
+		delta = 0.5 * (mag[0] - mag[2]) / denom;
+	}
+	if (delta > 0.5)
+	{
+		delta = 0.5;
+	}
+	if (delta < -0.5)
+	{
+		delta = -0.5;
+	}
+
+	_bpm = (peakBin + delta) * _binHz * 60.0;
+	if (peakArea > bandPower)
+	{
+		peakArea = bandPower;
+	}
+	_confidence = (uint8_t)((peakArea * 100.0) / bandPower);
+	return true;
+}
+
+float HR_SPECTRAL::getBPM(void)
+{
+	return _bpm;
+}
+
+uint8_t HR_SPECTRAL::getConfidence(void)
+{
+	return _confidence;
+}
+
+uint16_t HR_SPECTRAL::getOverruns(void)
+{
+	return _overruns;
+}
+
+/**
+ * Radix-2 decimation in time FFT, in place on _re/_im.
+ * Every stage scales by 1/2 to stay in Q15 range.
+ */
+void HR_SPECTRAL::fft(void)
+{
+	// Bit reversal
+	for (uint16_t i = 1, j = 0; i < HR_SPECTRAL_FFT_SIZE; i++)
+	{
+		uint16_t bit = HR_SPECTRAL_FFT_SIZE >> 1;
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j)
+		{
+			int16_t t = _re[i];
+			_re[i] = _re[j];
+			_re[j] = t;
+			t = _im[i];
+			_im[i] = _im[j];
+			_im[j] = t;
+		}
+	}
+
+	// Butterflies
+	for (uint16_t len = 2, step = HR_SPECTRAL_FFT_SIZE / 2; len <= HR_SPECTRAL_FFT_SIZE; len <<= 1, step >>= 1)
+	{
+		uint16_t half = len >> 1;
+		for (uint16_t k = 0; k < half; k++)
+		{
+			int32_t wr = _sinTable[k * step + HR_SPECTRAL_FFT_SIZE / 4]; // cos
+			int32_t ws = _sinTable[k * step];							  // sin
+			for (uint16_t i = k; i < HR_SPECTRAL_FFT_SIZE; i += len)
+			{
+				uint16_t j = i + half;
+				int32_t tr = (wr * _re[j] + ws * _im[j]) >> 15;
+				int32_t ti = (wr * _im[j] - ws * _re[j]) >> 15;
+				int32_t qr = _re[i];
+				int32_t qi = _im[i];
+				_re[j] = (int16_t)((qr - tr) >> 1);
+				_im[j] = (int16_t)((qi - ti) >> 1);
+				_re[i] = (int16_t)((qr + tr) >> 1);
+				_im[i] = (int16_t)((qi + ti) >> 1);
+			}
+		}
+	}
+}
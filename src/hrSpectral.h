@@ -0,0 +1,139 @@
+/**
+ * @file hrSpectral.h
+ * @brief Spectral heart rate estimation (windowed fixed-point FFT)
+ *
+ * @author   Bernd Giesecke
+ *
+ * Alternative to the PBA beat detector in heartRate.h for targets with
+ * enough RAM (ESP32, nRF52, SAMD51).
+ * - Bio samples are decimated and DC corrected on input
+ * - Every HR_SPECTRAL_HOP samples a Hann windowed frame of
+ *   HR_SPECTRAL_FFT_SIZE samples is transformed (75% overlap)
+ * - The transform is a radix-2 Q15 FFT with precomputed twiddle tables
+ * - The spectral peak is refined with parabolic interpolation and
+ *   checked against its sub harmonic, giving sub-bin BPM resolution
+ */
+#ifndef HR_SPECTRAL_H
+#define HR_SPECTRAL_H
+
+#include "ppgPlatform.h"
+#include "ppgThread.h"
+
+#ifdef PPG_HAS_THREADS
+#include <atomic>
+#endif
+
+/** FFT size as power of 2 */
+#define HR_SPECTRAL_FFT_BITS 8
+/** Number of samples in one FFT frame */
+#define HR_SPECTRAL_FFT_SIZE (1 << HR_SPECTRAL_FFT_BITS)
+/** Number of new samples between two frames (75% overlap) */
+#define HR_SPECTRAL_HOP (HR_SPECTRAL_FFT_SIZE / 4)
+
+/** Flag in the frame word, a frame waits for process(). The lower bits are the frame start in the ring */
+#define HR_SPECTRAL_FRAME_READY 0x8000
+
+/** Lowest heart rate searched in the spectrum */
+#define HR_SPECTRAL_MIN_BPM 40
+/** Highest heart rate searched in the spectrum */
+#define HR_SPECTRAL_MAX_BPM 220
+
+/**
+ * Spectral heart rate estimation
+ *
+ * Acquisition and transform are decoupled. addSample() can be called from
+ * the acquisition side (loop, task or callback) while process() runs the
+ * FFT on the last complete frame. The sample ring holds two frames, so the
+ * acquisition side can keep writing for a full frame length before it
+ * reaches the samples of the frame being transformed.
+ * Frame start and ready flag are one word that is swapped in one step, a
+ * frame replaced before process() took it is always counted as overrun.
+ * Without threads addSample() may run in an interrupt, process() then
+ * blocks interrupts for the swap.
+ */
+class HR_SPECTRAL
+{
+public:
+	/**
+	 * HR_SPECTRAL constructor
+	 * @param sampleRate
+	 * 		Bio sensor sample rate in samples/s (e.g. 125.0 for BIO_SENS_RATE_125)
+	 * @param decimation
+	 * 		Number of input samples averaged into one FFT sample (1 to 16).
+	 * 		At 125 samples/s a decimation of 4 gives a frame length of 8.2s
+	 */
+	HR_SPECTRAL(float sampleRate, uint8_t decimation = 4);
+
+	/**
+	 * Add a bio sensor sample
+	 * @param sample
+	 * 		Raw bio sensor value
+	 * @return result
+	 * 		TRUE if a new frame is ready for process()
+	 */
+	bool addSample(int32_t sample);
+	/**
+	 * Check if a frame is waiting for process()
+	 * @return result
+	 * 		TRUE if a frame is ready
+	 */
+	bool frameReady(void);
+	/**
+	 * Transform the last complete frame and update the heart rate estimate
+	 * @return result
+	 * 		TRUE if a valid heart rate was found in the frame
+	 * 		FALSE if no frame was ready or no peak in the heart rate range was found
+	 */
+	bool process(void);
+	/**
+	 * Get last estimated heart rate
+	 * @return heart rate in beats/minute with sub-bin resolution, 0 if no estimate yet
+	 */
+	float getBPM(void);
+	/**
+	 * Get confidence of the last estimate
+	 * @return share of the heart rate band power in the detected peak, 0 to 100
+	 */
+	uint8_t getConfidence(void);
+	/**
+	 * Get number of frames dropped because process() was not called in time
+	 * @return number of dropped frames
+	 */
+	uint16_t getOverruns(void);
+
+private:
+	void initTables(void);
+	void fft(void);
+
+	float _binHz; ///< Frequency resolution of one FFT bin
+	uint16_t _binMin; ///< First bin of heart rate band
+	uint16_t _binMax; ///< Last bin of heart rate band
+
+	uint8_t _decimation; ///< Input samples per FFT sample
+	uint8_t _decimCount = 0; ///< Samples in decimation accumulator
+	int32_t _decimAcc = 0; ///< Decimation accumulator
+	int32_t _dcReg = 0; ///< DC estimator register (Q8)
+	bool _dcValid = false; ///< Flag if DC estimator is initialized
+
+	int16_t _ring[2 * HR_SPECTRAL_FFT_SIZE]; ///< Sample ring, two frames long
+	uint16_t _writeIdx = 0; ///< Next write position in sample ring
+	uint16_t _filled = 0; ///< Number of samples in ring until first frame is complete
+	uint16_t _hopCount = 0; ///< Samples since last frame
+#ifdef PPG_HAS_THREADS
+	std::atomic<uint16_t> _frame; ///< Start of the last complete frame | HR_SPECTRAL_FRAME_READY
+#else
+	volatile uint16_t _frame = 0; ///< Start of the last complete frame | HR_SPECTRAL_FRAME_READY
+#endif
+	uint16_t _overruns = 0; ///< Frames dropped
+
+	int16_t _re[HR_SPECTRAL_FFT_SIZE]; ///< FFT work buffer, real part
+	int16_t _im[HR_SPECTRAL_FFT_SIZE]; ///< FFT work buffer, imaginary part
+
+	float _bpm = 0.0; ///< Last heart rate estimate
+	uint8_t _confidence = 0; ///< Confidence of last estimate
+
+	static int16_t _sinTable[HR_SPECTRAL_FFT_SIZE * 3 / 4]; ///< Twiddle table, shared by all instances
+	static int16_t _hannTable[HR_SPECTRAL_FFT_SIZE / 2];	///< Half Hann window, shared by all instances
+	static bool _tablesReady; ///< Flag if tables are computed
+};
+#endif
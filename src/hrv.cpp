@@ -0,0 +1,114 @@
+/**
+ * @file hrv.cpp
+ * @brief Heart rate variability from streaming beat to beat intervals
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "hrv.h"
+
+HRV::HRV(void)
+{
+	reset();
+}
+
+void HRV::reset(void)
+{
+	_head = 0;
+	_count = 0;
+	_sumRR = 0;
+	_sumRR2 = 0;
+	_sumDiff2 = 0;
+	_nn50 = 0;
+}
+
+bool HRV::addInterval(uint32_t rrUs)
+{
+	uint32_t rr = (rrUs + 500) / 1000;
+	if ((rr < HRV_MIN_RR) || (rr > HRV_MAX_RR))
+	{
+		return false;
+	}
+
+	if (_count == HRV_WINDOW)
+	{
+		// Remove the oldest interval and its difference to the next one
+		uint32_t oldest = _rr[_head];
+		uint8_t next = (_head + 1) % HRV_WINDOW;
+		int32_t diff = (int32_t)_rr[next] - (int32_t)oldest;
+		_sumRR -= oldest;
+		_sumRR2 -= oldest * oldest;
+		_sumDiff2 -= (uint32_t)(diff * diff);
+		if ((diff > 50) || (diff < -50))
+		{
+			_nn50--;
+		}
+		_head = next;
+		_count--;
+	}
+
+	if (_count != 0)
+	{
+		// Difference to the newest interval
+		uint16_t newest = _rr[(_head + _count - 1) % HRV_WINDOW];
+		int32_t diff = (int32_t)rr - (int32_t)newest;
+		_sumDiff2 += (uint32_t)(diff * diff);
+		if ((diff > 50) || (diff < -50))
+		{
+			_nn50++;
+		}
+	}
+
+	_rr[(_head + _count) % HRV_WINDOW] = (uint16_t)rr;
+	_count++;
+	_sumRR += rr;
+	_sumRR2 += rr * rr;
+	return true;
+}
+
+uint8_t HRV::getCount(void)
+{
+	return _count;
+}
+
+float HRV::getMeanRR(void)
+{
+	if (_count == 0)
+	{
+		return 0.0;
+	}
+	return (float)_sumRR / _count;
+}
+
+float HRV::getRMSSD(void)
+{
+	if (_count < 2)
+	{
+		return 0.0;
+	}
+	return sqrt((float)_sumDiff2 / (_count - 1));
+}
+
+float HRV::getSDNN(void)
+{
+	if (_count < 2)
+	{
+		return 0.0;
+	}
+	float mean = (float)_sumRR / _count;
+	float var = ((float)_sumRR2 - mean * _sumRR) / (_count - 1);
+	if (var < 0.0)
+	{
+		return 0.0;
+	}
+	return sqrt(var);
+}
+
+uint8_t HRV::getPNN50(void)
+{
+	if (_count < 2)
+	{
+		return 0;
+	}
+	return (uint8_t)((_nn50 * 100 + (_count - 1) / 2) / (_count - 1));
+}
@@ -0,0 +1,84 @@
+/**
+ * @file hrv.h
+ * @brief Heart rate variability from streaming beat to beat intervals
+ *
+ * @author   Bernd Giesecke
+ *
+ * Feed the RR intervals from HEART_RATE::getLastRR() into HRV to get the
+ * time domain HRV metrics over a sliding window of the last HRV_WINDOW beats.
+ * - RMSSD root mean square of successive differences
+ * - SDNN standard deviation of the intervals
+ * - pNN50 percentage of successive differences above 50ms
+ *
+ * All running sums are updated in O(1) per beat.
+ */
+#ifndef HRV_H
+#define HRV_H
+
+#include "ppgPlatform.h"
+
+/** Number of intervals in the sliding window */
+#define HRV_WINDOW 32
+/** Shortest accepted interval in ms (240 beats/minute) */
+#define HRV_MIN_RR 250
+/** Longest accepted interval in ms (24 beats/minute) */
+#define HRV_MAX_RR 2500
+
+/**
+ * Heart rate variability accumulator
+ */
+class HRV
+{
+public:
+	HRV(void);
+
+	/**
+	 * Add a beat to beat interval
+	 * @param rrUs
+	 * 		Interval in microseconds, as returned by HEART_RATE::getLastRR()
+	 * @return result
+	 * 		TRUE if the interval was accepted
+	 * 		FALSE if the interval is outside of HRV_MIN_RR to HRV_MAX_RR
+	 */
+	bool addInterval(uint32_t rrUs);
+	/**
+	 * Clear all intervals
+	 */
+	void reset(void);
+	/**
+	 * Get number of intervals in the window
+	 * @return number of intervals
+	 */
+	uint8_t getCount(void);
+	/**
+	 * Get mean interval
+	 * @return mean interval in ms, 0 if no intervals
+	 */
+	float getMeanRR(void);
+	/**
+	 * Get RMSSD
+	 * @return root mean square of successive differences in ms, 0 if less than 2 intervals
+	 */
+	float getRMSSD(void);
+	/**
+	 * Get SDNN
+	 * @return standard deviation of the intervals in ms, 0 if less than 2 intervals
+	 */
+	float getSDNN(void);
+	/**
+	 * Get pNN50
+	 * @return percentage of successive differences above 50ms, 0 if less than 2 intervals
+	 */
+	uint8_t getPNN50(void);
+
+private:
+	uint16_t _rr[HRV_WINDOW]; ///< Interval ring in ms
+	uint8_t _head = 0;		  ///< Position of the oldest interval
+	uint8_t _count = 0;		  ///< Number of intervals in the ring
+
+	uint32_t _sumRR = 0;	///< Sum of intervals
+	uint32_t _sumRR2 = 0;	///< Sum of squared intervals
+	uint32_t _sumDiff2 = 0; ///< Sum of squared successive differences
+	uint8_t _nn50 = 0;		///< Number of successive differences above 50ms
+};
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file ppgConfig.h
+ * @brief Compile time feature selection of the library
+ *
+ * @author   Bernd Giesecke
+ *
+ * Every feature is enabled by default. On boards with little RAM (uno, leonardo,
+ * mega2560) the features that are not needed can be compiled out, either one by one
+ * or all together with the tiny profile:
+ * - PlatformIO: build_flags = -DPPG_TINY
+ * - arduino-cli: --build-property compiler.cpp.extra_flags=-DPPG_TINY
+ * - Arduino IDE: uncomment the #define PPG_TINY below
+ *
+ * A single switch set to 1 re-enables a feature inside the tiny profile, e.g.
+ * -DPPG_TINY -DVCNL4020C_USE_ALS=1.
+ * The functions of a compiled out feature are not declared, using them is a compile error.
+ */
+#ifndef PPG_CONFIG_H
+#define PPG_CONFIG_H
+
+// #define PPG_TINY
+
+#ifdef PPG_TINY
+#ifndef VCNL4020C_USE_INTERRUPTS
+#define VCNL4020C_USE_INTERRUPTS 0
+#endif
+#ifndef VCNL4020C_USE_THRESHOLDS
+#define VCNL4020C_USE_THRESHOLDS 0
+#endif
+#ifndef VCNL4020C_USE_ALS
+#define VCNL4020C_USE_ALS 0
+#endif
+#ifndef HR_USE_PARAMS
+#define HR_USE_PARAMS 0
+#endif
+#ifndef HR_USE_DECIMATION
+#define HR_USE_DECIMATION 0
+#endif
+#ifndef HR_USE_MORPH
+#define HR_USE_MORPH 0
+#endif
+#endif
+
+/** Interrupt GPIO support: interrupt callback, event handlers with driver owned ISRs */
+#ifndef VCNL4020C_USE_INTERRUPTS
+#define VCNL4020C_USE_INTERRUPTS 1
+#endif
+/** Threshold registers and threshold interrupts */
+#ifndef VCNL4020C_USE_THRESHOLDS
+#define VCNL4020C_USE_THRESHOLDS 1
+#endif
+/** Ambient light measurement */
+#ifndef VCNL4020C_USE_ALS
+#define VCNL4020C_USE_ALS 1
+#endif
+/** Change driven ALS events, need the ALS and the threshold registers */
+#if VCNL4020C_USE_ALS && VCNL4020C_USE_THRESHOLDS
+#define VCNL4020C_USE_ALS_EVENTS 1
+#else
+#define VCNL4020C_USE_ALS_EVENTS 0
+#endif
+/** Runtime beat detection parameters (HR_PARAMS), without them HEART_RATE uses the
+ *  compile time defaults and reads the FIR coefficients directly from flash */
+#ifndef HR_USE_PARAMS
+#define HR_USE_PARAMS 1
+#endif
+/** Decimation ahead of the beat detection (HR_DECIMATOR) */
+#ifndef HR_USE_DECIMATION
+#define HR_USE_DECIMATION 1
+#endif
+/** Pulse morphology features (HR_MORPH) */
+#ifndef HR_USE_MORPH
+#define HR_USE_MORPH 1
+#endif
+#if HR_USE_DECIMATION && !HR_USE_PARAMS
+#error "HR_USE_DECIMATION needs HR_USE_PARAMS, the FIR is shortened in RAM for decimation"
+#endif
+#endif
@@ -0,0 +1,250 @@
+/**
+ * @file ppgEngine.cpp
+ * @brief Sharded multi-stream heart rate engine for gateways
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "ppgEngine.h"
+
+#include <string.h>
+
+#ifndef ARDUINO
+
+/** Wait time of an idle worker before it checks if it should stop */
+#define PPG_ENGINE_IDLE_MS 100
+/** Empty polls of the queue before the worker goes to sleep */
+#define PPG_ENGINE_SPIN 256
+
+PPG_ENGINE::PPG_ENGINE(void) : _running(false)
+{
+}
+
+PPG_ENGINE::~PPG_ENGINE()
+{
+	end();
+}
+
+void PPG_ENGINE::setBeatCb(PPG_BEAT_FN beat, void *ctx)
+{
+	_beat = beat;
+	_beatCtx = ctx;
+}
+
+bool PPG_ENGINE::begin(uint32_t streams, uint16_t shards, uint32_t samplePeriodUs)
+{
+	if (_running || (_shards != NULL))
+	{
+		return false;
+	}
+	if ((streams == 0) || (shards == 0) || (shards > PPG_ENGINE_MAX_SHARDS) || (shards > streams))
+	{
+		return false;
+	}
+	_streams = streams;
+	_shardCount = shards;
+	_perShard = (streams + shards - 1) / shards;
+
+	// One block of streams per shard, the worker walks only through its own block
+	_arena = new STREAM[(size_t)_perShard * shards];
+	for (size_t idx = 0; idx < (size_t)_perShard * shards; idx++)
+	{
+		_arena[idx].hr.setSamplePeriod(samplePeriodUs);
+	}
+	_shards = new SHARD[shards];
+
+	_running = true;
+	for (uint16_t idx = 0; idx < shards; idx++)
+	{
+		_shards[idx].engine = this;
+		_shards[idx].streams = &_arena[(size_t)idx * _perShard];
+		_shards[idx].statUs = micros();
+		if (!_shards[idx].thread.start(workerTask, &_shards[idx], "ppgShard"))
+		{
+			end();
+			return false;
+		}
+	}
+	return true;
+}
+
+#if HR_USE_PARAMS
+bool PPG_ENGINE::setParams(const HR_PARAMS &params)
+{
+	if (_arena == NULL)
+	{
+		return false;
+	}
+	for (size_t idx = 0; idx < (size_t)_perShard * _shardCount; idx++)
+	{
+		if (!_arena[idx].hr.setParams(params))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+#endif
+
+void PPG_ENGINE::end(void)
+{
+	if (_shards == NULL)
+	{
+		return;
+	}
+	_running = false;
+	for (uint16_t idx = 0; idx < _shardCount; idx++)
+	{
+		_shards[idx].wake.give();
+	}
+	for (uint16_t idx = 0; idx < _shardCount; idx++)
+	{
+		_shards[idx].thread.join();
+	}
+	delete[] _shards;
+	delete[] _arena;
+	_shards = NULL;
+	_arena = NULL;
+	_streams = 0;
+	_shardCount = 0;
+	_perShard = 0;
+}
+
+bool PPG_ENGINE::push(uint32_t stream, const int32_t *samples, uint16_t count)
+{
+	if ((stream >= _streams) || (count == 0) || (count > PPG_ENGINE_BATCH_SIZE))
+	{
+		return false;
+	}
+	SHARD *shard = &_shards[stream % _shardCount];
+	PPG_ENGINE_BATCH batch;
+	batch.stream = stream;
+	batch.count = count;
+	memcpy(batch.samples, samples, count * sizeof(int32_t));
+	if (!shard->queue.push(batch))
+	{
+		shard->dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	// Pairs with the fence of the worker, either the worker sees the batch or we see it sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (shard->sleeping.load(std::memory_order_relaxed) && shard->sleeping.exchange(false))
+	{
+		shard->wake.give();
+	}
+	return true;
+}
+
+bool PPG_ENGINE::flush(uint32_t timeoutMs)
+{
+	uint32_t start = millis();
+	for (uint16_t idx = 0; idx < _shardCount; idx++)
+	{
+		SHARD *shard = &_shards[idx];
+		while ((uint32_t)shard->batches.load(std::memory_order_acquire) != shard->queue.getPushed())
+		{
+			if ((uint32_t)(millis() - start) >= timeoutMs)
+			{
+				return false;
+			}
+			delay(1);
+		}
+	}
+	return true;
+}
+
+uint16_t PPG_ENGINE::getShards(void)
+{
+	return _shardCount;
+}
+
+uint16_t PPG_ENGINE::getShard(uint32_t stream)
+{
+	return (_shardCount != 0) ? (uint16_t)(stream % _shardCount) : 0;
+}
+
+bool PPG_ENGINE::getShardStats(uint16_t shard, PPG_ENGINE_STATS *stats)
+{
+	if (shard >= _shardCount)
+	{
+		return false;
+	}
+	SHARD *s = &_shards[shard];
+	stats->samples = s->samples.load(std::memory_order_relaxed);
+	stats->batches = s->batches.load(std::memory_order_relaxed);
+	stats->beats = s->beats.load(std::memory_order_relaxed);
+	stats->dropped = s->dropped.load(std::memory_order_relaxed);
+	stats->depth = s->queue.size();
+	stats->maxDepth = s->maxDepth.load(std::memory_order_relaxed);
+
+	uint32_t now = micros();
+	uint32_t elapsed = now - s->statUs;
+	stats->samplesPerSec = (elapsed != 0) ? (uint32_t)((stats->samples - s->statSamples) * 1000000ULL / elapsed) : 0;
+	s->statSamples = stats->samples;
+	s->statUs = now;
+	return true;
+}
+
+void PPG_ENGINE::process(SHARD *shard, const PPG_ENGINE_BATCH &batch)
+{
+	STREAM *stream = &shard->streams[batch.stream / _shardCount];
+	uint32_t beats = 0;
+	for (uint16_t idx = 0; idx < batch.count; idx++)
+	{
+		if (stream->hr.checkForBeat(batch.samples[idx]))
+		{
+			beats++;
+			if (_beat != NULL)
+			{
+				_beat(_beatCtx, batch.stream, stream->samples + idx, stream->hr.getSmoothedHR());
+			}
+		}
+	}
+	stream->samples += batch.count;
+
+	// Only this worker writes the counters, no read-modify-write needed
+	shard->samples.store(shard->samples.load(std::memory_order_relaxed) + batch.count, std::memory_order_relaxed);
+	if (beats != 0)
+	{
+		shard->beats.store(shard->beats.load(std::memory_order_relaxed) + beats, std::memory_order_relaxed);
+	}
+	shard->batches.store(shard->batches.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void PPG_ENGINE::workerTask(void *shard)
+{
+	SHARD *self = (SHARD *)shard;
+	PPG_ENGINE *engine = self->engine;
+	PPG_ENGINE_BATCH batch;
+	uint16_t idle = 0;
+
+	while (engine->_running.load(std::memory_order_relaxed))
+	{
+		uint16_t depth = self->queue.size();
+		if (self->queue.pop(&batch))
+		{
+			if (depth > self->maxDepth.load(std::memory_order_relaxed))
+			{
+				self->maxDepth.store(depth, std::memory_order_relaxed);
+			}
+			engine->process(self, batch);
+			idle = 0;
+			continue;
+		}
+		if (++idle < PPG_ENGINE_SPIN)
+		{
+			continue;
+		}
+
+		// Nothing to do, sleep until a producer pushes
+		self->sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (self->queue.size() == 0)
+		{
+			self->wake.take(PPG_ENGINE_IDLE_MS);
+		}
+		self->sleeping.store(false, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
+#endif
@@ -0,0 +1,206 @@
+/**
+ * @file ppgEngine.h
+ * @brief Sharded multi-stream heart rate engine for gateways
+ *
+ * @author   Bernd Giesecke
+ *
+ * Runs the HEART_RATE detection for thousands of sensor streams on a many-core host.
+ * - The state of all streams is one contiguous array (arena). Stream id % shards
+ *   selects the shard, the streams of one shard are neighbours in the arena.
+ * - Every shard has one worker thread, only this thread touches the streams of the shard.
+ * - Sample batches are pushed from any number of threads into a lock-free
+ *   multi producer queue per shard, the producers never take a lock.
+ * - Throughput and queue depth are counted per shard.
+ *
+ * The samples of one stream must be pushed in order, i.e. by one thread at a time.
+ * Only available without Arduino.
+ */
+#ifndef PPG_ENGINE_H
+#define PPG_ENGINE_H
+
+#include "ppgQueue.h"
+#include "heartRate.h"
+
+#ifndef ARDUINO
+
+/** Maximum number of samples in one batch */
+#define PPG_ENGINE_BATCH_SIZE 32
+/** Number of batches the queue of a shard can hold */
+#define PPG_ENGINE_QUEUE_SIZE 1024
+/** Maximum number of shards */
+#define PPG_ENGINE_MAX_SHARDS 256
+
+/**
+ * Samples of one stream, the unit of the shard queues
+ */
+struct PPG_ENGINE_BATCH
+{
+	uint32_t stream;						///< Stream id
+	uint16_t count;							///< Number of samples
+	int32_t samples[PPG_ENGINE_BATCH_SIZE]; ///< Sensor values, oldest first
+};
+
+/**
+ * Counters of one shard
+ */
+struct PPG_ENGINE_STATS
+{
+	uint64_t samples;		///< Samples processed
+	uint64_t batches;		///< Batches processed
+	uint64_t beats;			///< Beats detected
+	uint64_t dropped;		///< Batches rejected because the queue was full
+	uint32_t samplesPerSec; ///< Throughput since the previous getShardStats() of this shard
+	uint16_t depth;			///< Batches waiting in the queue
+	uint16_t maxDepth;		///< Highest queue depth seen by the worker
+};
+
+/**
+ * Sharded multi-stream heart rate engine
+ */
+class PPG_ENGINE
+{
+public:
+	/**
+	 * Beat callback, called by the worker thread of the shard
+	 * @param ctx
+	 * 		User context
+	 * @param stream
+	 * 		Stream id
+	 * @param sampleIndex
+	 * 		Number of the sample in the stream
+	 * @param bpm
+	 * 		Smoothed heart rate of the stream
+	 */
+	typedef void (*PPG_BEAT_FN)(void *ctx, uint32_t stream, uint32_t sampleIndex, int bpm);
+
+	PPG_ENGINE(void);
+	~PPG_ENGINE();
+
+	/**
+	 * Set the beat callback, call before begin()
+	 * @param beat
+	 * 		Beat callback function, NULL for none
+	 * @param ctx
+	 * 		User context for the beat callback
+	 */
+	void setBeatCb(PPG_BEAT_FN beat, void *ctx);
+	/**
+	 * Allocate the streams and start the shard workers
+	 * @param streams
+	 * 		Number of streams, the stream ids are 0 .. streams - 1
+	 * @param shards
+	 * 		Number of shards/worker threads, 1 .. PPG_ENGINE_MAX_SHARDS
+	 * @param samplePeriodUs
+	 * 		Sample period of all streams in microseconds
+	 * @return result
+	 * 		FALSE if the engine is running, the arguments are invalid or a worker could not be started
+	 */
+	bool begin(uint32_t streams, uint16_t shards, uint32_t samplePeriodUs);
+#if HR_USE_PARAMS
+	/**
+	 * Set the beat detection parameters of all streams, call after begin() and before the first push()
+	 * @param params
+	 * 		Parameters, see HEART_RATE::setParams()
+	 * @return result
+	 * 		FALSE if the engine is not started or the parameters are invalid
+	 */
+	bool setParams(const HR_PARAMS &params);
+#endif
+	/**
+	 * Stop the workers and free the streams, samples still queued are discarded
+	 */
+	void end(void);
+	/**
+	 * Queue samples of one stream, can be called from any thread
+	 * @param stream
+	 * 		Stream id
+	 * @param samples
+	 * 		Sensor values, oldest first
+	 * @param count
+	 * 		Number of samples, 1 .. PPG_ENGINE_BATCH_SIZE
+	 * @return result
+	 * 		FALSE if the stream id or count is invalid or the queue of the shard is full
+	 */
+	bool push(uint32_t stream, const int32_t *samples, uint16_t count);
+	/**
+	 * Wait until all queued samples are processed
+	 * @param timeoutMs
+	 * 		Maximum wait time in milliseconds
+	 * @return result
+	 * 		FALSE on timeout
+	 */
+	bool flush(uint32_t timeoutMs);
+
+	/**
+	 * Get number of shards
+	 * @return number of shards, 0 if the engine is not started
+	 */
+	uint16_t getShards(void);
+	/**
+	 * Get shard of a stream
+	 * @param stream
+	 * 		Stream id
+	 * @return shard index
+	 */
+	uint16_t getShard(uint32_t stream);
+	/**
+	 * Get the counters of a shard
+	 * The throughput is measured between two calls for the same shard,
+	 * call from one monitoring thread only.
+	 * @param shard
+	 * 		Shard index
+	 * @param stats
+	 * 		Pointer to the counters to fill
+	 * @return result
+	 * 		FALSE if the shard does not exist
+	 */
+	bool getShardStats(uint16_t shard, PPG_ENGINE_STATS *stats);
+
+private:
+	/** State of one stream in the arena */
+	struct STREAM
+	{
+		HEART_RATE hr;		  ///< Beat detection
+		uint32_t samples = 0; ///< Samples processed
+	};
+
+	/** Queue, worker and counters of one shard */
+	struct SHARD
+	{
+		PPG_MPSC_QUEUE<PPG_ENGINE_BATCH, PPG_ENGINE_QUEUE_SIZE> queue; ///< Batches of the streams of this shard
+		std::atomic<bool> sleeping;									   ///< Flag if the worker waits for wake, read by the producers
+		uint8_t sleepingPad[PPG_CACHE_LINE - sizeof(std::atomic<bool>)]; ///< Keeps the worker counters off the producer cache line
+		PPG_THREAD thread;			///< Worker
+		PPG_SIGNAL wake;			///< Wakes up the idle worker
+		PPG_ENGINE *engine = NULL;	///< Owner
+		STREAM *streams = NULL;		///< First stream of the shard in the arena
+
+		std::atomic<uint64_t> samples;	///< Samples processed
+		std::atomic<uint64_t> batches;	///< Batches processed, compared with the pushed batches of the queue
+		std::atomic<uint64_t> beats;	///< Beats detected
+		std::atomic<uint64_t> dropped;	///< Batches rejected
+		std::atomic<uint16_t> maxDepth; ///< Highest queue depth
+		uint64_t statSamples = 0;		///< Samples at the previous getShardStats()
+		uint32_t statUs = 0;			///< Time of the previous getShardStats()
+
+		SHARD(void) : sleeping(false), samples(0), batches(0), beats(0), dropped(0), maxDepth(0)
+		{
+		}
+	};
+
+	static void workerTask(void *shard);
+	void process(SHARD *shard, const PPG_ENGINE_BATCH &batch);
+
+	PPG_BEAT_FN _beat = NULL; ///< Beat callback
+	void *_beatCtx = NULL;	  ///< User context of the beat callback
+
+	STREAM *_arena = NULL;	  ///< State of all streams, grouped by shard
+	SHARD *_shards = NULL;	  ///< Shards
+	uint32_t _streams = 0;	  ///< Number of streams
+	uint16_t _shardCount = 0; ///< Number of shards
+	uint32_t _perShard = 0;	  ///< Streams per shard in the arena
+
+	std::atomic<bool> _running; ///< Flag if the workers should run
+};
+#endif
+#endif
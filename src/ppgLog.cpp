@@ -0,0 +1,492 @@
+/**
+ * @file ppgLog.cpp
+ * @brief Crash safe append only log of sensor sessions in flash memory
+ *
+ * @author   Bernd Giesecke
+ *
+ * Page layout (little endian)
+ * |_______|_________________________________
+ * | 0..1  | PPG_LOG_MAGIC
+ * | 2..3  | Length of the records
+ * | 4..7  | Sequence number, +1 for every page written
+ * | 8..11 | Timestamp of the first record in ms
+ * | 12..15| CRC32 over bytes 0..11 and the records
+ * | 16..  | Records: type, length, time offset to the page timestamp in ms (2 bytes), data
+ */
+
+#include "ppgLog.h"
+
+/** CRC32 (0xEDB88320) nibble table */
+static const uint32_t crcTable[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+PPG_LOG::PPG_LOG(PPG_LOG_STORAGE *storage)
+{
+	_storage = storage;
+}
+
+bool PPG_LOG::begin(void)
+{
+	uint32_t sectorSize = _storage->getSectorSize();
+	uint32_t size = _storage->getSize();
+	if ((sectorSize < PPG_LOG_PAGE_SIZE) || ((sectorSize % PPG_LOG_PAGE_SIZE) != 0) || ((size % sectorSize) != 0) || (size < (2 * sectorSize)))
+	{
+		return false;
+	}
+	_numPages = size / PPG_LOG_PAGE_SIZE;
+	_sectorPages = sectorSize / PPG_LOG_PAGE_SIZE;
+	_used = 0;
+	_written = 0;
+	_badPages = 0;
+	rewind();
+
+	// Find the newest page. Pages 0..newest have consecutive sequence numbers,
+	// the pages after it are erased or older, so a binary search finds it.
+	// Pages torn by a power loss have no header, the next page with a header decides.
+	PAGE_HEADER header;
+	bool found = false;
+	uint32_t last = 0;
+	uint32_t lastSequence = 0;
+	uint32_t anchor = 0;
+	if (findHeader(0, _sectorPages, &header, &anchor))
+	{
+		uint32_t firstSequence = header.sequence;
+		uint32_t low = anchor;
+		uint32_t high = _numPages;
+		while ((high - low) > 1)
+		{
+			uint32_t mid = (low + high) / 2;
+			uint32_t page = mid;
+			if (findHeader(mid, high, &header, &page) && (header.sequence == (firstSequence + page - anchor)))
+			{
+				low = page;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+		found = true;
+		last = low;
+		lastSequence = firstSequence + low - anchor;
+	}
+	else
+	{
+		// Sector 0 was erased for the next page, the end of the ring is the newest
+		last = _numPages - 1;
+		found = readHeader(last, &header);
+		while (!found && (last > (_numPages - _sectorPages)) && !pageErased(last))
+		{
+			last--;
+			found = readHeader(last, &header);
+		}
+		lastSequence = header.sequence;
+	}
+
+	if (!found)
+	{
+		_head = 0;
+		_tail = 0;
+		_count = 0;
+		_sequence = 1;
+		return true;
+	}
+
+	_sequence = lastSequence + 1;
+	_head = (last + 1) % _numPages;
+	_count = _head;
+	_tail = 0;
+
+	// A power loss during a page write leaves data without header, skip such pages.
+	// Skipped pages use a sequence number to keep sequence and page position aligned.
+	// Pages at a sector start are erased before they are written.
+	while (((_head % _sectorPages) != 0) && !pageErased(_head))
+	{
+		_head = (_head + 1) % _numPages;
+		_count++;
+		_sequence++;
+	}
+
+	// Check if the log wrapped around, then the oldest pages follow the sector of the head
+	uint32_t next = (((_head / _sectorPages) + 1) * _sectorPages) % _numPages;
+	uint32_t page;
+	if (((_head % _sectorPages) == 0) && findHeader(_head, _head + _sectorPages, &header, &page) && (header.sequence < _sequence))
+	{
+		_tail = _head;
+		_count = _numPages;
+	}
+	else if (findHeader(next, next + _sectorPages, &header, &page) && (header.sequence < _sequence) && (next != 0))
+	{
+		_tail = next;
+		_count = (_head + _numPages - next) % _numPages;
+	}
+	return true;
+}
+
+bool PPG_LOG::format(void)
+{
+	if ((_numPages == 0) && !begin())
+	{
+		return false;
+	}
+	uint32_t sectorSize = _storage->getSectorSize();
+	for (uint32_t addr = 0; addr < _storage->getSize(); addr += sectorSize)
+	{
+		if (!_storage->erase(addr))
+		{
+			return false;
+		}
+	}
+	_head = 0;
+	_tail = 0;
+	_count = 0;
+	_sequence = 1;
+	_used = 0;
+	rewind();
+	return true;
+}
+
+bool PPG_LOG::append(uint8_t type, uint32_t timestamp, const uint8_t *data, uint8_t len)
+{
+	if ((len > PPG_LOG_MAX_DATA) || (_numPages == 0))
+	{
+		return false;
+	}
+	uint16_t recordLen = PPG_LOG_RECORD_HEADER + len;
+	if ((_used != 0) && (((_used + recordLen) > PPG_LOG_PAYLOAD_SIZE) || ((uint32_t)(timestamp - _firstTime) > 0xFFFF)))
+	{
+		if (!writePage())
+		{
+			return false;
+		}
+	}
+	if (_used == 0)
+	{
+		_firstTime = timestamp;
+	}
+	uint8_t *record = &_page[PPG_LOG_HEADER_SIZE + _used];
+	record[0] = type;
+	record[1] = len;
+	put16(&record[2], (uint16_t)(timestamp - _firstTime));
+	if (len != 0)
+	{
+		memcpy(&record[PPG_LOG_RECORD_HEADER], data, len);
+	}
+	_used += recordLen;
+	return true;
+}
+
+bool PPG_LOG::logBio(uint32_t timestamp, uint16_t value)
+{
+	uint8_t data[2];
+	put16(data, value);
+	return append(PPG_LOG_BIO, timestamp, data, 2);
+}
+
+bool PPG_LOG::logAls(uint32_t timestamp, uint16_t value)
+{
+	uint8_t data[2];
+	put16(data, value);
+	return append(PPG_LOG_ALS, timestamp, data, 2);
+}
+
+bool PPG_LOG::logBeat(uint32_t timestamp, uint32_t rrUs, uint16_t bpm)
+{
+	uint8_t data[6];
+	put32(data, rrUs);
+	put16(&data[4], bpm);
+	return append(PPG_LOG_BEAT, timestamp, data, 6);
+}
+
+bool PPG_LOG::logConfig(uint32_t timestamp, const uint8_t *regs, uint8_t len)
+{
+	return append(PPG_LOG_CONFIG, timestamp, regs, len);
+}
+
+bool PPG_LOG::flush(void)
+{
+	return writePage();
+}
+
+void PPG_LOG::rewind(void)
+{
+	_readIdx = 0;
+	_readOffset = 0;
+	_readValid = false;
+	_readMinTime = 0;
+}
+
+void PPG_LOG::seek(uint32_t timestamp)
+{
+	rewind();
+	_readMinTime = timestamp;
+
+	// Last page with a first record before or at timestamp
+	PAGE_HEADER header;
+	uint32_t low = 0;
+	uint32_t high = _count;
+	while ((high - low) > 1)
+	{
+		uint32_t mid = (low + high) / 2;
+		uint32_t idx = mid;
+		while ((idx < high) && !readHeader((_tail + idx) % _numPages, &header))
+		{
+			idx++;
+		}
+		if ((idx < high) && (header.timestamp <= timestamp))
+		{
+			low = idx;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	_readIdx = low;
+}
+
+bool PPG_LOG::next(PPG_LOG_RECORD *record)
+{
+	while (_readIdx < _count)
+	{
+		uint32_t page = (_tail + _readIdx) % _numPages;
+		if (!_readValid)
+		{
+			if (!readHeader(page, &_readHeader))
+			{
+				// Erased or interrupted page
+				_readIdx++;
+				continue;
+			}
+			if (!checkPage(page, _readHeader))
+			{
+				_badPages++;
+				_readIdx++;
+				continue;
+			}
+			_readValid = true;
+			_readOffset = 0;
+		}
+		uint8_t recordHeader[PPG_LOG_RECORD_HEADER];
+		uint32_t addr = pageAddr(page) + PPG_LOG_HEADER_SIZE + _readOffset;
+		if (((_readOffset + PPG_LOG_RECORD_HEADER) > _readHeader.used) || !_storage->read(addr, recordHeader, PPG_LOG_RECORD_HEADER) || (recordHeader[1] > PPG_LOG_MAX_DATA) || ((_readOffset + PPG_LOG_RECORD_HEADER + recordHeader[1]) > _readHeader.used))
+		{
+			// End of the page
+			_readIdx++;
+			_readValid = false;
+			continue;
+		}
+		record->type = recordHeader[0];
+		record->len = recordHeader[1];
+		record->timestamp = _readHeader.timestamp + get16(&recordHeader[2]);
+		if ((record->len != 0) && !_storage->read(addr + PPG_LOG_RECORD_HEADER, record->data, record->len))
+		{
+			return false;
+		}
+		_readOffset += PPG_LOG_RECORD_HEADER + record->len;
+		if (record->timestamp < _readMinTime)
+		{
+			continue;
+		}
+		_readMinTime = 0;
+		return true;
+	}
+	return false;
+}
+
+uint32_t PPG_LOG::getPages(void)
+{
+	return _count;
+}
+
+uint32_t PPG_LOG::getPagesWritten(void)
+{
+	return _written;
+}
+
+uint32_t PPG_LOG::getBadPages(void)
+{
+	return _badPages;
+}
+
+bool PPG_LOG::readHeader(uint32_t page, PAGE_HEADER *header)
+{
+	uint8_t raw[PPG_LOG_HEADER_SIZE];
+	if (!_storage->read(pageAddr(page), raw, PPG_LOG_HEADER_SIZE))
+	{
+		return false;
+	}
+	if (get16(raw) != PPG_LOG_MAGIC)
+	{
+		return false;
+	}
+	header->used = get16(&raw[2]);
+	header->sequence = get32(&raw[4]);
+	header->timestamp = get32(&raw[8]);
+	header->crc = get32(&raw[12]);
+	return header->used <= PPG_LOG_PAYLOAD_SIZE;
+}
+
+bool PPG_LOG::findHeader(uint32_t page, uint32_t end, PAGE_HEADER *header, uint32_t *found)
+{
+	// A torn page has data but no header, an erased page ends the written pages
+	while (page < end)
+	{
+		if (readHeader(page, header))
+		{
+			*found = page;
+			return true;
+		}
+		if (pageErased(page))
+		{
+			return false;
+		}
+		page++;
+	}
+	return false;
+}
+
+bool PPG_LOG::checkPage(uint32_t page, const PAGE_HEADER &header)
+{
+	uint8_t chunk[32];
+	uint32_t addr = pageAddr(page);
+	if (!_storage->read(addr, chunk, PPG_LOG_HEADER_SIZE - 4))
+	{
+		return false;
+	}
+	uint32_t crc = crc32(0xFFFFFFFF, chunk, PPG_LOG_HEADER_SIZE - 4);
+	addr += PPG_LOG_HEADER_SIZE;
+	uint16_t remaining = header.used;
+	while (remaining != 0)
+	{
+		uint16_t len = (remaining > sizeof(chunk)) ? sizeof(chunk) : remaining;
+		if (!_storage->read(addr, chunk, len))
+		{
+			return false;
+		}
+		crc = crc32(crc, chunk, len);
+		addr += len;
+		remaining -= len;
+	}
+	return (crc ^ 0xFFFFFFFF) == header.crc;
+}
+
+bool PPG_LOG::pageErased(uint32_t page)
+{
+	uint8_t chunk[32];
+	uint32_t addr = pageAddr(page);
+	for (uint16_t offset = 0; offset < PPG_LOG_PAGE_SIZE; offset += sizeof(chunk))
+	{
+		if (!_storage->read(addr + offset, chunk, sizeof(chunk)))
+		{
+			return false;
+		}
+		for (uint8_t idx = 0; idx < sizeof(chunk); idx++)
+		{
+			if (chunk[idx] != 0xFF)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool PPG_LOG::writePage(void)
+{
+	if (_used == 0)
+	{
+		return true;
+	}
+	if ((_head % _sectorPages) == 0)
+	{
+		if ((_count + _sectorPages) > _numPages)
+		{
+			// The sector holds the oldest pages of the log
+			_tail = (_tail + _sectorPages) % _numPages;
+			_count -= _sectorPages;
+			if (_readIdx >= _sectorPages)
+			{
+				_readIdx -= _sectorPages;
+			}
+			else
+			{
+				_readIdx = 0;
+				_readOffset = 0;
+				_readValid = false;
+			}
+		}
+		if (!_storage->erase(pageAddr(_head)))
+		{
+			return false;
+		}
+	}
+
+	put16(_page, PPG_LOG_MAGIC);
+	put16(&_page[2], _used);
+	put32(&_page[4], _sequence);
+	put32(&_page[8], _firstTime);
+	uint32_t crc = crc32(0xFFFFFFFF, _page, PPG_LOG_HEADER_SIZE - 4);
+	crc = crc32(crc, &_page[PPG_LOG_HEADER_SIZE], _used);
+	put32(&_page[12], crc ^ 0xFFFFFFFF);
+
+	// Records first, header last and its magic at the very end.
+	// Without the complete magic the page is ignored, a torn header never looks valid.
+	uint32_t addr = pageAddr(_head);
+	bool result = _storage->program(addr + PPG_LOG_HEADER_SIZE, &_page[PPG_LOG_HEADER_SIZE], _used);
+	if (result)
+	{
+		result = _storage->program(addr + 2, &_page[2], PPG_LOG_HEADER_SIZE - 2);
+	}
+	if (result)
+	{
+		result = _storage->program(addr, _page, 2);
+	}
+
+	// The page is used even if programming failed
+	_head = (_head + 1) % _numPages;
+	_count++;
+	_sequence++;
+	_written++;
+	_used = 0;
+	return result;
+}
+
+uint32_t PPG_LOG::pageAddr(uint32_t page)
+{
+	return page * PPG_LOG_PAGE_SIZE;
+}
+
+uint32_t PPG_LOG::crc32(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+	for (uint32_t idx = 0; idx < len; idx++)
+	{
+		crc ^= data[idx];
+		crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+		crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+	}
+	return crc;
+}
+
+void PPG_LOG::put16(uint8_t *dst, uint16_t value)
+{
+	dst[0] = (uint8_t)value;
+	dst[1] = (uint8_t)(value >> 8);
+}
+
+void PPG_LOG::put32(uint8_t *dst, uint32_t value)
+{
+	put16(dst, (uint16_t)value);
+	put16(&dst[2], (uint16_t)(value >> 16));
+}
+
+uint16_t PPG_LOG::get16(const uint8_t *src)
+{
+	return (uint16_t)(src[0] | ((uint16_t)src[1] << 8));
+}
+
+uint32_t PPG_LOG::get32(const uint8_t *src)
+{
+	return get16(src) | ((uint32_t)get16(&src[2]) << 16);
+}
@@ -0,0 +1,231 @@
+/**
+ * @file ppgLog.h
+ * @brief Crash safe append only log of sensor sessions in flash memory
+ *
+ * @author   Bernd Giesecke
+ *
+ * Bio and ambient light samples, beat events and configuration changes are
+ * collected in a RAM page and written to flash one page at a time.
+ * - Every page has a header with sequence number, timestamp of the first
+ *   record and a CRC32 over header and records
+ * - The page data is programmed before the header and the header magic last,
+ *   a power loss during a write leaves a page without valid header that is skipped
+ * - The flash is used as a ring, sectors are erased just before they are
+ *   written again, so all sectors wear evenly
+ * - begin() finds the newest page with a binary search over the page
+ *   headers and checks only the pages at the end of the log
+ * - seek() finds a timestamp with a binary search over the page headers
+ * The flash is accessed through PPG_LOG_STORAGE. On Linux ppgLogHost.h
+ * provides a file backed NOR flash simulator and a mmap based read only storage.
+ */
+#ifndef PPG_LOG_H
+#define PPG_LOG_H
+
+#include "ppgPlatform.h"
+
+/** Size of one log page in bytes, must divide the sector size */
+#define PPG_LOG_PAGE_SIZE 256
+/** Size of the page header */
+#define PPG_LOG_HEADER_SIZE 16
+/** Size of the record area of a page */
+#define PPG_LOG_PAYLOAD_SIZE (PPG_LOG_PAGE_SIZE - PPG_LOG_HEADER_SIZE)
+/** Size of the record header (type, length, time offset) */
+#define PPG_LOG_RECORD_HEADER 4
+/** Maximum data length of one record */
+#define PPG_LOG_MAX_DATA 32
+/** Marker of a written page */
+#define PPG_LOG_MAGIC 0x4750
+
+/** Record with a bio sensor value (uint16_t) */
+#define PPG_LOG_BIO 1
+/** Record with an ambient light value (uint16_t) */
+#define PPG_LOG_ALS 2
+/** Record with a beat, RR interval in us (uint32_t) and heart rate in BPM (uint16_t) */
+#define PPG_LOG_BEAT 3
+/** Record with a sensor configuration (register values) */
+#define PPG_LOG_CONFIG 4
+/** Record that marks the start of a session */
+#define PPG_LOG_SESSION 5
+
+/**
+ * Flash memory access
+ * Erased bytes read as 0xFF, program can only clear bits (NOR flash)
+ */
+class PPG_LOG_STORAGE
+{
+public:
+	virtual ~PPG_LOG_STORAGE() {}
+	/**
+	 * Get size of the storage
+	 * @return size in bytes, a multiple of the sector size
+	 */
+	virtual uint32_t getSize(void) = 0;
+	/**
+	 * Get size of the erase unit
+	 * @return sector size in bytes, a multiple of PPG_LOG_PAGE_SIZE
+	 */
+	virtual uint32_t getSectorSize(void) = 0;
+	/**
+	 * Read from the storage
+	 * @return result of request
+	 */
+	virtual bool read(uint32_t addr, uint8_t *data, uint32_t len) = 0;
+	/**
+	 * Program erased bytes
+	 * @return result of request
+	 */
+	virtual bool program(uint32_t addr, const uint8_t *data, uint32_t len) = 0;
+	/**
+	 * Erase the sector that starts at addr
+	 * @return result of request
+	 */
+	virtual bool erase(uint32_t addr) = 0;
+};
+
+/**
+ * One log record
+ */
+struct PPG_LOG_RECORD
+{
+	uint32_t timestamp;				///< Time of the record in ms
+	uint8_t type;					///< Record type, PPG_LOG_BIO, PPG_LOG_ALS, ...
+	uint8_t len;					///< Length of data
+	uint8_t data[PPG_LOG_MAX_DATA]; ///< Record data, little endian
+};
+
+/**
+ * Append only flash log
+ */
+class PPG_LOG
+{
+public:
+	/**
+	 * PPG_LOG constructor
+	 * @param storage
+	 * 		Pointer to the flash access
+	 */
+	PPG_LOG(PPG_LOG_STORAGE *storage);
+
+	/**
+	 * Recover the log state from the flash
+	 * @return result
+	 * 		FALSE if the storage geometry is not usable or the flash can not be read
+	 */
+	bool begin(void);
+	/**
+	 * Erase the complete storage and start an empty log
+	 * @return result of request
+	 */
+	bool format(void);
+
+	/**
+	 * Add a record, written to flash when the page is full or on flush()
+	 * @param type
+	 * 		Record type
+	 * @param timestamp
+	 * 		Time of the record in ms, must not decrease
+	 * @param data
+	 * 		Record data
+	 * @param len
+	 * 		Length of data, up to PPG_LOG_MAX_DATA
+	 * @return result
+	 * 		FALSE if the record is too long or a page write failed
+	 */
+	bool append(uint8_t type, uint32_t timestamp, const uint8_t *data, uint8_t len);
+	/** Add a bio sensor value */
+	bool logBio(uint32_t timestamp, uint16_t value);
+	/** Add an ambient light value */
+	bool logAls(uint32_t timestamp, uint16_t value);
+	/** Add a beat with RR interval in us and heart rate in BPM */
+	bool logBeat(uint32_t timestamp, uint32_t rrUs, uint16_t bpm);
+	/** Add a sensor configuration, e.g. the register block of VCNL4020C::saveConfig() */
+	bool logConfig(uint32_t timestamp, const uint8_t *regs, uint8_t len);
+	/**
+	 * Write the current page to flash even if it is not full
+	 * Call at the end of a session or before sleep
+	 * @return result of request
+	 */
+	bool flush(void);
+
+	/**
+	 * Start reading at the oldest record
+	 */
+	void rewind(void);
+	/**
+	 * Start reading at the first record with a timestamp equal or after timestamp
+	 * @param timestamp
+	 * 		Time in ms
+	 */
+	void seek(uint32_t timestamp);
+	/**
+	 * Read the next record
+	 * Only records in flash are read, records in the unwritten page are not visible
+	 * @param record
+	 * 		Pointer to the record to fill
+	 * @return result
+	 * 		FALSE at the end of the log
+	 */
+	bool next(PPG_LOG_RECORD *record);
+
+	/**
+	 * Get number of pages in flash that belong to the log
+	 * @return number of pages
+	 */
+	uint32_t getPages(void);
+	/**
+	 * Get number of pages written since begin()
+	 * @return number of pages
+	 */
+	uint32_t getPagesWritten(void);
+	/**
+	 * Get number of pages skipped during reading because of a bad CRC
+	 * @return number of pages
+	 */
+	uint32_t getBadPages(void);
+
+private:
+	/**
+	 * Decoded page header
+	 */
+	struct PAGE_HEADER
+	{
+		uint16_t used;		///< Length of the records in the page
+		uint32_t sequence;	///< Page sequence number
+		uint32_t timestamp; ///< Time of the first record
+		uint32_t crc;		///< CRC32 over header and records
+	};
+
+	bool readHeader(uint32_t page, PAGE_HEADER *header);
+	bool findHeader(uint32_t page, uint32_t end, PAGE_HEADER *header, uint32_t *found);
+	bool checkPage(uint32_t page, const PAGE_HEADER &header);
+	bool pageErased(uint32_t page);
+	bool writePage(void);
+	uint32_t pageAddr(uint32_t page);
+	static uint32_t crc32(uint32_t crc, const uint8_t *data, uint32_t len);
+	static void put16(uint8_t *dst, uint16_t value);
+	static void put32(uint8_t *dst, uint32_t value);
+	static uint16_t get16(const uint8_t *src);
+	static uint32_t get32(const uint8_t *src);
+
+	PPG_LOG_STORAGE *_storage; ///< Flash access
+	uint32_t _numPages = 0;	   ///< Number of pages in the storage
+	uint32_t _sectorPages = 0; ///< Number of pages in one sector
+
+	uint32_t _head = 0;		  ///< Next page to write
+	uint32_t _tail = 0;		  ///< Oldest page of the log
+	uint32_t _count = 0;	  ///< Number of pages between tail and head
+	uint32_t _sequence = 1;	  ///< Sequence number of the next page
+	uint32_t _written = 0;	  ///< Pages written since begin()
+	uint32_t _badPages = 0;	  ///< Pages with bad CRC found during reading
+
+	uint8_t _page[PPG_LOG_PAGE_SIZE]; ///< Page that is filled
+	uint16_t _used = 0;				  ///< Length of the records in _page
+	uint32_t _firstTime = 0;		  ///< Time of the first record in _page
+
+	uint32_t _readIdx = 0;		 ///< Read position, page index counted from tail
+	uint16_t _readOffset = 0;	 ///< Read position in the page
+	bool _readValid = false;	 ///< Flag if the header of the read page is checked
+	PAGE_HEADER _readHeader;	 ///< Header of the read page
+	uint32_t _readMinTime = 0;	 ///< Records before this time are skipped after seek()
+};
+#endif
@@ -0,0 +1,230 @@
+/**
+ * @file ppgLogHost.cpp
+ * @brief Linux storage backends for PPG_LOG
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "ppgLogHost.h"
+
+#ifndef ARDUINO
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PPG_LOG_FILE_FLASH::PPG_LOG_FILE_FLASH(const char *path, uint32_t size, uint32_t sectorSize)
+{
+	_size = size;
+	_sectorSize = sectorSize;
+	_eraseCount = (uint32_t *)calloc(size / sectorSize, sizeof(uint32_t));
+	_fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (_fd < 0)
+	{
+		return;
+	}
+	struct stat info;
+	if ((fstat(_fd, &info) == 0) && ((uint32_t)info.st_size < size))
+	{
+		// New or short image, fill up with erased bytes
+		uint8_t erased[256];
+		memset(erased, 0xFF, sizeof(erased));
+		for (uint32_t addr = (uint32_t)info.st_size; addr < size; addr += sizeof(erased))
+		{
+			uint32_t len = ((size - addr) > sizeof(erased)) ? sizeof(erased) : (size - addr);
+			if (pwrite(_fd, erased, len, addr) != (ssize_t)len)
+			{
+				close(_fd);
+				_fd = -1;
+				return;
+			}
+		}
+	}
+}
+
+PPG_LOG_FILE_FLASH::~PPG_LOG_FILE_FLASH()
+{
+	if (_fd >= 0)
+	{
+		close(_fd);
+	}
+	free(_eraseCount);
+}
+
+bool PPG_LOG_FILE_FLASH::isOpen(void)
+{
+	return _fd >= 0;
+}
+
+void PPG_LOG_FILE_FLASH::setPowerFail(int32_t bytes)
+{
+	_powerFail = bytes;
+}
+
+uint32_t PPG_LOG_FILE_FLASH::getMaxErase(void)
+{
+	uint32_t result = 0;
+	for (uint32_t idx = 0; idx < (_size / _sectorSize); idx++)
+	{
+		if (_eraseCount[idx] > result)
+		{
+			result = _eraseCount[idx];
+		}
+	}
+	return result;
+}
+
+uint32_t PPG_LOG_FILE_FLASH::getMinErase(void)
+{
+	uint32_t result = 0xFFFFFFFF;
+	for (uint32_t idx = 0; idx < (_size / _sectorSize); idx++)
+	{
+		if (_eraseCount[idx] < result)
+		{
+			result = _eraseCount[idx];
+		}
+	}
+	return result;
+}
+
+uint32_t PPG_LOG_FILE_FLASH::getSize(void)
+{
+	return _size;
+}
+
+uint32_t PPG_LOG_FILE_FLASH::getSectorSize(void)
+{
+	return _sectorSize;
+}
+
+bool PPG_LOG_FILE_FLASH::read(uint32_t addr, uint8_t *data, uint32_t len)
+{
+	if ((_fd < 0) || ((addr + len) > _size))
+	{
+		return false;
+	}
+	return pread(_fd, data, len, addr) == (ssize_t)len;
+}
+
+bool PPG_LOG_FILE_FLASH::program(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+	if ((_fd < 0) || ((addr + len) > _size) || (_powerFail == 0))
+	{
+		return false;
+	}
+	bool complete = true;
+	if ((_powerFail > 0) && ((uint32_t)_powerFail < len))
+	{
+		// Power loss in the middle of the write
+		len = _powerFail;
+		complete = false;
+	}
+	uint8_t current[256];
+	for (uint32_t offset = 0; offset < len; offset += sizeof(current))
+	{
+		uint32_t chunk = ((len - offset) > sizeof(current)) ? sizeof(current) : (len - offset);
+		if (pread(_fd, current, chunk, addr + offset) != (ssize_t)chunk)
+		{
+			return false;
+		}
+		// NOR flash can only clear bits
+		for (uint32_t idx = 0; idx < chunk; idx++)
+		{
+			current[idx] &= data[offset + idx];
+		}
+		if (pwrite(_fd, current, chunk, addr + offset) != (ssize_t)chunk)
+		{
+			return false;
+		}
+	}
+	if (_powerFail > 0)
+	{
+		_powerFail -= len;
+	}
+	return complete;
+}
+
+bool PPG_LOG_FILE_FLASH::erase(uint32_t addr)
+{
+	if ((_fd < 0) || ((addr % _sectorSize) != 0) || (addr >= _size) || (_powerFail == 0))
+	{
+		return false;
+	}
+	uint8_t erased[256];
+	memset(erased, 0xFF, sizeof(erased));
+	for (uint32_t offset = 0; offset < _sectorSize; offset += sizeof(erased))
+	{
+		if (pwrite(_fd, erased, sizeof(erased), addr + offset) != (ssize_t)sizeof(erased))
+		{
+			return false;
+		}
+	}
+	_eraseCount[addr / _sectorSize]++;
+	return true;
+}
+
+PPG_LOG_MMAP_STORAGE::PPG_LOG_MMAP_STORAGE(const char *path, uint32_t sectorSize)
+{
+	_sectorSize = sectorSize;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+	struct stat info;
+	if ((fstat(fd, &info) == 0) && (info.st_size > 0))
+	{
+		void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			_map = (const uint8_t *)map;
+			_mapSize = info.st_size;
+			_size = (uint32_t)info.st_size - ((uint32_t)info.st_size % sectorSize);
+		}
+	}
+	close(fd);
+}
+
+PPG_LOG_MMAP_STORAGE::~PPG_LOG_MMAP_STORAGE()
+{
+	if (_map != NULL)
+	{
+		munmap((void *)_map, _mapSize);
+	}
+}
+
+bool PPG_LOG_MMAP_STORAGE::isOpen(void)
+{
+	return _map != NULL;
+}
+
+uint32_t PPG_LOG_MMAP_STORAGE::getSize(void)
+{
+	return _size;
+}
+
+uint32_t PPG_LOG_MMAP_STORAGE::getSectorSize(void)
+{
+	return _sectorSize;
+}
+
+bool PPG_LOG_MMAP_STORAGE::read(uint32_t addr, uint8_t *data, uint32_t len)
+{
+	if ((_map == NULL) || ((addr + len) > _size))
+	{
+		return false;
+	}
+	memcpy(data, &_map[addr], len);
+	return true;
+}
+
+bool PPG_LOG_MMAP_STORAGE::program(uint32_t, const uint8_t *, uint32_t)
+{
+	return false;
+}
+
+bool PPG_LOG_MMAP_STORAGE::erase(uint32_t)
+{
+	return false;
+}
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file ppgLogHost.h
+ * @brief Linux storage backends for PPG_LOG
+ *
+ * @author   Bernd Giesecke
+ *
+ * Only available without Arduino.
+ * - PPG_LOG_FILE_FLASH simulates a NOR flash in a file. Program can only
+ *   clear bits, erase sets a sector to 0xFF. A power loss can be injected
+ *   after a number of programmed bytes to test the recovery.
+ * - PPG_LOG_MMAP_STORAGE maps a flash image read only, e.g. a dump of the
+ *   device flash, for fast reading and seeking on the host.
+ */
+#ifndef PPG_LOG_HOST_H
+#define PPG_LOG_HOST_H
+
+#include "ppgLog.h"
+
+#ifndef ARDUINO
+
+/**
+ * File backed NOR flash simulator
+ */
+class PPG_LOG_FILE_FLASH : public PPG_LOG_STORAGE
+{
+public:
+	/**
+	 * PPG_LOG_FILE_FLASH constructor
+	 * @param path
+	 * 		Image file, created erased if it does not exist
+	 * @param size
+	 * 		Size of the simulated flash in bytes
+	 * @param sectorSize
+	 * 		Size of the erase unit in bytes
+	 */
+	PPG_LOG_FILE_FLASH(const char *path, uint32_t size, uint32_t sectorSize = 4096);
+	~PPG_LOG_FILE_FLASH();
+
+	/**
+	 * Check if the image file is open
+	 * @return result
+	 */
+	bool isOpen(void);
+	/**
+	 * Simulate a power loss
+	 * After bytes more programmed bytes all program and erase requests fail
+	 * @param bytes
+	 * 		Number of bytes that are still programmed, -1 to disable
+	 */
+	void setPowerFail(int32_t bytes);
+	/**
+	 * Get highest number of erase cycles of a sector
+	 * @return erase cycles
+	 */
+	uint32_t getMaxErase(void);
+	/**
+	 * Get lowest number of erase cycles of a sector
+	 * @return erase cycles
+	 */
+	uint32_t getMinErase(void);
+
+	uint32_t getSize(void);
+	uint32_t getSectorSize(void);
+	bool read(uint32_t addr, uint8_t *data, uint32_t len);
+	bool program(uint32_t addr, const uint8_t *data, uint32_t len);
+	bool erase(uint32_t addr);
+
+private:
+	int _fd = -1;				///< Image file
+	uint32_t _size;				///< Flash size
+	uint32_t _sectorSize;		///< Erase unit
+	int32_t _powerFail = -1;	///< Bytes until the simulated power loss, -1 if disabled
+	uint32_t *_eraseCount;		///< Erase cycles per sector
+};
+
+/**
+ * Read only storage on a memory mapped flash image
+ */
+class PPG_LOG_MMAP_STORAGE : public PPG_LOG_STORAGE
+{
+public:
+	/**
+	 * PPG_LOG_MMAP_STORAGE constructor
+	 * @param path
+	 * 		Flash image file
+	 * @param sectorSize
+	 * 		Size of the erase unit of the flash the image was taken from
+	 */
+	PPG_LOG_MMAP_STORAGE(const char *path, uint32_t sectorSize = 4096);
+	~PPG_LOG_MMAP_STORAGE();
+
+	/**
+	 * Check if the image is mapped
+	 * @return result
+	 */
+	bool isOpen(void);
+
+	uint32_t getSize(void);
+	uint32_t getSectorSize(void);
+	bool read(uint32_t addr, uint8_t *data, uint32_t len);
+	/** Not supported, returns FALSE */
+	bool program(uint32_t addr, const uint8_t *data, uint32_t len);
+	/** Not supported, returns FALSE */
+	bool erase(uint32_t addr);
+
+private:
+	const uint8_t *_map = NULL; ///< Mapped image
+	uint32_t _size = 0;			///< Image size, rounded down to full sectors
+	size_t _mapSize = 0;		///< Size of the mapping
+	uint32_t _sectorSize;		///< Erase unit
+};
+#endif
+#endif
@@ -0,0 +1,185 @@
+/**
+ * @file ppgPipeline.cpp
+ * @brief Acquisition/processing pipeline for dual core targets
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "ppgPipeline.h"
+
+#ifdef PPG_HAS_THREADS
+
+/** Wait time of the tasks before they check if they should stop */
+#define PPG_PIPELINE_IDLE_MS 100
+
+PPG_PIPELINE::PPG_PIPELINE(PPG_SOURCE_FN source, void *sourceCtx)
+	: _running(false), _processing(false), _acquired(0), _dropped(0), _processed(0), _maxDepth(0)
+{
+	_source = source;
+	_sourceCtx = sourceCtx;
+#if PPG_TRACE_ENABLED
+	_traceId = 0;
+#endif
+}
+
+void PPG_PIPELINE::setHeartRate(HEART_RATE *hr)
+{
+	_hr = hr;
+}
+
+void PPG_PIPELINE::setResultCb(PPG_RESULT_FN result, void *ctx)
+{
+	_result = result;
+	_resultCtx = ctx;
+}
+
+bool PPG_PIPELINE::begin(int acqCore, int procCore, uint32_t pollMs)
+{
+	if (_running)
+	{
+		return false;
+	}
+	_pollMs = pollMs;
+	_running = true;
+	_processing = true;
+	if (!_procThread.start(processingTask, this, "ppgProc", procCore, 5))
+	{
+		_running = false;
+		_processing = false;
+		return false;
+	}
+	// Acquisition must not wait for processing, give it the higher priority
+	if (!_acqThread.start(acquisitionTask, this, "ppgAcq", acqCore, 10))
+	{
+		end();
+		return false;
+	}
+	return true;
+}
+
+void PPG_PIPELINE::end(void)
+{
+	// Acquisition first, then processing drains what acquisition queued
+	_running = false;
+	_dataReady.give();
+	_acqThread.join();
+	_processing = false;
+	_queued.give();
+	_procThread.join();
+}
+
+void PPG_PIPELINE::notifyFromISR(void)
+{
+#if PPG_TRACE_ENABLED
+	_traceId.store(PPG_TRACE_START_ID(PPG_TRACE_ISR), std::memory_order_relaxed);
+#endif
+	_dataReady.giveFromISR();
+}
+
+void PPG_PIPELINE::notify(void)
+{
+	_dataReady.give();
+}
+
+void PPG_PIPELINE::acquisitionTask(void *pipeline)
+{
+	PPG_PIPELINE *self = (PPG_PIPELINE *)pipeline;
+	uint32_t waitMs = (self->_pollMs != 0) ? self->_pollMs : PPG_PIPELINE_IDLE_MS;
+	PPG_SAMPLE sample;
+
+	while (self->_running)
+	{
+		bool notified = self->_dataReady.take(waitMs);
+		if (!self->_running)
+		{
+			break;
+		}
+		if (!notified && (self->_pollMs == 0))
+		{
+			continue;
+		}
+#if PPG_TRACE_ENABLED
+		// All samples read now belong to the latest interrupt, polled samples have none
+		uint16_t traceId = notified ? self->_traceId.load(std::memory_order_relaxed) : 0;
+		PPG_TRACE_ADOPT(traceId);
+#endif
+
+		// Read everything the source has
+		bool pushed = false;
+		while (self->_source(self->_sourceCtx, &sample))
+		{
+			self->_acquired++;
+#if PPG_TRACE_ENABLED
+			sample.traceId = traceId;
+#endif
+			if (!self->_queue.push(sample))
+			{
+				self->_dropped++;
+				continue;
+			}
+			pushed = true;
+		}
+		if (pushed)
+		{
+			uint16_t depth = self->_queue.size();
+			if (depth > self->_maxDepth)
+			{
+				self->_maxDepth = depth;
+			}
+			self->_queued.give();
+		}
+	}
+}
+
+void PPG_PIPELINE::processingTask(void *pipeline)
+{
+	PPG_PIPELINE *self = (PPG_PIPELINE *)pipeline;
+	PPG_SAMPLE sample;
+
+	bool last = false;
+	while (!last)
+	{
+		self->_queued.take(PPG_PIPELINE_IDLE_MS);
+		// Acquisition has ended when _processing is cleared, this is the final pass
+		last = !self->_processing;
+		while (self->_queue.pop(&sample))
+		{
+#if PPG_TRACE_ENABLED
+			// Filter, beat and consumer points belong to the interrupt of the sample
+			PPG_TRACE_ADOPT(sample.traceId);
+#endif
+			bool beat = false;
+			if (self->_hr != NULL)
+			{
+				beat = self->_hr->checkForBeat(sample.value);
+			}
+			if (self->_result != NULL)
+			{
+				PPG_TRACE_POINT(PPG_TRACE_CONSUMER, beat);
+				self->_result(self->_resultCtx, sample, beat);
+			}
+			self->_processed++;
+		}
+	}
+}
+
+uint32_t PPG_PIPELINE::getAcquired(void)
+{
+	return _acquired;
+}
+
+uint32_t PPG_PIPELINE::getDropped(void)
+{
+	return _dropped;
+}
+
+uint32_t PPG_PIPELINE::getProcessed(void)
+{
+	return _processed;
+}
+
+uint16_t PPG_PIPELINE::getMaxDepth(void)
+{
+	return _maxDepth;
+}
+#endif
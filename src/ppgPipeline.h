@@ -0,0 +1,159 @@
+/**
+ * @file ppgPipeline.h
+ * @brief Acquisition/processing pipeline for dual core targets
+ *
+ * @author   Bernd Giesecke
+ *
+ * Splits the work that usually runs in loop() into two tasks:
+ * - The acquisition task waits for the data ready interrupt of the sensor,
+ *   reads the samples and pushes them into a lock-free queue
+ * - The processing task pops the samples, runs the heart rate detection
+ *   and calls the user result callback
+ *
+ * On ESP32 the tasks are pinned to different cores. On Linux the same pipeline
+ * runs with std::thread, e.g. with a simulated sensor as sample source.
+ * Only available on targets with threads (PPG_HAS_THREADS).
+ */
+#ifndef PPG_PIPELINE_H
+#define PPG_PIPELINE_H
+
+#include "ppgQueue.h"
+#include "ppgSample.h"
+#include "ppgTrace.h"
+#include "heartRate.h"
+
+#ifdef PPG_HAS_THREADS
+
+/** Number of samples the queue between acquisition and processing can hold */
+#define PPG_PIPELINE_QUEUE_SIZE 256
+
+/**
+ * Acquisition/processing pipeline
+ */
+class PPG_PIPELINE
+{
+public:
+	/**
+	 * Sample source, called by the acquisition task
+	 * @param ctx
+	 * 		User context
+	 * @param sample
+	 * 		Pointer to the sample to fill
+	 * @return result
+	 * 		TRUE if a sample was read, FALSE if no data is available
+	 */
+	typedef bool (*PPG_SOURCE_FN)(void *ctx, PPG_SAMPLE *sample);
+	/**
+	 * Result callback, called by the processing task for every sample
+	 * @param ctx
+	 * 		User context
+	 * @param sample
+	 * 		Processed sample
+	 * @param beat
+	 * 		TRUE if the heart rate detection found a beat in this sample
+	 */
+	typedef void (*PPG_RESULT_FN)(void *ctx, const PPG_SAMPLE &sample, bool beat);
+
+	/**
+	 * PPG_PIPELINE constructor
+	 * @param source
+	 * 		Sample source function
+	 * @param sourceCtx
+	 * 		User context for the sample source
+	 */
+	PPG_PIPELINE(PPG_SOURCE_FN source, void *sourceCtx);
+
+	/**
+	 * Set the heart rate detection run by the processing task
+	 * @param hr
+	 * 		Pointer to HEART_RATE instance, NULL to skip the detection
+	 */
+	void setHeartRate(HEART_RATE *hr);
+	/**
+	 * Set the result callback
+	 * @param result
+	 * 		Result callback function
+	 * @param ctx
+	 * 		User context for the result callback
+	 */
+	void setResultCb(PPG_RESULT_FN result, void *ctx);
+	/**
+	 * Start the acquisition and processing tasks
+	 * @param acqCore
+	 * 		Core for the acquisition task (ESP32 only)
+	 * @param procCore
+	 * 		Core for the processing task (ESP32 only)
+	 * @param pollMs
+	 * 		If no data ready notification arrives within pollMs, the source is polled.
+	 * 		0 to rely on notifyFromISR()/notify() only
+	 * @return result
+	 * 		FALSE if the tasks could not be started
+	 */
+	bool begin(int acqCore = 0, int procCore = 1, uint32_t pollMs = 0);
+	/**
+	 * Stop both tasks and wait until they ended
+	 * The acquisition task is stopped first, the samples it queued are
+	 * processed before the processing task ends, acquired = processed + dropped.
+	 */
+	void end(void);
+	/**
+	 * Notify the acquisition task that data is ready, call from the sensor interrupt
+	 * With PPG_TRACE_ENABLED it starts a new trace id, the samples read for this
+	 * notification carry it through the processing task.
+	 */
+	void notifyFromISR(void);
+	/**
+	 * Notify the acquisition task that data is ready, call from a task/thread
+	 */
+	void notify(void);
+
+	/**
+	 * Get number of samples read by the acquisition task
+	 * @return number of samples
+	 */
+	uint32_t getAcquired(void);
+	/**
+	 * Get number of samples lost because the queue was full
+	 * @return number of samples
+	 */
+	uint32_t getDropped(void);
+	/**
+	 * Get number of samples handled by the processing task
+	 * @return number of samples
+	 */
+	uint32_t getProcessed(void);
+	/**
+	 * Get highest fill level of the queue
+	 * @return number of samples
+	 */
+	uint16_t getMaxDepth(void);
+
+private:
+	static void acquisitionTask(void *pipeline);
+	static void processingTask(void *pipeline);
+
+	PPG_SOURCE_FN _source;	 ///< Sample source
+	void *_sourceCtx;		 ///< User context of the sample source
+	PPG_RESULT_FN _result = NULL; ///< Result callback
+	void *_resultCtx = NULL; ///< User context of the result callback
+	HEART_RATE *_hr = NULL;	 ///< Heart rate detection
+
+	PPG_SPSC_QUEUE<PPG_SAMPLE, PPG_PIPELINE_QUEUE_SIZE> _queue; ///< Samples from acquisition to processing
+	PPG_SIGNAL _dataReady; ///< Sensor has data
+	PPG_SIGNAL _queued;	   ///< Samples were pushed into the queue
+	PPG_THREAD _acqThread; ///< Acquisition task
+	PPG_THREAD _procThread; ///< Processing task
+	uint32_t _pollMs = 0;  ///< Poll interval of the sample source
+
+	std::atomic<bool> _running;		 ///< Flag if the tasks should run
+	std::atomic<bool> _processing;	 ///< Flag if the processing task should run, cleared after the acquisition task ended
+	std::atomic<uint32_t> _acquired;  ///< Samples read
+	std::atomic<uint32_t> _dropped;	 ///< Samples lost
+	std::atomic<uint32_t> _processed; ///< Samples processed
+	std::atomic<uint16_t> _maxDepth;  ///< Highest queue fill level
+#if PPG_TRACE_ENABLED
+	std::atomic<uint16_t> _traceId; ///< Trace id of the latest notifyFromISR()
+#endif
+};
+#endif
+#endif
@@ -0,0 +1,30 @@
+/**
+ * @file ppgPlatform.cpp
+ * @brief Platform abstraction for the signal processing part of the library
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "ppgPlatform.h"
+
+#ifndef ARDUINO
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long millis(void)
+{
+	return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros(void)
+{
+	return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+#endif
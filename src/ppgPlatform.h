@@ -0,0 +1,43 @@
+/**
+ * @file ppgPlatform.h
+ * @brief Platform abstraction for the signal processing part of the library
+ *
+ * @author   Bernd Giesecke
+ *
+ * The signal processing classes (HEART_RATE, HRV, HR_SPECTRAL, ...) only need
+ * integer types, math functions and a microsecond clock. On Arduino these come
+ * from Arduino.h. Without Arduino (host tools and tests on Linux) this header
+ * provides them from the C++ standard library, implemented in ppgPlatform.cpp.
+ */
+#ifndef PPG_PLATFORM_H
+#define PPG_PLATFORM_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+/** Constant tables in flash, on the host they are normal constants */
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#endif
+
+/** Milliseconds since start of the program */
+unsigned long millis(void);
+/** Microseconds since start of the program */
+unsigned long micros(void);
+/** Wait for ms milliseconds */
+void delay(unsigned long ms);
+#endif
+#endif
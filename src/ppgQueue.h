@@ -0,0 +1,213 @@
+/**
+ * @file ppgQueue.h
+ * @brief Lock-free single/multi producer, single consumer queues
+ *
+ * @author   Bernd Giesecke
+ *
+ * - PPG_SPSC_QUEUE is used between the acquisition and the processing task of
+ *   PPG_PIPELINE. One task may push, one other task may pop.
+ * - PPG_MPSC_QUEUE feeds the shard workers of PPG_ENGINE. Any number of threads
+ *   may push, one thread pops.
+ * No locks are taken. Only available on targets with threads (PPG_HAS_THREADS).
+ */
+#ifndef PPG_QUEUE_H
+#define PPG_QUEUE_H
+
+#include "ppgThread.h"
+
+#ifdef PPG_HAS_THREADS
+#include <atomic>
+
+/** Cache line size, keeps the producer and consumer counters apart */
+#define PPG_CACHE_LINE 64
+
+/**
+ * Lock-free ring buffer
+ * @tparam T
+ * 		Element type
+ * @tparam SIZE
+ * 		Number of elements, must be a power of 2
+ */
+template <class T, uint16_t SIZE>
+class PPG_SPSC_QUEUE
+{
+public:
+	PPG_SPSC_QUEUE(void) : _head(0), _tail(0)
+	{
+	}
+
+	/**
+	 * Add an element (producer side)
+	 * @param item
+	 * 		Element to add
+	 * @return result
+	 * 		FALSE if the queue is full
+	 */
+	bool push(const T &item)
+	{
+		uint32_t head = _head.load(std::memory_order_relaxed);
+		if ((head - _tail.load(std::memory_order_acquire)) >= SIZE)
+		{
+			return false;
+		}
+		_items[head & (SIZE - 1)] = item;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove an element (consumer side)
+	 * @param item
+	 * 		Pointer to the element to fill
+	 * @return result
+	 * 		FALSE if the queue is empty
+	 */
+	bool pop(T *item)
+	{
+		uint32_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		*item = _items[tail & (SIZE - 1)];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Get number of elements in the queue
+	 * @return number of elements, only a snapshot if called while the other side is active
+	 */
+	uint16_t size(void)
+	{
+		return (uint16_t)(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+	}
+
+private:
+	static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+
+	T _items[SIZE];				  ///< Ring buffer
+	std::atomic<uint32_t> _head; ///< Number of elements pushed
+	std::atomic<uint32_t> _tail; ///< Number of elements popped
+};
+
+/**
+ * Lock-free bounded ring buffer for several producers
+ * Every cell carries a sequence number that tells the producers if the cell is
+ * free and the consumer if it is filled. Producers reserve a cell by advancing the
+ * head with compare and swap, fill it and then publish it with its sequence number.
+ * Elements of one producer are popped in the order they were pushed.
+ * @tparam T
+ * 		Element type
+ * @tparam SIZE
+ * 		Number of elements, must be a power of 2
+ */
+template <class T, uint16_t SIZE>
+class PPG_MPSC_QUEUE
+{
+public:
+	PPG_MPSC_QUEUE(void) : _head(0), _tail(0)
+	{
+		for (uint32_t idx = 0; idx < SIZE; idx++)
+		{
+			_cells[idx].seq.store(idx, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * Add an element, can be called from any thread
+	 * @param item
+	 * 		Element to add
+	 * @return result
+	 * 		FALSE if the queue is full
+	 */
+	bool push(const T &item)
+	{
+		CELL *cell;
+		uint32_t head = _head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &_cells[head & (SIZE - 1)];
+			int32_t diff = (int32_t)(cell->seq.load(std::memory_order_acquire) - head);
+			if (diff == 0)
+			{
+				// Cell is free, try to reserve it
+				if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// Cell is not popped yet
+				return false;
+			}
+			else
+			{
+				// Another producer took the cell
+				head = _head.load(std::memory_order_relaxed);
+			}
+		}
+		cell->item = item;
+		cell->seq.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove an element (consumer side)
+	 * @param item
+	 * 		Pointer to the element to fill
+	 * @return result
+	 * 		FALSE if the queue is empty or the oldest element is still being written
+	 */
+	bool pop(T *item)
+	{
+		uint32_t tail = _tail.load(std::memory_order_relaxed);
+		CELL *cell = &_cells[tail & (SIZE - 1)];
+		if ((int32_t)(cell->seq.load(std::memory_order_acquire) - (tail + 1)) < 0)
+		{
+			return false;
+		}
+		*item = cell->item;
+		cell->seq.store(tail + SIZE, std::memory_order_release);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Get number of elements in the queue
+	 * @return number of elements including cells that are still being written, only a snapshot
+	 */
+	uint16_t size(void)
+	{
+		uint32_t tail = _tail.load(std::memory_order_acquire);
+		return (uint16_t)(_head.load(std::memory_order_acquire) - tail);
+	}
+
+	/**
+	 * Get number of elements pushed since the start
+	 * @return number of elements, wraps around at 2^32
+	 */
+	uint32_t getPushed(void)
+	{
+		return _head.load(std::memory_order_acquire);
+	}
+
+private:
+	static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+
+	/** One element and its sequence number */
+	struct CELL
+	{
+		std::atomic<uint32_t> seq; ///< Position the cell is free for, +1 when it is filled
+		T item;					   ///< Element
+	};
+
+	CELL _cells[SIZE]; ///< Ring buffer
+	std::atomic<uint32_t> _head; ///< Number of cells reserved by producers
+	uint8_t _headPad[PPG_CACHE_LINE - sizeof(std::atomic<uint32_t>)]; ///< Producers and consumer on different cache lines
+	std::atomic<uint32_t> _tail; ///< Number of elements popped
+	uint8_t _tailPad[PPG_CACHE_LINE - sizeof(std::atomic<uint32_t>)]; ///< Keeps the next object off the consumer cache line
+};
+#endif
+#endif
@@ -0,0 +1,23 @@
+/**
+ * @file ppgSample.h
+ * @brief Time stamped sensor sample
+ *
+ * @author   Bernd Giesecke
+ */
+#ifndef PPG_SAMPLE_H
+#define PPG_SAMPLE_H
+
+#include "ppgPlatform.h"
+
+/**
+ * Time stamped sensor sample
+ */
+struct PPG_SAMPLE
+{
+	uint32_t timestamp; ///< Time of the sample in microseconds
+	uint16_t value;		///< Sensor value
+#if defined(PPG_TRACE_ENABLED) && PPG_TRACE_ENABLED
+	uint16_t traceId; ///< Trace id of the interrupt that announced the sample, 0 if it was polled
+#endif
+};
+#endif
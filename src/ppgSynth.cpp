@@ -0,0 +1,328 @@
+/**
+ * @file ppgSynth.cpp
+ * @brief Deterministic synthetic PPG signal and beat detection scoring
+ *
+ * @author   Bernd Giesecke
+ */
+#include "ppgSynth.h"
+
+/**
+ * PPG_SYNTH constructor
+ */
+PPG_SYNTH::PPG_SYNTH(void)
+{
+	getPreset(0, &_config);
+}
+
+void PPG_SYNTH::begin(const PPG_SYNTH_CONFIG &config)
+{
+	_config = config;
+	_state = (config.seed != 0) ? config.seed : 1;
+	_sample = 0;
+	_beatStart = 0.0;
+	_beatLength = 1.0;
+	_nextStart = 0.0;
+	_lastOnset = 0;
+	_interval = 0;
+	_beat = false;
+	_started = false;
+	_motionStart = -1.0;
+	_motionLength = PPG_SYNTH_MOTION_SEC * config.sampleRate;
+	_motionProb = config.motionPerMin / 60.0 / config.sampleRate;
+}
+
+int32_t PPG_SYNTH::next(void)
+{
+	float n = (float)_sample;
+	_beat = false;
+	if (n >= _nextStart)
+	{
+		nextBeat();
+	}
+
+	// Pulse, fast upstroke, exponential decay with dicrotic wave, back to 0 at the end of the beat
+	float phase = (n - _beatStart) / _beatLength;
+	float pulse;
+	if (phase < 0.15)
+	{
+		pulse = sin(PI / 2.0 * phase / 0.15);
+		pulse *= pulse;
+	}
+	else
+	{
+		float dicrotic = (phase - 0.45) / 0.05;
+		pulse = (exp(-(phase - 0.15) / 0.25) - 0.0334) / (1.0 - 0.0334) + 0.12 * exp(-dicrotic * dicrotic);
+	}
+	float value = _config.dcLevel + _config.pulseAmp * pulse;
+
+	value += _config.wanderAmp * sin(2.0 * PI * _config.wanderHz * n / _config.sampleRate);
+
+	// Motion artifact, 2.5Hz swing with half sine envelope
+	if ((_motionStart < 0.0) && (_motionProb > 0.0) && ((uniform() + 1.0) * 0.5 < _motionProb))
+	{
+		_motionStart = n;
+	}
+	if (_motionStart >= 0.0)
+	{
+		float t = n - _motionStart;
+		if (t >= _motionLength)
+		{
+			_motionStart = -1.0;
+		}
+		else
+		{
+			value += _config.motionAmp * sin(2.0 * PI * 2.5 * t / _config.sampleRate) * sin(PI * t / _motionLength);
+		}
+	}
+
+	value += _config.noiseAmp * uniform();
+
+	// Saturation of the ADC
+	if (value < 0.0)
+	{
+		value = 0.0;
+	}
+	if (value > _config.maxLevel)
+	{
+		value = _config.maxLevel;
+	}
+	_sample++;
+	return (int32_t)value;
+}
+
+bool PPG_SYNTH::isBeat(void)
+{
+	return _beat;
+}
+
+uint32_t PPG_SYNTH::getSampleIndex(void)
+{
+	return _sample - 1;
+}
+
+uint32_t PPG_SYNTH::getBeatInterval(void)
+{
+	return _interval;
+}
+
+/**
+ * Start the next beat with a random deviation from the mean interval
+ */
+void PPG_SYNTH::nextBeat(void)
+{
+	_beatStart = _nextStart;
+	_beatLength = 60.0 / _config.bpm * _config.sampleRate * (1.0 + _config.hrvPercent / 100.0 * uniform());
+	_nextStart = _beatStart + _beatLength;
+	_interval = _started ? (_sample - _lastOnset) : 0;
+	_lastOnset = _sample;
+	_started = true;
+	_beat = true;
+}
+
+/**
+ * Pseudo random generator (xorshift32), same sequence on every platform
+ */
+uint32_t PPG_SYNTH::random(void)
+{
+	_state ^= _state << 13;
+	_state ^= _state >> 17;
+	_state ^= _state << 5;
+	return _state;
+}
+
+/**
+ * Uniform random value
+ * @return -1.0 to 1.0
+ */
+float PPG_SYNTH::uniform(void)
+{
+	return (float)(random() >> 8) * (2.0 / 16777216.0) - 1.0;
+}
+
+bool PPG_SYNTH::getPreset(uint8_t index, PPG_SYNTH_CONFIG *config, float sampleRate)
+{
+	if (index >= PPG_SYNTH_NUM_PRESETS)
+	{
+		return false;
+	}
+	// Resting adult, the other presets change one aspect of it
+	config->sampleRate = sampleRate;
+	config->bpm = 65.0;
+	config->hrvPercent = 4.0;
+	config->dcLevel = 30000;
+	config->pulseAmp = 300;
+	config->wanderAmp = 30;
+	config->wanderHz = 0.25;
+	config->motionPerMin = 0.0;
+	config->motionAmp = 0;
+	config->noiseAmp = 5;
+	config->maxLevel = 65535;
+	config->seed = 0x5EED0001UL + index;
+
+	switch (index)
+	{
+	case 1: // Exercise
+		config->bpm = 150.0;
+		config->hrvPercent = 1.0;
+		config->pulseAmp = 200;
+		config->noiseAmp = 10;
+		break;
+	case 2: // Bradycardia
+		config->bpm = 42.0;
+		break;
+	case 3: // Strong breathing
+		config->wanderAmp = 400;
+		config->wanderHz = 0.3;
+		break;
+	case 4: // Motion
+		config->bpm = 80.0;
+		config->motionPerMin = 6.0;
+		config->motionAmp = 1500;
+		break;
+	case 5: // Noise
+		config->bpm = 70.0;
+		config->noiseAmp = 60;
+		break;
+	case 6: // Saturation near full scale
+		config->bpm = 75.0;
+		config->dcLevel = 65200;
+		config->pulseAmp = 600;
+		break;
+	case 7: // Low perfusion
+		config->pulseAmp = 50;
+		config->noiseAmp = 3;
+		break;
+	}
+	return true;
+}
+
+const char *PPG_SYNTH::getPresetName(uint8_t index)
+{
+	switch (index)
+	{
+	case 0:
+		return "rest";
+	case 1:
+		return "exercise";
+	case 2:
+		return "bradycardia";
+	case 3:
+		return "breathing";
+	case 4:
+		return "motion";
+	case 5:
+		return "noise";
+	case 6:
+		return "saturation";
+	case 7:
+		return "low perfusion";
+	}
+	return "";
+}
+
+/**
+ * PPG_SYNTH_SCORE constructor
+ */
+PPG_SYNTH_SCORE::PPG_SYNTH_SCORE(uint32_t maxLag)
+{
+	_maxLag = maxLag;
+}
+
+void PPG_SYNTH_SCORE::reset(void)
+{
+	_numPending = 0;
+	_truePos = 0;
+	_falsePos = 0;
+	_falseNeg = 0;
+	_bpmErrSum = 0.0;
+	_bpmCount = 0;
+}
+
+void PPG_SYNTH_SCORE::addTruth(uint32_t sample, float bpm)
+{
+	expire(sample);
+	if (_numPending == PPG_SYNTH_SCORE_PENDING)
+	{
+		// Oldest open beat can not be matched anymore
+		_falseNeg++;
+		drop();
+	}
+	_pending[_numPending] = sample;
+	_pendingBpm[_numPending] = bpm;
+	_numPending++;
+}
+
+void PPG_SYNTH_SCORE::addDetection(uint32_t sample, int bpm)
+{
+	expire(sample);
+	if ((_numPending == 0) || (_pending[0] > sample))
+	{
+		_falsePos++;
+		return;
+	}
+	_truePos++;
+	if ((bpm != 0) && (_pendingBpm[0] > 0.0))
+	{
+		_bpmErrSum += fabs(bpm - _pendingBpm[0]);
+		_bpmCount++;
+	}
+	drop();
+}
+
+void PPG_SYNTH_SCORE::finish(uint32_t sample)
+{
+	expire(sample);
+	_falseNeg += _numPending;
+	_numPending = 0;
+}
+
+/**
+ * Count the open true beats older than the maximum lag as missed
+ */
+void PPG_SYNTH_SCORE::expire(uint32_t sample)
+{
+	while ((_numPending > 0) && ((_pending[0] + _maxLag) < sample))
+	{
+		_falseNeg++;
+		drop();
+	}
+}
+
+/**
+ * Remove the oldest open true beat
+ */
+void PPG_SYNTH_SCORE::drop(void)
+{
+	for (uint8_t i = 1; i < _numPending; i++)
+	{
+		_pending[i - 1] = _pending[i];
+		_pendingBpm[i - 1] = _pendingBpm[i];
+	}
+	_numPending--;
+}
+
+uint32_t PPG_SYNTH_SCORE::getTruePos(void)
+{
+	return _truePos;
+}
+
+uint32_t PPG_SYNTH_SCORE::getFalsePos(void)
+{
+	return _falsePos;
+}
+
+uint32_t PPG_SYNTH_SCORE::getFalseNeg(void)
+{
+	return _falseNeg;
+}
+
+float PPG_SYNTH_SCORE::getF1(void)
+{
+	uint32_t denominator = 2 * _truePos + _falsePos + _falseNeg;
+	return denominator ? (2.0 * _truePos / denominator) : 0.0;
+}
+
+float PPG_SYNTH_SCORE::getBpmError(void)
+{
+	return _bpmCount ? (_bpmErrSum / _bpmCount) : 0.0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file ppgSynth.h
+ * @brief Deterministic synthetic PPG signal and beat detection scoring
+ *
+ * @author   Bernd Giesecke
+ *
+ * PPG_SYNTH generates a bio sensor signal with known beat times, so the beat
+ * detection can be checked without a sensor and without recordings.
+ * - Pulse with systolic peak and dicrotic wave on a DC level
+ * - Heart rate variability as random beat to beat jitter
+ * - Baseline wander, motion artifacts, noise and saturation of the ADC
+ * - Own pseudo random generator, the same seed gives the same signal on every platform
+ *
+ * The presets are the golden dataset of the library, each one with the
+ * beat times the generator reports. PPG_SYNTH_SCORE matches detected beats
+ * against these beat times.
+ */
+#ifndef PPG_SYNTH_H
+#define PPG_SYNTH_H
+
+#include "ppgPlatform.h"
+
+/** Number of presets */
+#define PPG_SYNTH_NUM_PRESETS 8
+/** Duration of a motion artifact in seconds */
+#define PPG_SYNTH_MOTION_SEC 0.5
+/** Maximum number of true beats waiting for a detection in PPG_SYNTH_SCORE */
+#define PPG_SYNTH_SCORE_PENDING 4
+
+/**
+ * Synthetic signal settings
+ */
+struct PPG_SYNTH_CONFIG
+{
+	float sampleRate;	  ///< Samples per second
+	float bpm;			  ///< Mean heart rate
+	float hrvPercent;	  ///< Maximum beat to beat deviation from the mean interval in percent
+	int32_t dcLevel;	  ///< DC level in sensor counts
+	int32_t pulseAmp;	  ///< Pulse amplitude in sensor counts
+	int32_t wanderAmp;	  ///< Baseline wander amplitude in sensor counts
+	float wanderHz;		  ///< Baseline wander frequency (e.g. breathing)
+	float motionPerMin;	  ///< Mean number of motion artifacts per minute
+	int32_t motionAmp;	  ///< Motion artifact amplitude in sensor counts
+	int32_t noiseAmp;	  ///< Peak noise amplitude in sensor counts
+	int32_t maxLevel;	  ///< Saturation level of the ADC
+	uint32_t seed;		  ///< Seed of the pseudo random generator, must not be 0
+};
+
+/**
+ * Synthetic PPG generator
+ */
+class PPG_SYNTH
+{
+public:
+	PPG_SYNTH(void);
+
+	/**
+	 * Start a new signal
+	 * @param config
+	 * 		Signal settings
+	 */
+	void begin(const PPG_SYNTH_CONFIG &config);
+	/**
+	 * Get the next sample
+	 * @return sample value in sensor counts
+	 */
+	int32_t next(void);
+	/**
+	 * Check if a beat started with the last sample
+	 * @return result
+	 * 		TRUE if the last sample from next() is the onset of a pulse
+	 */
+	bool isBeat(void);
+	/**
+	 * Get the number of the last sample, starting with 0
+	 * @return sample number
+	 */
+	uint32_t getSampleIndex(void);
+	/**
+	 * Get the interval of the current beat
+	 * @return interval to the previous beat in samples, 0 for the first beat
+	 */
+	uint32_t getBeatInterval(void);
+
+	/**
+	 * Get the settings of a preset
+	 * @param index
+	 * 		Preset number, 0 to PPG_SYNTH_NUM_PRESETS - 1
+	 * @param config
+	 * 		Pointer to the settings to fill
+	 * @param sampleRate
+	 * 		Sample rate of the signal
+	 * @return result
+	 * 		FALSE if the preset does not exist
+	 */
+	static bool getPreset(uint8_t index, PPG_SYNTH_CONFIG *config, float sampleRate = 125.0);
+	/**
+	 * Get the name of a preset
+	 * @param index
+	 * 		Preset number
+	 * @return name, empty if the preset does not exist
+	 */
+	static const char *getPresetName(uint8_t index);
+
+private:
+	uint32_t random(void);
+	float uniform(void);
+	void nextBeat(void);
+
+	PPG_SYNTH_CONFIG _config; ///< Signal settings
+	uint32_t _state = 1;	  ///< State of the pseudo random generator
+	uint32_t _sample = 0;	  ///< Number of the next sample
+	float _beatStart = 0.0;	  ///< Start of the current beat in samples
+	float _beatLength = 1.0;  ///< Length of the current beat in samples
+	float _nextStart = 0.0;	  ///< Start of the next beat in samples
+	uint32_t _lastOnset = 0;  ///< Sample number of the last beat onset
+	uint32_t _interval = 0;	  ///< Interval of the current beat in samples
+	bool _beat = false;		  ///< Flag if the last sample is a beat onset
+	bool _started = false;	  ///< Flag if a beat was reported
+	float _motionStart = -1.0; ///< Start of the current motion artifact in samples, negative if none
+	float _motionLength = 1.0; ///< Length of a motion artifact in samples
+	float _motionProb = 0.0;   ///< Probability of a motion artifact starting in a sample
+};
+
+/**
+ * Beat detection score against known beat times
+ * A detection matches the oldest open true beat if it is no more than
+ * the maximum lag after it, the fixed delay of the detection (filters,
+ * zero crossing) is covered by the lag.
+ */
+class PPG_SYNTH_SCORE
+{
+public:
+	/**
+	 * PPG_SYNTH_SCORE constructor
+	 * @param maxLag
+	 * 		Maximum number of samples a detection may come after the true beat
+	 */
+	PPG_SYNTH_SCORE(uint32_t maxLag);
+
+	/** Start a new count */
+	void reset(void);
+	/**
+	 * Add a true beat
+	 * @param sample
+	 * 		Sample number of the beat
+	 * @param bpm
+	 * 		True heart rate of the beat, 0 if not known
+	 */
+	void addTruth(uint32_t sample, float bpm);
+	/**
+	 * Add a detected beat
+	 * @param sample
+	 * 		Sample number of the detection
+	 * @param bpm
+	 * 		Detected heart rate, 0 if not known
+	 */
+	void addDetection(uint32_t sample, int bpm);
+	/**
+	 * Close all true beats that can no longer be matched
+	 * @param sample
+	 * 		Current sample number, at the end of the signal
+	 */
+	void finish(uint32_t sample);
+
+	/** @return number of detections with a true beat */
+	uint32_t getTruePos(void);
+	/** @return number of detections without a true beat */
+	uint32_t getFalsePos(void);
+	/** @return number of true beats without detection */
+	uint32_t getFalseNeg(void);
+	/** @return F1 score 0.0 to 1.0 */
+	float getF1(void);
+	/** @return mean absolute heart rate error of the matched beats in beats/minute */
+	float getBpmError(void);
+
+private:
+	void expire(uint32_t sample);
+	void drop(void);
+
+	uint32_t _maxLag;								 ///< Maximum lag of a detection
+	uint32_t _pending[PPG_SYNTH_SCORE_PENDING];		 ///< Open true beats
+	float _pendingBpm[PPG_SYNTH_SCORE_PENDING];		 ///< Heart rate of the open true beats
+	uint8_t _numPending = 0;						 ///< Number of open true beats
+	uint32_t _truePos = 0;							 ///< Matched detections
+	uint32_t _falsePos = 0;							 ///< Detections without true beat
+	uint32_t _falseNeg = 0;							 ///< True beats without detection
+	float _bpmErrSum = 0.0;							 ///< Sum of the heart rate errors
+	uint32_t _bpmCount = 0;							 ///< Number of heart rate errors
+};
+#endif
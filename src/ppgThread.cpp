@@ -0,0 +1,188 @@
+/**
+ * @file ppgThread.cpp
+ * @brief Minimal threading abstraction for ESP32 (FreeRTOS) and Linux (std::thread)
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "ppgThread.h"
+
+#ifdef PPG_HAS_THREADS
+
+#ifdef ESP32
+PPG_MUTEX::PPG_MUTEX(void)
+{
+	_handle = xSemaphoreCreateMutex();
+}
+
+PPG_MUTEX::~PPG_MUTEX()
+{
+	vSemaphoreDelete(_handle);
+}
+
+void PPG_MUTEX::lock(void)
+{
+	xSemaphoreTake(_handle, portMAX_DELAY);
+}
+
+void PPG_MUTEX::unlock(void)
+{
+	xSemaphoreGive(_handle);
+}
+
+PPG_SIGNAL::PPG_SIGNAL(void)
+{
+	_handle = xSemaphoreCreateBinary();
+}
+
+PPG_SIGNAL::~PPG_SIGNAL()
+{
+	vSemaphoreDelete(_handle);
+}
+
+void PPG_SIGNAL::give(void)
+{
+	xSemaphoreGive(_handle);
+}
+
+void IRAM_ATTR PPG_SIGNAL::giveFromISR(void)
+{
+	BaseType_t woken = pdFALSE;
+	xSemaphoreGiveFromISR(_handle, &woken);
+	if (woken == pdTRUE)
+	{
+		portYIELD_FROM_ISR();
+	}
+}
+
+bool PPG_SIGNAL::take(uint32_t timeoutMs)
+{
+	return xSemaphoreTake(_handle, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+PPG_THREAD::PPG_THREAD(void)
+{
+}
+
+PPG_THREAD::~PPG_THREAD()
+{
+}
+
+void PPG_THREAD::trampoline(void *thread)
+{
+	PPG_THREAD *self = (PPG_THREAD *)thread;
+	self->_fn(self->_ctx);
+	self->_done.give();
+	vTaskDelete(NULL);
+}
+
+bool PPG_THREAD::start(PPG_THREAD_FN fn, void *ctx, const char *name, int core, uint8_t priority, uint32_t stackSize)
+{
+	_fn = fn;
+	_ctx = ctx;
+	BaseType_t result;
+	if (core < 0)
+	{
+		result = xTaskCreate(trampoline, name, stackSize, this, priority, &_handle);
+	}
+	else
+	{
+		result = xTaskCreatePinnedToCore(trampoline, name, stackSize, this, priority, &_handle, core);
+	}
+	_running = (result == pdPASS);
+	return _running;
+}
+
+void PPG_THREAD::join(void)
+{
+	if (_running)
+	{
+		_done.take(portMAX_DELAY);
+		_running = false;
+	}
+}
+#else
+PPG_MUTEX::PPG_MUTEX(void)
+{
+}
+
+PPG_MUTEX::~PPG_MUTEX()
+{
+}
+
+void PPG_MUTEX::lock(void)
+{
+	_mutex.lock();
+}
+
+void PPG_MUTEX::unlock(void)
+{
+	_mutex.unlock();
+}
+
+PPG_SIGNAL::PPG_SIGNAL(void)
+{
+}
+
+PPG_SIGNAL::~PPG_SIGNAL()
+{
+}
+
+void PPG_SIGNAL::give(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_set = true;
+	}
+	_cv.notify_one();
+}
+
+void PPG_SIGNAL::giveFromISR(void)
+{
+	give();
+}
+
+bool PPG_SIGNAL::take(uint32_t timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (!_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return _set; }))
+	{
+		return false;
+	}
+	_set = false;
+	return true;
+}
+
+PPG_THREAD::PPG_THREAD(void)
+{
+}
+
+PPG_THREAD::~PPG_THREAD()
+{
+	join();
+}
+
+void PPG_THREAD::trampoline(void *thread)
+{
+	PPG_THREAD *self = (PPG_THREAD *)thread;
+	self->_fn(self->_ctx);
+}
+
+// Name, core, priority and stack size are left to the OS scheduler
+bool PPG_THREAD::start(PPG_THREAD_FN fn, void *ctx, const char *, int, uint8_t, uint32_t)
+{
+	_fn = fn;
+	_ctx = ctx;
+	_thread = std::thread(trampoline, this);
+	return true;
+}
+
+void PPG_THREAD::join(void)
+{
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+}
+#endif
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file ppgThread.h
+ * @brief Minimal threading abstraction for ESP32 (FreeRTOS) and Linux (std::thread)
+ *
+ * @author   Bernd Giesecke
+ *
+ * Only available on targets with threads, PPG_HAS_THREADS is defined then.
+ * - PPG_MUTEX mutual exclusion
+ * - PPG_SIGNAL binary semaphore that can be given from an interrupt
+ * - PPG_THREAD task/thread, optionally pinned to a core
+ */
+#ifndef PPG_THREAD_H
+#define PPG_THREAD_H
+
+#include "ppgPlatform.h"
+
+#if defined(ESP32) || !defined(ARDUINO)
+/** Threads are available on this target */
+#define PPG_HAS_THREADS 1
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/**
+ * Mutex
+ */
+class PPG_MUTEX
+{
+public:
+	PPG_MUTEX(void);
+	~PPG_MUTEX();
+	/** Wait for and take the mutex */
+	void lock(void);
+	/** Release the mutex */
+	void unlock(void);
+
+private:
+#ifdef ESP32
+	SemaphoreHandle_t _handle; ///< FreeRTOS mutex
+#else
+	std::mutex _mutex; ///< Standard mutex
+#endif
+};
+
+/**
+ * Binary semaphore
+ */
+class PPG_SIGNAL
+{
+public:
+	PPG_SIGNAL(void);
+	~PPG_SIGNAL();
+	/** Set the signal from a task/thread */
+	void give(void);
+	/** Set the signal from an interrupt service routine */
+	void giveFromISR(void);
+	/**
+	 * Wait for the signal and clear it
+	 * @param timeoutMs
+	 * 		Maximum wait time in milliseconds
+	 * @return result
+	 * 		TRUE if the signal was set, FALSE on timeout
+	 */
+	bool take(uint32_t timeoutMs);
+
+private:
+#ifdef ESP32
+	SemaphoreHandle_t _handle; ///< FreeRTOS binary semaphore
+#else
+	std::mutex _mutex;			 ///< Protects _set
+	std::condition_variable _cv; ///< Wakes up the waiting thread
+	bool _set = false;			 ///< Signal state
+#endif
+};
+
+/**
+ * Task/thread
+ */
+class PPG_THREAD
+{
+public:
+	/** Thread function */
+	typedef void (*PPG_THREAD_FN)(void *ctx);
+
+	PPG_THREAD(void);
+	~PPG_THREAD();
+	/**
+	 * Start the thread
+	 * @param fn
+	 * 		Thread function, the thread ends when it returns
+	 * @param ctx
+	 * 		Parameter for the thread function
+	 * @param name
+	 * 		Name of the task (ESP32 only)
+	 * @param core
+	 * 		Core the task is pinned to, -1 for no affinity (ESP32 only)
+	 * @param priority
+	 * 		Task priority (ESP32 only)
+	 * @param stackSize
+	 * 		Task stack size in bytes (ESP32 only)
+	 * @return result
+	 * 		FALSE if the thread could not be started
+	 */
+	bool start(PPG_THREAD_FN fn, void *ctx, const char *name, int core = -1, uint8_t priority = 5, uint32_t stackSize = 4096);
+	/**
+	 * Wait until the thread function returned
+	 */
+	void join(void);
+
+private:
+	static void trampoline(void *thread);
+
+	PPG_THREAD_FN _fn = NULL; ///< Thread function
+	void *_ctx = NULL;		  ///< Parameter for the thread function
+#ifdef ESP32
+	TaskHandle_t _handle = NULL; ///< FreeRTOS task
+	PPG_SIGNAL _done;			 ///< Set when the thread function returned
+	bool _running = false;		 ///< Flag if the task was started
+#else
+	std::thread _thread; ///< Standard thread
+#endif
+};
+#endif
+#endif
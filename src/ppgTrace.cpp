@@ -0,0 +1,201 @@
+/**
+ * @file ppgTrace.cpp
+ * @brief Low overhead latency trace of the sample path
+ *
+ * @author   Bernd Giesecke
+ */
+#include "ppgTrace.h"
+
+#if PPG_TRACE_ENABLED
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#if (PPG_TRACE_SIZE & (PPG_TRACE_SIZE - 1)) != 0
+#error "PPG_TRACE_SIZE must be a power of 2"
+#endif
+
+PPG_TRACE_ENTRY PPG_TRACER::_ring[PPG_TRACE_SIZE];
+#ifdef PPG_HAS_THREADS
+std::atomic<uint32_t> PPG_TRACER::_head(0);
+std::atomic<uint16_t> PPG_TRACER::_id(0);
+std::atomic<bool> PPG_TRACER::_paused(false);
+thread_local uint16_t PPG_TRACER::_adopted = 0;
+#else
+volatile uint32_t PPG_TRACER::_head = 0;
+volatile uint16_t PPG_TRACER::_id = 0;
+volatile bool PPG_TRACER::_paused = false;
+volatile uint16_t PPG_TRACER::_adopted = 0;
+#endif
+
+/**
+ * Reserve a slot in the ring buffer
+ * Safe against interrupts and other tasks, without threads the
+ * interrupts are disabled for the few instructions of the update.
+ * @param id
+ * 		Trace id for the entry
+ * @param newId
+ * 		Flag if a new trace id is started, 0 is skipped as it means no adopted id
+ * @return number of the entry
+ */
+uint32_t IRAM_ATTR PPG_TRACER::claim(uint16_t *id, bool newId)
+{
+#ifdef PPG_HAS_THREADS
+	if (newId)
+	{
+		*id = (uint16_t)(_id.fetch_add(1, std::memory_order_relaxed) + 1);
+		if (*id == 0)
+		{
+			*id = (uint16_t)(_id.fetch_add(1, std::memory_order_relaxed) + 1);
+		}
+	}
+	else
+	{
+		*id = (_adopted != 0) ? _adopted : _id.load(std::memory_order_relaxed);
+	}
+	return _head.fetch_add(1, std::memory_order_relaxed);
+#else
+#if defined(__AVR__)
+	uint8_t sreg = SREG;
+	noInterrupts();
+#elif defined(ESP8266)
+	uint32_t savedPS = xt_rsil(15);
+#elif defined(__arm__)
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+#else
+	noInterrupts();
+#endif
+	if (newId)
+	{
+		_id = _id + 1;
+		if (_id == 0)
+		{
+			_id = 1;
+		}
+	}
+	*id = (!newId && (_adopted != 0)) ? _adopted : _id;
+	uint32_t entry = _head;
+	_head = entry + 1;
+#if defined(__AVR__)
+	SREG = sreg;
+#elif defined(ESP8266)
+	xt_wsr_ps(savedPS);
+#elif defined(__arm__)
+	if (primask == 0)
+	{
+		__enable_irq();
+	}
+#else
+	interrupts();
+#endif
+	return entry;
+#endif
+}
+
+uint16_t IRAM_ATTR PPG_TRACER::start(uint8_t point)
+{
+	if (_paused)
+	{
+		return 0;
+	}
+	uint16_t id;
+	uint32_t entry = claim(&id, true);
+	PPG_TRACE_ENTRY *slot = &_ring[entry & (PPG_TRACE_SIZE - 1)];
+	slot->time = micros();
+	slot->id = id;
+	slot->point = point;
+	slot->arg = 0;
+	return id;
+}
+
+void IRAM_ATTR PPG_TRACER::record(uint8_t point, uint8_t arg)
+{
+	if (_paused)
+	{
+		return;
+	}
+	uint16_t id;
+	uint32_t entry = claim(&id, false);
+	PPG_TRACE_ENTRY *slot = &_ring[entry & (PPG_TRACE_SIZE - 1)];
+	slot->time = micros();
+	slot->id = id;
+	slot->point = point;
+	slot->arg = arg;
+}
+
+void PPG_TRACER::adopt(uint16_t id)
+{
+	_adopted = id;
+}
+
+uint16_t PPG_TRACER::read(PPG_TRACE_ENTRY *entries, uint16_t maxEntries)
+{
+	_paused = true;
+	uint32_t head = _head;
+	uint32_t count = (head < PPG_TRACE_SIZE) ? head : PPG_TRACE_SIZE;
+	if (count > maxEntries)
+	{
+		count = maxEntries;
+	}
+	for (uint32_t idx = 0; idx < count; idx++)
+	{
+		entries[idx] = _ring[(head - count + idx) & (PPG_TRACE_SIZE - 1)];
+	}
+	_paused = false;
+	return (uint16_t)count;
+}
+
+#ifdef ARDUINO
+void PPG_TRACER::dump(Print &out)
+#else
+void PPG_TRACER::dump(FILE *out)
+#endif
+{
+	_paused = true;
+	uint32_t head = _head;
+	uint32_t count = (head < PPG_TRACE_SIZE) ? head : PPG_TRACE_SIZE;
+#ifdef ARDUINO
+	out.print(F("PPG_TRACE,"));
+	out.print(head);
+	out.print(',');
+	out.println(PPG_TRACE_SIZE);
+	for (uint32_t idx = head - count; idx != head; idx++)
+	{
+		const PPG_TRACE_ENTRY &entry = _ring[idx & (PPG_TRACE_SIZE - 1)];
+		out.print(F("T,"));
+		out.print(entry.time);
+		out.print(',');
+		out.print(entry.id);
+		out.print(',');
+		out.print(entry.point);
+		out.print(',');
+		out.println(entry.arg);
+	}
+	out.println(F("PPG_TRACE_END"));
+#else
+	fprintf(out, "PPG_TRACE,%lu,%d\n", (unsigned long)head, PPG_TRACE_SIZE);
+	for (uint32_t idx = head - count; idx != head; idx++)
+	{
+		const PPG_TRACE_ENTRY &entry = _ring[idx & (PPG_TRACE_SIZE - 1)];
+		fprintf(out, "T,%lu,%u,%u,%u\n", (unsigned long)entry.time, entry.id, entry.point, entry.arg);
+	}
+	fprintf(out, "PPG_TRACE_END\n");
+#endif
+	_paused = false;
+}
+
+void PPG_TRACER::clear(void)
+{
+	_paused = true;
+	_head = 0;
+	_id = 0;
+	_paused = false;
+}
+
+uint32_t PPG_TRACER::getRecorded(void)
+{
+	return _head;
+}
+#endif
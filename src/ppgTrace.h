@@ -0,0 +1,166 @@
+/**
+ * @file ppgTrace.h
+ * @brief Low overhead latency trace of the sample path
+ *
+ * @author   Bernd Giesecke
+ *
+ * Trace points write a timestamp into a fixed ring buffer, from the sensor
+ * interrupt to the consumer of the result:
+ * - PPG_TRACE_ISR        sensor interrupt, starts a new trace id
+ * - PPG_TRACE_I2C_START  register read started
+ * - PPG_TRACE_I2C_END    register read finished
+ * - PPG_TRACE_FILTER     filter output of the beat detection
+ * - PPG_TRACE_BEAT       beat detected
+ * - PPG_TRACE_CONSUMER   event handler, batch consumer or pipeline result callback called
+ *
+ * All points after an interrupt carry the id of that interrupt. A task that
+ * processes samples of an earlier interrupt, e.g. the processing task of
+ * PPG_PIPELINE, adopts the id stored with the sample instead. The trace is
+ * compiled in only with PPG_TRACE_ENABLED set to 1 (e.g. build flag
+ * -DPPG_TRACE_ENABLED=1), otherwise the trace macros are empty.
+ * The dump is converted to Chrome/Perfetto trace JSON with latency
+ * percentiles by extras/tools/ppg_trace.
+ */
+#ifndef PPG_TRACE_H
+#define PPG_TRACE_H
+
+#include "ppgThread.h"
+
+#ifdef PPG_HAS_THREADS
+#include <atomic>
+#endif
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+#ifndef PPG_TRACE_ENABLED
+#define PPG_TRACE_ENABLED 0
+#endif
+
+/** Number of entries in the ring buffer, must be a power of 2 */
+#ifndef PPG_TRACE_SIZE
+#ifdef __AVR__
+#define PPG_TRACE_SIZE 64
+#else
+#define PPG_TRACE_SIZE 512
+#endif
+#endif
+
+#define PPG_TRACE_ISR 0		  ///< Sensor interrupt
+#define PPG_TRACE_I2C_START 1 ///< Register read started, arg is the register
+#define PPG_TRACE_I2C_END 2	  ///< Register read finished, arg is the register
+#define PPG_TRACE_FILTER 3	  ///< Filter output of the beat detection
+#define PPG_TRACE_BEAT 4	  ///< Beat detected
+#define PPG_TRACE_CONSUMER 5  ///< Result handed to the application
+#define PPG_TRACE_USER 8	  ///< First trace point for the application
+
+#if PPG_TRACE_ENABLED
+/** Start a new trace id and record a trace point, e.g. in an interrupt */
+#define PPG_TRACE_START(point) PPG_TRACER::start(point)
+/** Record a trace point with the current trace id */
+#define PPG_TRACE_POINT(point, arg) PPG_TRACER::record(point, arg)
+/** Start a new trace id, record a trace point and return the id, e.g. to store it with the samples */
+#define PPG_TRACE_START_ID(point) PPG_TRACER::start(point)
+/** Record the following points of this task with the given trace id, 0 for the current trace id */
+#define PPG_TRACE_ADOPT(id) PPG_TRACER::adopt(id)
+#else
+#define PPG_TRACE_START(point) ((void)0)
+#define PPG_TRACE_POINT(point, arg) ((void)0)
+#define PPG_TRACE_START_ID(point) ((uint16_t)0)
+#define PPG_TRACE_ADOPT(id) ((void)0)
+#endif
+
+/**
+ * Trace entry
+ */
+struct PPG_TRACE_ENTRY
+{
+	uint32_t time; ///< Timestamp in microseconds
+	uint16_t id;   ///< Trace id, set by the last PPG_TRACE_START
+	uint8_t point; ///< Trace point
+	uint8_t arg;   ///< Point specific value
+};
+
+#if PPG_TRACE_ENABLED
+/**
+ * Trace ring buffer
+ * Recording can be called from interrupts and from several tasks. The oldest
+ * entries are overwritten when the ring is full.
+ */
+class PPG_TRACER
+{
+public:
+	/**
+	 * Start a new trace id and record a trace point
+	 * @param point
+	 * 		Trace point
+	 * @return new trace id, never 0
+	 */
+	static uint16_t start(uint8_t point);
+	/**
+	 * Record a trace point with the current trace id
+	 * @param point
+	 * 		Trace point
+	 * @param arg
+	 * 		Point specific value
+	 */
+	static void record(uint8_t point, uint8_t arg);
+	/**
+	 * Record the following points of the calling task with a trace id
+	 * With threads the id is kept per thread, interrupts and other tasks
+	 * still use the current trace id.
+	 * @param id
+	 * 		Trace id returned by start(), 0 to use the current trace id again
+	 */
+	static void adopt(uint16_t id);
+	/**
+	 * Copy the recorded entries, oldest first
+	 * Recording is paused while the entries are copied.
+	 * @param entries
+	 * 		Buffer for the entries
+	 * @param maxEntries
+	 * 		Size of the buffer
+	 * @return number of entries copied
+	 */
+	static uint16_t read(PPG_TRACE_ENTRY *entries, uint16_t maxEntries);
+	/**
+	 * Write the recorded entries as text, oldest first
+	 * Recording is paused while the entries are written.
+	 * Format: "PPG_TRACE,<recorded>,<size>", one "T,<time>,<id>,<point>,<arg>"
+	 * line per entry and "PPG_TRACE_END"
+	 * @param out
+	 * 		Output, e.g. Serial
+	 */
+#ifdef ARDUINO
+	static void dump(Print &out);
+#else
+	static void dump(FILE *out);
+#endif
+	/**
+	 * Clear the ring buffer
+	 */
+	static void clear(void);
+	/**
+	 * Get number of entries recorded since the last clear
+	 * @return number of entries, entries beyond PPG_TRACE_SIZE were overwritten
+	 */
+	static uint32_t getRecorded(void);
+
+private:
+	static uint32_t claim(uint16_t *id, bool newId);
+
+	static PPG_TRACE_ENTRY _ring[PPG_TRACE_SIZE]; ///< Ring buffer
+#ifdef PPG_HAS_THREADS
+	static std::atomic<uint32_t> _head; ///< Number of entries recorded
+	static std::atomic<uint16_t> _id;	///< Current trace id
+	static std::atomic<bool> _paused;	///< Flag if recording is paused
+	static thread_local uint16_t _adopted; ///< Trace id adopted by this thread, 0 for none
+#else
+	static volatile uint32_t _head; ///< Number of entries recorded
+	static volatile uint16_t _id;	///< Current trace id
+	static volatile bool _paused;	///< Flag if recording is paused
+	static volatile uint16_t _adopted; ///< Trace id adopted by the main loop, 0 for none
+#endif
+};
+#endif
+#endif
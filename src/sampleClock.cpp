@@ -0,0 +1,128 @@
+/**
+ * @file sampleClock.cpp
+ * @brief Sample clock recovery for the bio sensor data ready events
+ *
+ * @author   Bernd Giesecke
+ */
+
+#include "sampleClock.h"
+
+/** Nominal sample periods of BIO_SENS_RATE_1_95 to BIO_SENS_RATE_250 in microseconds */
+static const uint32_t bioPeriods[8] = {512000, 256000, 128000, 60150, 32000, 16000, 8000, 4000};
+
+SAMPLE_CLOCK::SAMPLE_CLOCK(void)
+{
+}
+
+uint32_t SAMPLE_CLOCK::bioRatePeriod(uint8_t dataRate)
+{
+	if (dataRate > 7)
+	{
+		dataRate = 7;
+	}
+	return bioPeriods[dataRate];
+}
+
+void SAMPLE_CLOCK::begin(uint32_t nominalPeriodUs)
+{
+	_nominalQ8 = nominalPeriodUs << 8;
+	_periodQ8 = _nominalQ8;
+	_phase = 0;
+	_phaseFrac = 0;
+	_index = 0;
+	_missed = 0;
+	_lastMissed = 0;
+	_started = false;
+}
+
+uint32_t SAMPLE_CLOCK::addArrival(uint32_t arrivalUs)
+{
+	if (_periodQ8 == 0)
+	{
+		// begin() not called or without period, no clock to recover
+		return arrivalUs;
+	}
+	if (!_started)
+	{
+		_started = true;
+		_phase = arrivalUs;
+		_phaseFrac = 0;
+		return _phase;
+	}
+
+	// Number of sample periods since the last sample, rounded
+	uint32_t gap = arrivalUs - _phase;
+	uint32_t periods = (uint32_t)((((uint64_t)gap << 8) + (_periodQ8 >> 1)) / _periodQ8);
+	if (periods == 0)
+	{
+		// Early arrival (interrupt latency of the previous sample), still one sample
+		periods = 1;
+	}
+	_lastMissed = (periods > 0xFFFF) ? 0xFFFF : (uint16_t)(periods - 1);
+	_missed += periods - 1;
+	_index += periods;
+
+	// Predicted timestamp and timing error in 1/256 us
+	int64_t predictedQ8 = (int64_t)_phaseFrac + (int64_t)periods * _periodQ8;
+	int32_t predicted = (int32_t)(predictedQ8 >> 8);
+	_phase += predicted;
+	_phaseFrac = (int32_t)(predictedQ8 - ((int64_t)predicted << 8));
+	int32_t errQ8 = (int32_t)(arrivalUs - _phase) * 256 - _phaseFrac;
+
+	// Loop filter, phase and period correction
+	int32_t phaseCorr = errQ8 >> SAMPLE_CLOCK_KP_SHIFT;
+	_phaseFrac += phaseCorr;
+	_phase += _phaseFrac >> 8;
+	_phaseFrac &= 0xFF;
+
+	int32_t periodCorr = (errQ8 >> SAMPLE_CLOCK_KI_SHIFT) / (int32_t)periods;
+	_periodQ8 += periodCorr;
+	uint32_t limit = _nominalQ8 >> SAMPLE_CLOCK_LIMIT_SHIFT;
+	if (_periodQ8 > (_nominalQ8 + limit))
+	{
+		_periodQ8 = _nominalQ8 + limit;
+	}
+	if (_periodQ8 < (_nominalQ8 - limit))
+	{
+		_periodQ8 = _nominalQ8 - limit;
+	}
+	return _phase;
+}
+
+uint32_t SAMPLE_CLOCK::getPeriodQ8(void)
+{
+	return _periodQ8;
+}
+
+float SAMPLE_CLOCK::getRate(void)
+{
+	if (_periodQ8 == 0)
+	{
+		return 0.0;
+	}
+	return 256000000.0 / _periodQ8;
+}
+
+int32_t SAMPLE_CLOCK::getDriftPpm(void)
+{
+	if (_nominalQ8 == 0)
+	{
+		return 0;
+	}
+	return (int32_t)(((int64_t)_periodQ8 - (int64_t)_nominalQ8) * 1000000 / (int64_t)_nominalQ8);
+}
+
+uint32_t SAMPLE_CLOCK::getSampleIndex(void)
+{
+	return _index;
+}
+
+uint32_t SAMPLE_CLOCK::getMissed(void)
+{
+	return _missed;
+}
+
+uint16_t SAMPLE_CLOCK::getLastMissed(void)
+{
+	return _lastMissed;
+}
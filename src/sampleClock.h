@@ -0,0 +1,97 @@
+/**
+ * @file sampleClock.h
+ * @brief Sample clock recovery for the bio sensor data ready events
+ *
+ * @author   Bernd Giesecke
+ *
+ * The bio sensor data rates are derived from the internal oscillator of the
+ * VCNL4020C, which drifts against the MCU clock. SAMPLE_CLOCK tracks the
+ * arrival times of the data ready events with a second order PLL, estimates
+ * the true sample period and gives every sample a drift corrected timestamp.
+ * Arrival gaps of more than 1.5 periods are counted as missed samples.
+ */
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include "ppgPlatform.h"
+
+/** Phase correction gain of the PLL, 1/2^n of the timing error */
+#define SAMPLE_CLOCK_KP_SHIFT 3
+/** Period correction gain of the PLL, 1/2^n of the timing error */
+#define SAMPLE_CLOCK_KI_SHIFT 8
+/** Maximum deviation of the period from the nominal period in 1/2^n */
+#define SAMPLE_CLOCK_LIMIT_SHIFT 4
+
+/**
+ * Sample clock recovery
+ */
+class SAMPLE_CLOCK
+{
+public:
+	SAMPLE_CLOCK(void);
+
+	/**
+	 * Get nominal sample period of a bio sensor data rate
+	 * @param dataRate
+	 * 		BIO_SENS_RATE_1_95 to BIO_SENS_RATE_250
+	 * @return nominal sample period in microseconds
+	 */
+	static uint32_t bioRatePeriod(uint8_t dataRate);
+
+	/**
+	 * Start the clock recovery
+	 * @param nominalPeriodUs
+	 * 		Nominal sample period in microseconds, e.g. bioRatePeriod(BIO_SENS_RATE_125)
+	 */
+	void begin(uint32_t nominalPeriodUs);
+	/**
+	 * Add a data ready event
+	 * @param arrivalUs
+	 * 		MCU time of the event in microseconds, e.g. micros() in the interrupt routine
+	 * @return drift corrected timestamp of the sample in microseconds,
+	 * 		arrivalUs unchanged if begin() was not called with a sample period
+	 */
+	uint32_t addArrival(uint32_t arrivalUs);
+
+	/**
+	 * Get estimated sample period
+	 * @return sample period in 1/256 microseconds
+	 */
+	uint32_t getPeriodQ8(void);
+	/**
+	 * Get estimated sample rate
+	 * @return sample rate in samples/s
+	 */
+	float getRate(void);
+	/**
+	 * Get drift of the sensor oscillator against the MCU clock
+	 * @return drift in ppm, positive if the sensor is slower than nominal
+	 */
+	int32_t getDriftPpm(void);
+	/**
+	 * Get index of the last sample, including missed samples
+	 * @return sample index
+	 */
+	uint32_t getSampleIndex(void);
+	/**
+	 * Get number of missed samples since begin()
+	 * @return number of missed samples
+	 */
+	uint32_t getMissed(void);
+	/**
+	 * Get number of samples missed before the last arrival
+	 * @return number of missed samples, 0 if the last sample followed without gap
+	 */
+	uint16_t getLastMissed(void);
+
+private:
+	uint32_t _nominalQ8 = 0; ///< Nominal period in 1/256 us
+	uint32_t _periodQ8 = 0;	 ///< Estimated period in 1/256 us
+	uint32_t _phase = 0;	 ///< Timestamp of the last sample in us
+	int32_t _phaseFrac = 0;	 ///< Fraction of the timestamp in 1/256 us
+	uint32_t _index = 0;	 ///< Sample index
+	uint32_t _missed = 0;	 ///< Missed samples
+	uint16_t _lastMissed = 0; ///< Missed samples before the last arrival
+	bool _started = false;	 ///< Flag if the first arrival was seen
+};
+#endif
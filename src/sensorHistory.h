@@ -0,0 +1,318 @@
+/**
+ * @file sensorHistory.h
+ * @brief Fixed memory history of sensor values with second, minute and hour rollups
+ *
+ * @author   Bernd Giesecke
+ *
+ * Keeps hours of heart rate or ambient light history in a few hundred bytes.
+ * Every value updates the min/max/sum/count of the current second, minute and
+ * hour bucket, raw values are not stored. Each resolution is a ring of buckets,
+ * old buckets are overwritten. Range queries add up buckets of the finest
+ * resolution that still covers the range, the cost depends on the number of
+ * buckets, not on the number of values.
+ */
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include "ppgPlatform.h"
+
+/** Resolution index of the per second buckets */
+#define HISTORY_SECONDS 0
+/** Resolution index of the per minute buckets */
+#define HISTORY_MINUTES 1
+/** Resolution index of the per hour buckets */
+#define HISTORY_HOURS 2
+
+/** Most values a bucket adds up, the sum of 0xFFFF values of 0xFFFF fits in 32 bit */
+#define HISTORY_BUCKET_MAX_COUNT 0xFFFF
+
+/**
+ * Values of one bucket as stored in the history
+ */
+struct HISTORY_BUCKET
+{
+	uint16_t min;	///< Smallest value
+	uint16_t max;	///< Largest value
+	uint32_t sum;	///< Sum of the counted values
+	uint16_t count; ///< Number of counted values, 0 if the bucket is empty
+};
+
+/**
+ * Aggregate of the values in a bucket or a time range
+ * Wide enough for all buckets of a history, e.g. 24 full hours of 1 Hz values
+ */
+struct HISTORY_STATS
+{
+	uint16_t min;	///< Smallest value
+	uint16_t max;	///< Largest value
+	uint32_t count; ///< Number of values, 0 if the range is empty
+	uint64_t sum;	///< Sum of all values
+
+	/**
+	 * Get the mean of the values
+	 * @return mean, 0 if there are no values
+	 */
+	uint16_t getMean(void) const
+	{
+		return (count == 0) ? 0 : (uint16_t)((sum + count / 2) / count);
+	}
+};
+
+/**
+ * Sensor value history
+ * Memory use is 12 bytes per bucket, (SECONDS + MINUTES + HOURS) buckets.
+ * A bucket counts up to HISTORY_BUCKET_MAX_COUNT values, e.g. an hour of 18 Hz values,
+ * further values only update min and max so the mean stays the mean of the counted values.
+ * @tparam SECONDS
+ * 		Number of per second buckets
+ * @tparam MINUTES
+ * 		Number of per minute buckets
+ * @tparam HOURS
+ * 		Number of per hour buckets
+ */
+template <uint16_t SECONDS, uint16_t MINUTES, uint16_t HOURS>
+class SENSOR_HISTORY_T
+{
+public:
+	SENSOR_HISTORY_T(void)
+	{
+		clear();
+	}
+
+	/**
+	 * Remove all values
+	 */
+	void clear(void)
+	{
+		for (uint8_t level = 0; level < 3; level++)
+		{
+			_started[level] = false;
+			_current[level] = 0;
+			for (uint16_t idx = 0; idx < size(level); idx++)
+			{
+				emptyBucket(&bucket(level)[idx]);
+			}
+		}
+	}
+
+	/**
+	 * Add a value
+	 * @param timeSec
+	 * 		Time of the value in seconds, e.g. millis() / 1000 or RTC time
+	 * @param value
+	 * 		Value, e.g. HEART_RATE::getSmoothedHR() or VCNL4020C::getAlsValue()
+	 * @return result
+	 * 		FALSE if the value is older than the history of all resolutions
+	 */
+	bool add(uint32_t timeSec, uint16_t value)
+	{
+		bool stored = false;
+		for (uint8_t level = 0; level < 3; level++)
+		{
+			uint32_t index = timeSec / period(level);
+			if (!advance(level, index))
+			{
+				continue;
+			}
+			HISTORY_BUCKET *entry = &bucket(level)[index % size(level)];
+			if ((entry->count == 0) || (value < entry->min))
+			{
+				entry->min = value;
+			}
+			if ((entry->count == 0) || (value > entry->max))
+			{
+				entry->max = value;
+			}
+			if (entry->count < HISTORY_BUCKET_MAX_COUNT)
+			{
+				entry->sum += value;
+				entry->count++;
+			}
+			stored = true;
+		}
+		return stored;
+	}
+
+	/**
+	 * Get the aggregate of a time range
+	 * The finest resolution that still holds the start of the range is used,
+	 * the range is extended to the bucket limits of that resolution.
+	 * @param fromSec
+	 * 		Start of the range in seconds
+	 * @param toSec
+	 * 		End of the range in seconds (included)
+	 * @param result
+	 * 		Pointer to the aggregate to fill
+	 * @return used resolution, HISTORY_SECONDS, HISTORY_MINUTES or HISTORY_HOURS
+	 */
+	uint8_t query(uint32_t fromSec, uint32_t toSec, HISTORY_STATS *result)
+	{
+		result->min = 0;
+		result->max = 0;
+		result->count = 0;
+		result->sum = 0;
+		uint8_t level = 0;
+		while ((level < 2) && !holds(level, fromSec / period(level)))
+		{
+			level++;
+		}
+		if (!_started[level])
+		{
+			return level;
+		}
+		uint32_t first = fromSec / period(level);
+		uint32_t last = toSec / period(level);
+		uint32_t oldest = oldestIndex(level);
+		if (first < oldest)
+		{
+			first = oldest;
+		}
+		if (last > _current[level])
+		{
+			last = _current[level];
+		}
+		for (uint32_t index = first; (index <= last) && (last >= first); index++)
+		{
+			merge(result, &bucket(level)[index % size(level)]);
+		}
+		return level;
+	}
+
+	/**
+	 * Get the newest buckets of one resolution, e.g. for a chart
+	 * @param level
+	 * 		HISTORY_SECONDS, HISTORY_MINUTES or HISTORY_HOURS
+	 * @param buckets
+	 * 		Array to fill, oldest bucket first. Buckets without values have count 0
+	 * @param maxBuckets
+	 * 		Size of the array
+	 * @return number of buckets written
+	 */
+	uint16_t getSeries(uint8_t level, HISTORY_STATS *buckets, uint16_t maxBuckets)
+	{
+		if ((level > 2) || !_started[level])
+		{
+			return 0;
+		}
+		uint32_t oldest = oldestIndex(level);
+		uint32_t available = _current[level] - oldest + 1;
+		uint16_t count = (available < maxBuckets) ? (uint16_t)available : maxBuckets;
+		uint32_t index = _current[level] + 1 - count;
+		for (uint16_t idx = 0; idx < count; idx++, index++)
+		{
+			const HISTORY_BUCKET *entry = &bucket(level)[index % size(level)];
+			buckets[idx].min = entry->min;
+			buckets[idx].max = entry->max;
+			buckets[idx].count = entry->count;
+			buckets[idx].sum = entry->sum;
+		}
+		return count;
+	}
+
+	/**
+	 * Get the length of the history of one resolution
+	 * @param level
+	 * 		HISTORY_SECONDS, HISTORY_MINUTES or HISTORY_HOURS
+	 * @return covered time in seconds
+	 */
+	uint32_t getSpan(uint8_t level)
+	{
+		return (level > 2) ? 0 : (uint32_t)size(level) * period(level);
+	}
+
+private:
+	static uint32_t period(uint8_t level)
+	{
+		return (level == HISTORY_SECONDS) ? 1 : ((level == HISTORY_MINUTES) ? 60 : 3600);
+	}
+
+	static uint16_t size(uint8_t level)
+	{
+		return (level == HISTORY_SECONDS) ? SECONDS : ((level == HISTORY_MINUTES) ? MINUTES : HOURS);
+	}
+
+	HISTORY_BUCKET *bucket(uint8_t level)
+	{
+		return (level == HISTORY_SECONDS) ? _seconds : ((level == HISTORY_MINUTES) ? _minutes : _hours);
+	}
+
+	static void emptyBucket(HISTORY_BUCKET *entry)
+	{
+		entry->min = 0;
+		entry->max = 0;
+		entry->sum = 0;
+		entry->count = 0;
+	}
+
+	static void merge(HISTORY_STATS *result, const HISTORY_BUCKET *entry)
+	{
+		if (entry->count == 0)
+		{
+			return;
+		}
+		if ((result->count == 0) || (entry->min < result->min))
+		{
+			result->min = entry->min;
+		}
+		if ((result->count == 0) || (entry->max > result->max))
+		{
+			result->max = entry->max;
+		}
+		result->sum += entry->sum;
+		result->count += entry->count;
+	}
+
+	uint32_t oldestIndex(uint8_t level)
+	{
+		return (_current[level] >= (uint32_t)(size(level) - 1)) ? _current[level] - (size(level) - 1) : 0;
+	}
+
+	bool holds(uint8_t level, uint32_t index)
+	{
+		return _started[level] && (index >= oldestIndex(level));
+	}
+
+	/**
+	 * Move the newest bucket of a resolution forward, clearing the skipped buckets
+	 * @return FALSE if index is older than the ring
+	 */
+	bool advance(uint8_t level, uint32_t index)
+	{
+		if (size(level) == 0)
+		{
+			return false;
+		}
+		if (!_started[level])
+		{
+			_started[level] = true;
+			_current[level] = index;
+			emptyBucket(&bucket(level)[index % size(level)]);
+			return true;
+		}
+		if (index <= _current[level])
+		{
+			return index >= oldestIndex(level);
+		}
+		uint32_t skipped = index - _current[level];
+		if (skipped > size(level))
+		{
+			skipped = size(level);
+		}
+		for (uint32_t step = 0; step < skipped; step++)
+		{
+			emptyBucket(&bucket(level)[(index - step) % size(level)]);
+		}
+		_current[level] = index;
+		return true;
+	}
+
+	HISTORY_BUCKET _seconds[SECONDS > 0 ? SECONDS : 1]; ///< Per second buckets
+	HISTORY_BUCKET _minutes[MINUTES > 0 ? MINUTES : 1]; ///< Per minute buckets
+	HISTORY_BUCKET _hours[HOURS > 0 ? HOURS : 1];		  ///< Per hour buckets
+	uint32_t _current[3];								 ///< Index of the newest bucket of each resolution
+	bool _started[3];									 ///< Flag if a resolution has values
+};
+
+/** One minute of seconds, one hour of minutes, one day of hours (about 1.7 kByte) */
+typedef SENSOR_HISTORY_T<60, 60, 24> SENSOR_HISTORY;
+#endif
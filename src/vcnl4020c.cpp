@@ -14,6 +14,36 @@
 
 #include "vcnl4020c.h"
 
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#if VCNL4020C_USE_INTERRUPTS
+#if VCNL4020C_MAX_INSTANCES != 4
+#error "VCNL4020C has one interrupt trampoline per instance, adjust isr0..isr3 to VCNL4020C_MAX_INSTANCES"
+#endif
+
+VCNL4020C *VCNL4020C::_instances[VCNL4020C_MAX_INSTANCES] = {NULL};
+#endif
+
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(addr) (*(const void *const *)(addr))
+#endif
+
+/** Bio sensor data rates as text, strings and table in flash */
+static const char bioRate0[] PROGMEM = "1.95";
+static const char bioRate1[] PROGMEM = "3.90625";
+static const char bioRate2[] PROGMEM = "7.8125";
+static const char bioRate3[] PROGMEM = "16.625";
+static const char bioRate4[] PROGMEM = "31.25";
+static const char bioRate5[] PROGMEM = "62.5";
+static const char bioRate6[] PROGMEM = "125";
+static const char bioRate7[] PROGMEM = "250";
+/** Bio sensor data rate names, indexed by BIO_SENS_RATE_xxx */
+static const char *const bioRateNames[8] PROGMEM = {bioRate0, bioRate1, bioRate2, bioRate3, bioRate4, bioRate5, bioRate6, bioRate7};
+/** Ambient light data rates in samples/s, indexed by AMB_SENS_RATE_xxx >> 4 */
+static const uint8_t alsRates[8] PROGMEM = {1, 2, 3, 4, 5, 6, 8, 10};
+
 VCNL4020C::VCNL4020C(TwoWire *i2c, int addr)
 {
 	_i2c = i2c;
@@ -22,16 +52,33 @@ VCNL4020C::VCNL4020C(TwoWire *i2c, int addr)
 
 VCNL4020C::~VCNL4020C()
 {
+#if VCNL4020C_USE_INTERRUPTS
+	if (_eventSlot != -1)
+	{
+		if (_intPin != -1)
+		{
+			detachInterrupt(digitalPinToInterrupt(_intPin));
+		}
+		_instances[_eventSlot] = NULL;
+	}
+#endif
+	stopBatch();
 }
 
 bool VCNL4020C::initSensorDefault(void)
 {
+	uint32_t startTime = micros();
+	uint32_t phaseTime = startTime;
 	uint8_t checkID = 0;
 	uint8_t checkRev = 0;
+
+	memset(&_initTiming, 0, sizeof(VCNL4020C_INIT_TIMING));
+
 	// Initialize I2C
-	_i2c->begin();
-	// Set I2C to 800 kHz
-	_i2c->setClock(800000);
+	initBus();
+	_initTiming.bus = micros() - phaseTime;
+	phaseTime = micros();
+
 	// Read device ID and revision ID
 	if (!getIds(&checkID, &checkRev))
 	{
@@ -41,17 +88,23 @@ bool VCNL4020C::initSensorDefault(void)
 	if ((checkID != 2) && (checkRev != 1))
 	{
 #ifdef NRF52_SERIES
-		_i2c->end();
+		if (_initOptions.initBus)
+		{
+			_i2c->end();
+		}
 #endif
 		return false;
 	}
+	_initTiming.idCheck = micros() - phaseTime;
+	phaseTime = micros();
+
 	// Set default values
-	regValue = 0;
-	if (!writeRegs(CMD_REG, &regValue, 1))
+	if (!resetSensor())
 	{
 		return false;
 	}
-	delay(10);
+	_initTiming.reset = micros() - phaseTime;
+	phaseTime = micros();
 
 	if (!setBioDataRate(BIO_SENS_RATE_125))
 	{
@@ -61,14 +114,17 @@ bool VCNL4020C::initSensorDefault(void)
 	{
 		return false;
 	}
+#if VCNL4020C_USE_ALS
 	if (!setAlsParam(AMB_SENS_RATE_10, AVG_CONV_1, false))
 	{
 		return false;
 	}
+#endif
 	if (!setIntControl(false, false, false, 0, INT_CNT_EXC_1))
 	{
 		return false;
 	}
+#if VCNL4020C_USE_THRESHOLDS
 	if (!setThresholdLow(0))
 	{
 		return false;
@@ -77,10 +133,13 @@ bool VCNL4020C::initSensorDefault(void)
 	{
 		return false;
 	}
+#endif
 	if (!setBioSensMod(BIO_SETTINGS_VISHAY))
 	{
 		return false;
 	}
+	_initTiming.registers = micros() - phaseTime;
+	_initTiming.total = micros() - startTime;
 	return true;
 }
 
@@ -89,6 +148,7 @@ bool VCNL4020C::getCmdReg(uint8_t *cmdVal)
 	return readRegs(CMD_REG, cmdVal, 1);
 }
 
+#if VCNL4020C_USE_ALS
 bool VCNL4020C::alsDataReady(void)
 {
 	if (readRegs(CMD_REG, &regValue, 1))
@@ -100,6 +160,7 @@ bool VCNL4020C::alsDataReady(void)
 	}
 	return false;
 }
+#endif
 
 bool VCNL4020C::bioDataReady(void)
 {
@@ -119,27 +180,12 @@ bool VCNL4020C::startSingle(bool bio, bool als)
 	regValue = 0;
 
 	// Check if interrupt callback function is set and interrupt GPIO is defined
-	if ((_sensorInt != NULL) && (_intPin != -1))
+	if (interruptConfigured())
 	{
-		pinMode(_intPin, INPUT_PULLUP);
-		attachInterrupt(_intPin, _sensorInt, FALLING);
+		attachIsr();
 
 		// Enable the interrupts
-		if (bio)
-		{
-			regValue |= INT_BS_RDY_ENA;
-			_intMeasurementBio = true;
-		}
-		if (als)
-		{
-			regValue |= INT_ALS_RDY_ENA;
-			_intMeasurementALS = true;
-		}
-		if ((_lowThresh != 0) && (_highThresh != 0))
-		{
-			regValue |= INT_THRES_ENA;
-			_intThreshold = true;
-		}
+		regValue = intControlBits(bio, als);
 
 		// Start single measurement
 		return writeRegs(INT_CONTR, &regValue, 1);
@@ -168,27 +214,12 @@ bool VCNL4020C::startContinuous(bool bio, bool als)
 	regValue = 0;
 
 	// Check if interrupt callback function is set and interrupt GPIO is defined
-	if ((_sensorInt != NULL) && (_intPin != -1))
+	if (interruptConfigured())
 	{
-		pinMode(_intPin, INPUT_PULLUP);
-		attachInterrupt(_intPin, _sensorInt, FALLING);
+		attachIsr();
 
 		// Enable the interrupts
-		if (bio)
-		{
-			regValue |= INT_BS_RDY_ENA;
-			_intMeasurementBio = true;
-		}
-		if (als)
-		{
-			regValue |= INT_ALS_RDY_ENA;
-			_intMeasurementALS = true;
-		}
-		if ((_lowThresh != 0) && (_highThresh != 0))
-		{
-			regValue |= INT_THRES_ENA;
-			_intThreshold = true;
-		}
+		regValue = intControlBits(bio, als);
 		if (!writeRegs(INT_CONTR, &regValue, 1))
 		{
 			return false;
@@ -202,6 +233,12 @@ bool VCNL4020C::startContinuous(bool bio, bool als)
 	{
 		regValue |= PER_BIO_MEAS_EN;
 	}
+#if VCNL4020C_USE_ALS_EVENTS
+	if (_alsEvents)
+	{
+		als = true;
+	}
+#endif
 	if (als)
 	{
 		regValue |= PER_ALS_MEAS_EN;
@@ -218,18 +255,27 @@ bool VCNL4020C::stopContinuous(void)
 	regValue = 0;
 
 	// Check if interrupt callback function is set and interrupt GPIO is defined
-	if ((_sensorInt != NULL) && (_intPin != -1))
+#if VCNL4020C_USE_INTERRUPTS
+	if (interruptConfigured())
 	{
-		detachInterrupt(_intPin);
+		detachInterrupt(digitalPinToInterrupt(_intPin));
 		if (!writeRegs(INT_STATUS, &regValue, 1))
 		{
 			return false;
 		}
 	}
+#endif
 
 	_intMeasurementBio = false;
+#if VCNL4020C_USE_ALS
 	_intMeasurementALS = false;
+#endif
+#if VCNL4020C_USE_THRESHOLDS
 	_intThreshold = false;
+#endif
+#if VCNL4020C_USE_ALS_EVENTS
+	_alsEvents = false;
+#endif
 
 	// Prepare command register
 	regValue = 0;
@@ -278,6 +324,7 @@ uint8_t VCNL4020C::getLedCurrent(void)
 	return regValue;
 }
 
+#if VCNL4020C_USE_ALS
 bool VCNL4020C::setAlsParam(uint8_t dataRate, uint8_t avgConv, bool offsetComp)
 {
 	regValue = 0;
@@ -320,6 +367,7 @@ uint16_t VCNL4020C::getAlsValue(void)
 	}
 	return (uint16_t)((valHi) << 8) + valLo;
 }
+#endif
 
 uint16_t VCNL4020C::getBioValue(void)
 {
@@ -373,6 +421,7 @@ bool VCNL4020C::getIntControl(uint8_t *intCntrl)
 	return readRegs(INT_CONTR, intCntrl, 1);
 }
 
+#if VCNL4020C_USE_THRESHOLDS
 bool VCNL4020C::setThresholdLow(uint16_t threshold)
 {
 	regValue = threshold;
@@ -419,6 +468,7 @@ bool VCNL4020C::getThresholds(uint16_t *thresholdHigh, uint16_t *thresholdLow)
 	*thresholdHigh = ((uint16_t)(highByte) << 8) + lowByte;
 	return true;
 }
+#endif
 
 bool VCNL4020C::checkInterrupts(uint8_t *intStatus)
 {
@@ -451,6 +501,7 @@ bool VCNL4020C::checkBioInt(void)
 	return false;
 }
 
+#if VCNL4020C_USE_ALS
 bool VCNL4020C::checkAlsInt(void)
 {
 	if (!checkInterrupts(&regValue))
@@ -471,7 +522,9 @@ bool VCNL4020C::checkAlsInt(void)
 	}
 	return false;
 }
+#endif
 
+#if VCNL4020C_USE_THRESHOLDS
 bool VCNL4020C::checkThreshLowInt(void)
 {
 	if (!checkInterrupts(&regValue))
@@ -513,24 +566,801 @@ bool VCNL4020C::checkThreshHighInt(void)
 	}
 	return false;
 }
+#endif
 
 bool VCNL4020C::setBioSensMod(uint8_t bioSensMod)
 {
 	return writeRegs(BIO_SETTINGS, &regValue, 1);
 }
 
+#if VCNL4020C_USE_INTERRUPTS
 void VCNL4020C::setInterruptCb(void (*sensorInt)(), int intPin)
 {
 	_sensorInt = sensorInt;
 	_intPin = intPin;
 }
 
+bool VCNL4020C::setEventHandler(void (*handler)(void *ctx, uint8_t events), void *ctx, int intPin)
+{
+	if (_eventSlot == -1)
+	{
+		for (uint8_t slot = 0; slot < VCNL4020C_MAX_INSTANCES; slot++)
+		{
+			if (_instances[slot] == NULL)
+			{
+				_eventSlot = slot;
+				_instances[slot] = this;
+				break;
+			}
+		}
+		if (_eventSlot == -1)
+		{
+			return false;
+		}
+	}
+	_eventHandler = handler;
+	_eventCtx = ctx;
+	_intPin = intPin;
+	_eventPending = false;
+	return true;
+}
+
+bool VCNL4020C::handleEvents(void)
+{
+	if (!_eventPending)
+	{
+		return false;
+	}
+	_eventPending = false;
+
+	// The interrupt line stays low while any status bit is set, bits that arrive
+	// between the read and the clear give no new falling edge. Read again until
+	// the status is clear.
+	bool handled = false;
+	for (uint8_t round = 0; round < VCNL4020C_EVENT_ROUNDS; round++)
+	{
+		uint8_t events = 0;
+		if (!readRegs(INT_STATUS, &events, 1))
+		{
+			// Try again with the next call, the line may still be low
+			_eventPending = true;
+			return handled;
+		}
+		events &= (INT_BIO_RDY | INT_ALS_RDY | INT_TH_LOW_RDY | INT_TH_HIGH_RDY);
+		if (events == 0)
+		{
+			return handled;
+		}
+#if VCNL4020C_USE_ALS_EVENTS
+		// Same as handleAlsEvent(), the window must follow the new value before the bits are cleared
+		uint16_t alsValue = 0xFFFF;
+		if (_alsEvents && (events & (INT_TH_LOW_RDY | INT_TH_HIGH_RDY)) && !recenterAlsWindow(&alsValue))
+		{
+			_eventPending = true;
+			return handled;
+		}
+#endif
+		// Writing the set bits back clears them and releases the interrupt line
+		if (!writeRegs(INT_STATUS, &events, 1))
+		{
+			_eventPending = true;
+			return handled;
+		}
+		if ((events & INT_BIO_RDY) && (_batchConsumer != NULL))
+		{
+			readBatchSample();
+		}
+#if VCNL4020C_USE_ALS_EVENTS
+		if ((alsValue != 0xFFFF) && (_alsChange != NULL))
+		{
+			_alsChange(alsValue);
+		}
+#endif
+		if (_eventHandler != NULL)
+		{
+			PPG_TRACE_POINT(PPG_TRACE_CONSUMER, events);
+			_eventHandler(_eventCtx, events);
+		}
+		handled = true;
+	}
+	// Still events after VCNL4020C_EVENT_ROUNDS, continue with the next call
+	_eventPending = true;
+	return handled;
+}
+
+uint8_t VCNL4020C::dispatchEvents(void)
+{
+	uint8_t handled = 0;
+	for (uint8_t slot = 0; slot < VCNL4020C_MAX_INSTANCES; slot++)
+	{
+		if ((_instances[slot] != NULL) && _instances[slot]->handleEvents())
+		{
+			handled++;
+		}
+	}
+	return handled;
+}
+#endif
+
+bool VCNL4020C::interruptConfigured(void)
+{
+#if VCNL4020C_USE_INTERRUPTS
+	return (_intPin != -1) && ((_sensorInt != NULL) || (_eventSlot != -1));
+#else
+	// Polling only, the interrupt paths of the measurement functions are dropped
+	return false;
+#endif
+}
+
+void VCNL4020C::attachIsr(void)
+{
+#if VCNL4020C_USE_INTERRUPTS
+	pinMode(_intPin, INPUT_PULLUP);
+	if (_eventSlot == -1)
+	{
+		attachInterrupt(digitalPinToInterrupt(_intPin), _sensorInt, FALLING);
+		return;
+	}
+	// Trampolines, one per table slot
+	static void (*const trampolines[VCNL4020C_MAX_INSTANCES])(void) = {isr0, isr1, isr2, isr3};
+	attachInterrupt(digitalPinToInterrupt(_intPin), trampolines[_eventSlot], FALLING);
+#endif
+}
+
+#if VCNL4020C_USE_INTERRUPTS
+void IRAM_ATTR VCNL4020C::isr0(void)
+{
+	PPG_TRACE_START(PPG_TRACE_ISR);
+	_instances[0]->_eventPending = true;
+}
+
+void IRAM_ATTR VCNL4020C::isr1(void)
+{
+	PPG_TRACE_START(PPG_TRACE_ISR);
+	_instances[1]->_eventPending = true;
+}
+
+void IRAM_ATTR VCNL4020C::isr2(void)
+{
+	PPG_TRACE_START(PPG_TRACE_ISR);
+	_instances[2]->_eventPending = true;
+}
+
+void IRAM_ATTR VCNL4020C::isr3(void)
+{
+	PPG_TRACE_START(PPG_TRACE_ISR);
+	_instances[3]->_eventPending = true;
+}
+#endif
+
+bool VCNL4020C::startBatch(void (*consumer)(void *ctx, const PPG_SAMPLE *samples, uint16_t count), void *ctx, PPG_SAMPLE *buffer,
+						   uint16_t watermark, uint32_t maxLatencyMs)
+{
+	stopBatch();
+	if ((consumer == NULL) || (buffer == NULL) || (watermark == 0))
+	{
+		return false;
+	}
+	_batchBuf[0] = buffer;
+	_batchBuf[1] = buffer + watermark;
+	_batchFill = 0;
+	_batchCount = 0;
+	_batchWatermark = watermark;
+	_batchLatency = maxLatencyMs;
+	_batchCtx = ctx;
+	_batchConsumer = consumer;
+	return true;
+}
+
+void VCNL4020C::stopBatch(void)
+{
+	if (_batchConsumer == NULL)
+	{
+		return;
+	}
+	flushBatch();
+	_batchConsumer = NULL;
+	_batchBuf[0] = NULL;
+	_batchBuf[1] = NULL;
+}
+
+bool VCNL4020C::readBatchSample(void)
+{
+	if (_batchConsumer == NULL)
+	{
+		return false;
+	}
+	uint32_t timestamp = micros();
+	uint16_t value = getBioValue();
+	if (value == 0xFFFF)
+	{
+		return false;
+	}
+	return addBatchSample(value, timestamp);
+}
+
+bool VCNL4020C::addBatchSample(uint16_t value, uint32_t timestamp)
+{
+	if (_batchConsumer == NULL)
+	{
+		return false;
+	}
+	if (_batchCount == 0)
+	{
+		_batchStart = millis();
+	}
+	PPG_SAMPLE *sample = &_batchBuf[_batchFill][_batchCount++];
+	sample->timestamp = timestamp;
+	sample->value = value;
+	if (_batchCount >= _batchWatermark)
+	{
+		flushBatch();
+	}
+	else
+	{
+		serviceBatch();
+	}
+	return true;
+}
+
+void VCNL4020C::serviceBatch(void)
+{
+	if ((_batchConsumer == NULL) || (_batchCount == 0) || (_batchLatency == 0))
+	{
+		return;
+	}
+	if ((millis() - _batchStart) >= _batchLatency)
+	{
+		flushBatch();
+	}
+}
+
+void VCNL4020C::flushBatch(void)
+{
+	if ((_batchConsumer == NULL) || (_batchCount == 0))
+	{
+		return;
+	}
+	// Swap buffers, new samples go to the other buffer while the consumer works on this one
+	PPG_SAMPLE *samples = _batchBuf[_batchFill];
+	uint16_t count = _batchCount;
+	_batchFill ^= 1;
+	_batchCount = 0;
+	PPG_TRACE_POINT(PPG_TRACE_CONSUMER, 0);
+	_batchConsumer(_batchCtx, samples, count);
+}
+
+#if VCNL4020C_USE_ALS_EVENTS
+void VCNL4020C::setAlsChangeCb(void (*alsChange)(uint16_t alsValue))
+{
+	_alsChange = alsChange;
+}
+
+bool VCNL4020C::startAlsEvents(uint16_t hysteresis, uint8_t hystPercent, uint8_t thresCount)
+{
+	if (thresCount > INT_CNT_EXC_128)
+	{
+		thresCount = INT_CNT_EXC_128;
+	}
+	_alsHyst = hysteresis;
+	_alsHystPercent = hystPercent;
+	_alsThresCount = thresCount & INT_CNT_EXC_128;
+
+	// Empty window, the first measurement exceeds it and reports the initial value
+	if (!setThresholdLow(0xFFFF))
+	{
+		return false;
+	}
+	if (!setThresholdHigh(0))
+	{
+		return false;
+	}
+	_alsEvents = true;
+
+	// Clear old threshold interrupts
+	regValue = INT_TH_LOW_RDY | INT_TH_HIGH_RDY;
+	if (!writeRegs(INT_STATUS, &regValue, 1))
+	{
+		return false;
+	}
+
+	// Apply threshold to ALS, keep the data ready interrupts
+	if (!readRegs(INT_CONTR, &regValue, 1))
+	{
+		return false;
+	}
+	regValue &= (INT_BS_RDY_ENA | INT_ALS_RDY_ENA);
+	regValue |= INT_THRES_ENA | INT_THRES_ALS | _alsThresCount;
+	if (!writeRegs(INT_CONTR, &regValue, 1))
+	{
+		return false;
+	}
+
+	// Check if interrupt callback function is set and interrupt GPIO is defined
+	if (interruptConfigured())
+	{
+		attachIsr();
+	}
+
+	// Start periodic ALS measurement, keep a running bio measurement
+	if (!readRegs(CMD_REG, &regValue, 1))
+	{
+		return false;
+	}
+	regValue &= (PER_BIO_MEAS_EN | PER_ALS_MEAS_EN | SELF_TIMED_EN);
+	regValue |= PER_ALS_MEAS_EN | SELF_TIMED_EN;
+	return writeRegs(CMD_REG, &regValue, 1);
+}
+
+bool VCNL4020C::stopAlsEvents(void)
+{
+	_alsEvents = false;
+	if (!readRegs(INT_CONTR, &regValue, 1))
+	{
+		return false;
+	}
+	regValue &= INT_THRES_DIS;
+	if (!writeRegs(INT_CONTR, &regValue, 1))
+	{
+		return false;
+	}
+	regValue = INT_TH_LOW_RDY | INT_TH_HIGH_RDY;
+	return writeRegs(INT_STATUS, &regValue, 1);
+}
+
+bool VCNL4020C::handleAlsEvent(void)
+{
+	if (!_alsEvents)
+	{
+		return false;
+	}
+	if (!checkInterrupts(&regValue))
+	{
+		return false;
+	}
+	if ((regValue & (INT_TH_LOW_RDY | INT_TH_HIGH_RDY)) == 0)
+	{
+		return false;
+	}
+
+	// Center the window around the new value before the status is cleared
+	uint16_t alsValue;
+	if (!recenterAlsWindow(&alsValue))
+	{
+		return false;
+	}
+	regValue = INT_TH_LOW_RDY | INT_TH_HIGH_RDY;
+	if (!writeRegs(INT_STATUS, &regValue, 1))
+	{
+		return false;
+	}
+
+	if (_alsChange != NULL)
+	{
+		_alsChange(alsValue);
+	}
+	return true;
+}
+
+bool VCNL4020C::recenterAlsWindow(uint16_t *alsValue)
+{
+	*alsValue = getAlsValue();
+	if (*alsValue == 0xFFFF)
+	{
+		return false;
+	}
+	return setAlsWindow(*alsValue);
+}
+
+bool VCNL4020C::setAlsWindow(uint16_t alsValue)
+{
+	uint32_t distance = ((uint32_t)alsValue * _alsHystPercent) / 100;
+	if (distance < _alsHyst)
+	{
+		distance = _alsHyst;
+	}
+	uint16_t low = (alsValue > distance) ? (uint16_t)(alsValue - distance) : 0;
+	uint16_t high = ((alsValue + distance) < 0xFFFF) ? (uint16_t)(alsValue + distance) : 0xFFFF;
+	if (!setThresholdLow(low))
+	{
+		return false;
+	}
+	return setThresholdHigh(high);
+}
+#endif
+
+uint8_t VCNL4020C::intControlBits(bool bio, bool als)
+{
+	uint8_t intBits = 0;
+	if (bio)
+	{
+		intBits |= INT_BS_RDY_ENA;
+		_intMeasurementBio = true;
+	}
+#if VCNL4020C_USE_ALS
+	if (als)
+	{
+		intBits |= INT_ALS_RDY_ENA;
+		_intMeasurementALS = true;
+	}
+#endif
+#if VCNL4020C_USE_ALS_EVENTS
+	if (_alsEvents)
+	{
+		// Keep the threshold window on the ALS measurements
+		intBits |= INT_THRES_ENA | INT_THRES_ALS | _alsThresCount;
+		return intBits;
+	}
+#endif
+#if VCNL4020C_USE_THRESHOLDS
+	if ((_lowThresh != 0) && (_highThresh != 0))
+	{
+		intBits |= INT_THRES_ENA;
+		_intThreshold = true;
+	}
+#endif
+	return intBits;
+}
+
 bool VCNL4020C::getBioSensMod(uint8_t *modSetting)
 {
 	return readRegs(BIO_SETTINGS, modSetting, 1);
 }
 
+bool VCNL4020C::readSnapshot(VCNL4020C_SNAPSHOT *snap)
+{
+	uint8_t regs[VCNL4020C_NUM_REGS];
+	if (!readRegs(CMD_REG, regs, VCNL4020C_NUM_REGS))
+	{
+		return false;
+	}
+	snap->cmdReg = regs[CMD_REG - CMD_REG];
+	snap->prodId = (uint8_t)(regs[PROD_ID - CMD_REG] >> 4);
+	snap->revId = regs[PROD_ID - CMD_REG] & 0b00001111;
+	snap->bioRate = regs[BIO_SENS_RATE - CMD_REG] & 0b00000111;
+	snap->ledCurrent = regs[LED_CURRENT - CMD_REG] & CURRENT_MASK;
+	snap->alsParam = regs[AMBIENT_LIGHT_PARAM - CMD_REG];
+	snap->alsValue = ((uint16_t)(regs[AMB_RESULT_H - CMD_REG]) << 8) + regs[AMB_RESULT_L - CMD_REG];
+	snap->bioValue = ((uint16_t)(regs[BIO_RESULT_H - CMD_REG]) << 8) + regs[BIO_RESULT_L - CMD_REG];
+	snap->intControl = regs[INT_CONTR - CMD_REG];
+	snap->thresLow = ((uint16_t)(regs[THRES_LOW_VAL_H - CMD_REG]) << 8) + regs[THRES_LOW_VAL_L - CMD_REG];
+	snap->thresHigh = ((uint16_t)(regs[THRES_HIGH_VAL_H - CMD_REG]) << 8) + regs[THRES_HIGH_VAL_L - CMD_REG];
+	snap->intStatus = regs[INT_STATUS - CMD_REG];
+	snap->bioSettings = regs[BIO_SETTINGS - CMD_REG];
+	return true;
+}
+
+void VCNL4020C::printSnapshot(Print &out, const VCNL4020C_SNAPSHOT &snap, bool json)
+{
+	uint8_t alsRate = pgm_read_byte(&alsRates[(snap.alsParam & 0b01110000) >> 4]);
+	const __FlashStringHelper *bioRate = (const __FlashStringHelper *)pgm_read_ptr(&bioRateNames[snap.bioRate & 0b00000111]);
+	uint8_t alsAvg = snap.alsParam & 0b00000111;
+	bool autoComp = (snap.alsParam & AUTO_COMP_ENA) == AUTO_COMP_ENA;
+
+	if (json)
+	{
+		out.print(F("{\"cmd\":"));
+		out.print(snap.cmdReg);
+		out.print(F(",\"prodId\":"));
+		out.print(snap.prodId);
+		out.print(F(",\"revId\":"));
+		out.print(snap.revId);
+		out.print(F(",\"bioRate\":"));
+		out.print(bioRate);
+		out.print(F(",\"ledCurrent\":"));
+		out.print(snap.ledCurrent * 10);
+		out.print(F(",\"alsRate\":"));
+		out.print(alsRate);
+		out.print(F(",\"alsAutoComp\":"));
+		out.print(autoComp ? F("true") : F("false"));
+		out.print(F(",\"alsAvg\":"));
+		out.print(1 << alsAvg);
+		out.print(F(",\"intControl\":"));
+		out.print(snap.intControl);
+		out.print(F(",\"thresLow\":"));
+		out.print(snap.thresLow);
+		out.print(F(",\"thresHigh\":"));
+		out.print(snap.thresHigh);
+		out.print(F(",\"intStatus\":"));
+		out.print(snap.intStatus);
+		out.print(F(",\"bioMod\":"));
+		out.print(snap.bioSettings);
+		out.print(F(",\"bio\":"));
+		out.print(snap.bioValue);
+		out.print(F(",\"als\":"));
+		out.print(snap.alsValue);
+		out.println(F("}"));
+		return;
+	}
+
+	out.print(F("Product ID "));
+	out.print(snap.prodId);
+	out.print(F(", Revision ID "));
+	out.println(snap.revId);
+	out.print(F("Self timed measures "));
+	out.println((snap.cmdReg & SELF_TIMED_EN) ? F("enabled") : F("disabled"));
+	out.print(F("Continuous bio measurement "));
+	out.println((snap.cmdReg & PER_BIO_MEAS_EN) ? F("active") : F("inactive"));
+	out.print(F("Continuous als measurement "));
+	out.println((snap.cmdReg & PER_ALS_MEAS_EN) ? F("active") : F("inactive"));
+	out.print(F("Bio sensor data rate "));
+	out.print(bioRate);
+	out.println(F(" measures/s"));
+	out.print(F("LED current "));
+	out.print(snap.ledCurrent * 10);
+	out.println(F(" mA"));
+	out.print(F("ALS data rate "));
+	out.print(alsRate);
+	out.println(F(" samples/s"));
+	out.print(F("Auto offset compensation "));
+	out.println(autoComp ? F("enabled") : F("disabled"));
+	out.print(F("Averaging count "));
+	out.println(1 << alsAvg);
+	out.print(F("Interrupt control 0x"));
+	out.println(snap.intControl, HEX);
+	out.print(F("Threshold low "));
+	out.print(snap.thresLow);
+	out.print(F(", high "));
+	out.println(snap.thresHigh);
+	out.print(F("Interrupt status 0x"));
+	out.println(snap.intStatus, HEX);
+	out.print(F("Bio sensor modulation 0x"));
+	out.println(snap.bioSettings, HEX);
+	out.print(F("Bio value "));
+	out.print(snap.bioValue);
+	out.print(F(", ALS value "));
+	out.println(snap.alsValue);
+}
+
+void VCNL4020C::setConfigStorage(bool (*store)(const uint8_t *data, uint8_t len), bool (*load)(uint8_t *data, uint8_t len))
+{
+	_storeConfig = store;
+	_loadConfig = load;
+}
+
+bool VCNL4020C::saveConfig(void)
+{
+	uint8_t config[VCNL4020C_CONFIG_SIZE];
+	if (_storeConfig == NULL)
+	{
+		return false;
+	}
+	if (!readRegs(CMD_REG, config, VCNL4020C_NUM_REGS))
+	{
+		return false;
+	}
+	// Keep only the measurement enable bits, single measurements and data ready flags are not restored
+	config[CMD_REG - CMD_REG] &= (SELF_TIMED_EN | PER_BIO_MEAS_EN | PER_ALS_MEAS_EN);
+	config[VCNL4020C_NUM_REGS] = VCNL4020C_CONFIG_MAGIC;
+	config[VCNL4020C_NUM_REGS + 1] = configChecksum(config);
+	return _storeConfig(config, VCNL4020C_CONFIG_SIZE);
+}
+
+bool VCNL4020C::warmStart(bool verifyId, bool sensorPowered)
+{
+	uint32_t startTime = micros();
+	uint32_t phaseTime = startTime;
+	uint8_t config[VCNL4020C_CONFIG_SIZE];
+
+	memset(&_initTiming, 0, sizeof(VCNL4020C_INIT_TIMING));
+
+	if (_loadConfig == NULL)
+	{
+		return false;
+	}
+	if (!_loadConfig(config, VCNL4020C_CONFIG_SIZE))
+	{
+		return false;
+	}
+	if ((config[VCNL4020C_NUM_REGS] != VCNL4020C_CONFIG_MAGIC) || (config[VCNL4020C_NUM_REGS + 1] != configChecksum(config)))
+	{
+		return false;
+	}
+
+	// Initialize I2C
+	initBus();
+	_initTiming.bus = micros() - phaseTime;
+	phaseTime = micros();
+
+	if (verifyId)
+	{
+		uint8_t checkID = 0;
+		uint8_t checkRev = 0;
+		if (!getIds(&checkID, &checkRev))
+		{
+			return false;
+		}
+		// Both must match, a different chip with the same ID must not get this configuration
+		if ((checkID != 2) || (checkRev != 1))
+		{
+			return false;
+		}
+		_initTiming.idCheck = micros() - phaseTime;
+		phaseTime = micros();
+	}
+
+	if (!sensorPowered)
+	{
+		// Sensor was power cycled, same startup as initSensorDefault()
+		if (!resetSensor())
+		{
+			return false;
+		}
+		_initTiming.reset = micros() - phaseTime;
+		phaseTime = micros();
+	}
+
+	// Burst 1: bio sensor rate, LED current and ALS parameters (0x82 to 0x84)
+	config[LED_CURRENT - CMD_REG] &= CURRENT_MASK;
+	if (!writeRegs(BIO_SENS_RATE, &config[BIO_SENS_RATE - CMD_REG], 3))
+	{
+		return false;
+	}
+	// Burst 2: interrupt control, thresholds, interrupt status and modulation (0x89 to 0x8F)
+	// Writing 1's to the interrupt status clears all pending interrupts
+	config[INT_STATUS - CMD_REG] = INT_BIO_RDY | INT_ALS_RDY | INT_TH_LOW_RDY | INT_TH_HIGH_RDY;
+	if (!writeRegs(INT_CONTR, &config[INT_CONTR - CMD_REG], 7))
+	{
+		return false;
+	}
+
+	uint8_t intControl = config[INT_CONTR - CMD_REG];
+	_intMeasurementBio = (intControl & INT_BS_RDY_ENA) == INT_BS_RDY_ENA;
+#if VCNL4020C_USE_ALS
+	_intMeasurementALS = (intControl & INT_ALS_RDY_ENA) == INT_ALS_RDY_ENA;
+#endif
+#if VCNL4020C_USE_THRESHOLDS
+	_intThreshold = (intControl & INT_THRES_ENA) == INT_THRES_ENA;
+	_lowThresh = ((uint16_t)(config[THRES_LOW_VAL_H - CMD_REG]) << 8) + config[THRES_LOW_VAL_L - CMD_REG];
+	_highThresh = ((uint16_t)(config[THRES_HIGH_VAL_H - CMD_REG]) << 8) + config[THRES_HIGH_VAL_L - CMD_REG];
+#endif
+
+	// Check if interrupt callback function is set and interrupt GPIO is defined
+	if (interruptConfigured() && ((intControl & (INT_BS_RDY_ENA | INT_ALS_RDY_ENA | INT_THRES_ENA)) != 0))
+	{
+		attachIsr();
+	}
+
+	// Burst 3: command register last, restarts the periodic measurements with the restored settings
+	if (!writeRegs(CMD_REG, &config[CMD_REG - CMD_REG], 1))
+	{
+		return false;
+	}
+	_initTiming.registers = micros() - phaseTime;
+	_initTiming.total = micros() - startTime;
+	return true;
+}
+
+uint32_t VCNL4020C::getStartupTime(void)
+{
+	return _initTiming.total;
+}
+
+void VCNL4020C::setInitOptions(const VCNL4020C_INIT_OPTIONS &options)
+{
+	_initOptions = options;
+}
+
+void VCNL4020C::getInitTiming(VCNL4020C_INIT_TIMING *timing)
+{
+	*timing = _initTiming;
+}
+
+void VCNL4020C::initBus(void)
+{
+	if (_initOptions.initBus)
+	{
+		_i2c->begin();
+	}
+	if (_initOptions.i2cClock != 0)
+	{
+		_i2c->setClock(_initOptions.i2cClock);
+	}
+}
+
+bool VCNL4020C::resetSensor(void)
+{
+	regValue = 0;
+	if (!writeRegs(CMD_REG, &regValue, 1))
+	{
+		return false;
+	}
+	if (!_initOptions.pollReady)
+	{
+		delay(_initOptions.readyTimeoutMs);
+		return true;
+	}
+	// The command register reads back immediately, it tells nothing about the sensor.
+	// Start one bio sensor measurement and wait for its result, the first BIO_DATA_READY.
+	regValue = START_BIO_MES;
+	if (!writeRegs(CMD_REG, &regValue, 1))
+	{
+		return false;
+	}
+	uint32_t startTime = millis();
+	do
+	{
+		if (readRegs(CMD_REG, &regValue, 1) && (regValue & BIO_DATA_READY))
+		{
+			// Reading the result clears the data ready flag
+			uint8_t result[2];
+			return readRegs(BIO_RESULT_H, result, 2);
+		}
+	} while ((millis() - startTime) < _initOptions.readyTimeoutMs);
+	return false;
+}
+
+uint8_t VCNL4020C::configChecksum(uint8_t *data)
+{
+	uint8_t sum = 0;
+	for (uint8_t idx = 0; idx <= VCNL4020C_NUM_REGS; idx++)
+	{
+		sum = (uint8_t)((sum << 1) | (sum >> 7)) ^ data[idx];
+	}
+	return sum;
+}
+
+#ifdef PPG_HAS_THREADS
+bool VCNL4020C::setBusArbiter(BUS_ARBITER *arbiter, uint8_t priority, uint32_t deadlineUs)
+{
+	if (arbiter == NULL)
+	{
+		_arbiter = NULL;
+		_busClient = -1;
+		return true;
+	}
+	int8_t client = arbiter->addClient("VCNL4020C", priority);
+	if (client == -1)
+	{
+		return false;
+	}
+	_arbiter = arbiter;
+	_busClient = client;
+	_busDeadline = deadlineUs;
+	return true;
+}
+
+int8_t VCNL4020C::getBusClient(void)
+{
+	return _busClient;
+}
+#endif
+
 bool VCNL4020C::writeRegs(int reg_addr, uint8_t *data, int len)
+{
+#ifdef PPG_HAS_THREADS
+	if (_arbiter != NULL)
+	{
+		if (!_arbiter->acquire(_busClient, _busDeadline))
+		{
+			return false;
+		}
+		bool result = busWrite(reg_addr, data, len);
+		_arbiter->release(_busClient);
+		return result;
+	}
+#endif
+	return busWrite(reg_addr, data, len);
+}
+
+bool VCNL4020C::readRegs(int reg_addr, uint8_t *data, int len)
+{
+#ifdef PPG_HAS_THREADS
+	if (_arbiter != NULL)
+	{
+		if (!_arbiter->acquire(_busClient, _busDeadline))
+		{
+			return false;
+		}
+		bool result = busRead(reg_addr, data, len);
+		_arbiter->release(_busClient);
+		return result;
+	}
+#endif
+	return busRead(reg_addr, data, len);
+}
+
+bool VCNL4020C::busWrite(int reg_addr, uint8_t *data, int len)
 {
 	_i2c->beginTransmission(_addr);
 	if (_i2c->write(reg_addr) == 0)
@@ -550,8 +1380,9 @@ bool VCNL4020C::writeRegs(int reg_addr, uint8_t *data, int len)
 	return true;
 }
 
-bool VCNL4020C::readRegs(int reg_addr, uint8_t *data, int len)
+bool VCNL4020C::busRead(int reg_addr, uint8_t *data, int len)
 {
+	PPG_TRACE_POINT(PPG_TRACE_I2C_START, reg_addr);
 	_i2c->beginTransmission(_addr);
 	if (_i2c->write(reg_addr) == 0)
 	{
@@ -570,6 +1401,6 @@ bool VCNL4020C::readRegs(int reg_addr, uint8_t *data, int len)
 	{
 		data[i] = _i2c->read();
 	}
-
+	PPG_TRACE_POINT(PPG_TRACE_I2C_END, reg_addr);
 	return true;
 }
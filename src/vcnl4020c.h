@@ -14,6 +14,13 @@
 #ifndef VCNL4020C_H
 #define VCNL4020C_H
 
+/** Maximum number of sensors using setEventHandler() */
+#define VCNL4020C_MAX_INSTANCES 4
+/** Maximum status reads of one handleEvents() call while new events keep arriving */
+#define VCNL4020C_EVENT_ROUNDS 4
+/** Number of samples of the double buffer for startBatch() */
+#define VCNL4020C_BATCH_SIZE(watermark) (2 * (watermark))
+
 /** Default I2C address of VCNL4020C */
 #define VCNL4020C_ADDR 0x13 // Datasheet said 0x26
 
@@ -322,6 +329,63 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "busArbiter.h"
+#include "ppgSample.h"
+#include "ppgTrace.h"
+#include "ppgConfig.h"
+
+/** Number of registers in the register snapshot (0x80 to 0x8F) */
+#define VCNL4020C_NUM_REGS 16
+
+/** Size of the stored configuration for warm start (registers, magic and checksum) */
+#define VCNL4020C_CONFIG_SIZE (VCNL4020C_NUM_REGS + 2)
+/** Marker of a valid stored configuration */
+#define VCNL4020C_CONFIG_MAGIC 0xC4
+
+/**
+ * Options for initSensorDefault() and warmStart()
+ */
+struct VCNL4020C_INIT_OPTIONS
+{
+	bool initBus;			 ///< TRUE to call begin() of the I2C class, FALSE if the bus is already initialized
+	uint32_t i2cClock;		 ///< I2C clock in Hz, 0 to keep the clock set by the application
+	bool pollReady;			 ///< TRUE to wait for the first bio sensor result after reset instead of a fixed delay
+	uint16_t readyTimeoutMs; ///< Startup delay or maximum time to poll for ready in ms
+
+	VCNL4020C_INIT_OPTIONS(void) : initBus(true), i2cClock(800000), pollReady(false), readyTimeoutMs(10) {}
+};
+
+/**
+ * Startup timing of the last initSensorDefault() or warmStart(), all values in microseconds
+ */
+struct VCNL4020C_INIT_TIMING
+{
+	uint32_t bus;		///< I2C bus initialization
+	uint32_t idCheck;	///< Reading and checking the product ID
+	uint32_t reset;		///< Reset of the command register and wait for ready
+	uint32_t registers; ///< Writing the configuration registers
+	uint32_t total;		///< Complete initialization
+};
+
+/**
+ * Snapshot of all sensor registers, read in one transaction
+ */
+struct VCNL4020C_SNAPSHOT
+{
+	uint8_t cmdReg;		 ///< Command register
+	uint8_t prodId;		 ///< Product ID
+	uint8_t revId;		 ///< Revision ID
+	uint8_t bioRate;	 ///< Bio sensor data rate, BIO_SENS_RATE_1_95 to BIO_SENS_RATE_250
+	uint8_t ledCurrent;	 ///< LED current in 10mA steps
+	uint8_t alsParam;	 ///< Ambient light parameter register
+	uint16_t alsValue;	 ///< Ambient light result
+	uint16_t bioValue;	 ///< Bio sensor result
+	uint8_t intControl;	 ///< Interrupt control register
+	uint16_t thresLow;	 ///< Low threshold
+	uint16_t thresHigh;	 ///< High threshold
+	uint8_t intStatus;	 ///< Interrupt status register
+	uint8_t bioSettings; ///< Bio sensor modulation
+};
 
 /**
  * VCNL4020C 
@@ -350,6 +414,7 @@ public:
 
 	/**
 	 * Initialize the sensor with default values
+	 * The I2C bus setup and the startup wait can be changed with setInitOptions()
 	 * - LED current set to 100mA (middle of range)
 	 * - Conversion mode set to single measurement mode
 	 * - Interrupts disabled
@@ -370,12 +435,14 @@ public:
 	 * @return result of request
 	 */
 	bool getCmdReg(uint8_t *cmdVal);
+#if VCNL4020C_USE_ALS
 	/** 
 	 * Check command register if Ambient light sensor data is available
 	 * @return result
 	 * 			True if ALS data is available
 	 */
 	bool alsDataReady(void);
+#endif
 	/** 
 	 * Check command register if Bio sensor data is available
 	 * @return result
@@ -451,6 +518,7 @@ public:
 	 * @return LED current
 	 */
 	uint8_t getLedCurrent(void);
+#if VCNL4020C_USE_ALS
 	/**
 	 * Set Ambient light sensor parameters
 	 * @param dataRate
@@ -494,6 +562,7 @@ public:
 	 * @return als value as 16 bit value or 0xFFFF if no data available
 	 */
 	uint16_t getAlsValue(void);
+#endif
 	/**
 	 * Get bio sensor result
 	 * @return bio value as 16 bit value or 0xFFFF if no data available
@@ -534,6 +603,7 @@ public:
 	 * @return result of request
 	 */
 	bool getIntControl(uint8_t *intCntrl);
+#if VCNL4020C_USE_THRESHOLDS
 	/**
 	 * Set low threshold value
 	 * @param threshold
@@ -557,6 +627,7 @@ public:
 	 * @return result of request
 	 */
 	bool getThresholds(uint16_t * thresholdHigh, uint16_t * thresholdLow);
+#endif
 	/**
 	 * Check if any interrupt is set
 	 * @param intStatus
@@ -570,12 +641,15 @@ public:
 	 * @return result TRUE if bio sensor interrupt is set or FALSE if no interrupt is set or request failed
 	 */
 	bool checkBioInt(void);
+#if VCNL4020C_USE_ALS
 	/**
 	 * Check if ambient light sensor interrupt is set
 	 * Calling this function clears the interrupt bit
 	 * @return result TRUE if ambient light sensor interrupt is set or FALSE if no interrupt is set or request failed
 	 */
 	bool checkAlsInt(void);
+#endif
+#if VCNL4020C_USE_THRESHOLDS
 	/**
 	 * Check if threshold low exceed interrupt is set
 	 * Calling this function clears the interrupt bit
@@ -588,6 +662,7 @@ public:
 	 * @return result TRUE if threshold high interrupt is set or FALSE if no interrupt is set or request failed
 	 */
 	bool checkThreshHighInt(void);
+#endif
 	/**
 	 * Set bio sensor modulation
 	 *
@@ -634,6 +709,97 @@ public:
 	 * @return result of request
 	 */
 	bool getBioSensMod(uint8_t * modSetting);
+	/**
+	 * Read all registers (0x80 to 0x8F) in one auto increment transaction
+	 * Reading the result registers clears the data ready flags in the command register,
+	 * the data ready flags are returned in snap->cmdReg.
+	 * @param snap
+	 * 		Pointer to the snapshot structure to fill
+	 * @return result of request
+	 */
+	bool readSnapshot(VCNL4020C_SNAPSHOT *snap);
+	/**
+	 * Print a register snapshot in readable form or as JSON
+	 * The output is written directly to the Print sink, no heap is used
+	 * @param out
+	 * 		Print sink, e.g. Serial
+	 * @param snap
+	 * 		Snapshot read with readSnapshot()
+	 * @param json
+	 * 		TRUE to print one line of JSON, FALSE to print readable text
+	 */
+	void printSnapshot(Print &out, const VCNL4020C_SNAPSHOT &snap, bool json = false);
+	/**
+	 * Set user storage functions for the sensor configuration
+	 * The configuration is a block of VCNL4020C_CONFIG_SIZE bytes that can be
+	 * kept e.g. in NVS, EEPROM or RTC memory
+	 * @param store
+	 * 		Pointer to user function that saves len bytes, returns TRUE on success
+	 * @param load
+	 * 		Pointer to user function that restores len bytes, returns TRUE on success
+	 */
+	void setConfigStorage(bool (*store)(const uint8_t *data, uint8_t len), bool (*load)(uint8_t *data, uint8_t len));
+	/**
+	 * Save the current sensor configuration with the user store function
+	 * Call after the sensor is configured, before going to sleep
+	 * @return result of request
+	 */
+	bool saveConfig(void);
+	/**
+	 * Restore the sensor configuration saved with saveConfig()
+	 * - The configuration registers are written in 3 burst transactions
+	 * - Pending interrupts are cleared
+	 * - Measurements and interrupts that were active when the configuration was saved are restarted
+	 * @param verifyId
+	 * 		TRUE to check the product ID before the configuration is written
+	 * @param sensorPowered
+	 * 		TRUE if the sensor stayed powered while the MCU was sleeping, no startup delay is needed.
+	 * 		FALSE if the sensor was power cycled, the startup delay of initSensorDefault() is used
+	 * @return result
+	 * 		FALSE if no valid configuration is stored, the sensor is not found or the communication failed.
+	 * 		Use initSensorDefault() in this case.
+	 */
+	bool warmStart(bool verifyId = false, bool sensorPowered = true);
+	/**
+	 * Get duration of the last initSensorDefault() or warmStart()
+	 * @return startup time in microseconds
+	 */
+	uint32_t getStartupTime(void);
+#ifdef PPG_HAS_THREADS
+	/**
+	 * Share the I2C bus with other drivers through a bus arbiter
+	 * Every register access acquires the bus before and releases it after the transfer
+	 * @param arbiter
+	 * 		Pointer to the bus arbiter, NULL to access the bus directly
+	 * @param priority
+	 * 		Priority of the sensor on the bus, higher value is served first
+	 * @param deadlineUs
+	 * 		Time in us by which a register access should get the bus, 0 for no deadline.
+	 * 		E.g. half of the sample period at high bio sensor data rates
+	 * @return result
+	 * 		FALSE if the arbiter has no free client slot
+	 */
+	bool setBusArbiter(BUS_ARBITER *arbiter, uint8_t priority = 200, uint32_t deadlineUs = 0);
+	/**
+	 * Get client ID of the sensor at the bus arbiter, e.g. for BUS_ARBITER::getStats()
+	 * @return client ID or -1 if no arbiter is set
+	 */
+	int8_t getBusClient(void);
+#endif
+	/**
+	 * Set options for initSensorDefault() and warmStart()
+	 * Default is I2C begin() and 800kHz clock and a fixed 10ms startup delay
+	 * @param options
+	 * 		Bus initialization, I2C clock and startup wait options
+	 */
+	void setInitOptions(const VCNL4020C_INIT_OPTIONS &options);
+	/**
+	 * Get startup timing of the last initSensorDefault() or warmStart() by phase
+	 * @param timing
+	 * 		Pointer to the structure to fill
+	 */
+	void getInitTiming(VCNL4020C_INIT_TIMING *timing);
+#if VCNL4020C_USE_INTERRUPTS
 	/**
 	 * Set user interrupt callback function
 	 * @param sensorInt
@@ -642,29 +808,231 @@ public:
 	 * 			GPIO connected to the sensors interrupt pin
 	 */
 	void setInterruptCb(void (*sensorInt)(), int intPin);
+	/**
+	 * Set event handler with user context, the interrupt routine is owned by the driver
+	 * Replaces setInterruptCb(). The driver attaches its own interrupt routine to the GPIO,
+	 * so multiple sensors need no user interrupt routines or flags.
+	 * The handler is called from handleEvents() or dispatchEvents(), not from the interrupt.
+	 * @param handler
+	 * 			Pointer to user function, called with ctx and the interrupt status bits
+	 * 			(INT_BIO_RDY, INT_ALS_RDY, INT_TH_LOW_RDY, INT_TH_HIGH_RDY)
+	 * @param ctx
+	 * 			User context, e.g. pointer to the per sensor data
+	 * @param intPin
+	 * 			GPIO connected to the sensors interrupt pin
+	 * @return result
+	 * 		FALSE if VCNL4020C_MAX_INSTANCES sensors already use event handlers
+	 */
+	bool setEventHandler(void (*handler)(void *ctx, uint8_t events), void *ctx, int intPin);
+	/**
+	 * Handle a pending interrupt of this sensor
+	 * Reads the interrupt status, clears the set bits and calls the event handler,
+	 * until the status is clear or VCNL4020C_EVENT_ROUNDS handler calls were made.
+	 * With startAlsEvents() a threshold event also re-centers the ambient light window
+	 * and calls the ambient light change callback, as handleAlsEvent() does.
+	 * If a request fails or events are left, the interrupt stays pending for the next call.
+	 * @return result
+	 * 		TRUE if an event was handled, FALSE if no interrupt was pending or request failed
+	 */
+	bool handleEvents(void);
+	/**
+	 * Handle pending interrupts of all sensors with event handlers
+	 * Call from loop() or from a task
+	 * @return number of sensors with handled events
+	 */
+	static uint8_t dispatchEvents(void);
+#endif
+	/**
+	 * Start batch delivery of bio sensor samples
+	 * Samples are collected with timestamps in a double buffer supplied by the application,
+	 * e.g. a static array, no heap is used.
+	 * When watermark samples are collected, or the oldest sample is older than maxLatencyMs,
+	 * the buffer is handed to the consumer without copying and collection continues in the
+	 * second buffer. The samples are not overwritten before the next batch is complete.
+	 * With setEventHandler() the bio value is read by the driver on INT_BIO_RDY.
+	 * @param consumer
+	 * 		Pointer to user function, called with ctx, the samples and the number of samples
+	 * @param ctx
+	 * 		User context for the consumer
+	 * @param buffer
+	 * 		Storage for VCNL4020C_BATCH_SIZE(watermark) samples, must stay valid until stopBatch()
+	 * @param watermark
+	 * 		Number of samples in one batch
+	 * @param maxLatencyMs
+	 * 		Maximum age of the oldest sample in a batch in ms, 0 to deliver only full batches
+	 * @return result
+	 * 		FALSE if consumer or buffer is NULL or watermark is 0
+	 */
+	bool startBatch(void (*consumer)(void *ctx, const PPG_SAMPLE *samples, uint16_t count), void *ctx, PPG_SAMPLE *buffer, uint16_t watermark,
+					uint32_t maxLatencyMs = 0);
+	/**
+	 * Stop batch delivery, collected samples are delivered and the buffer is released to the application
+	 */
+	void stopBatch(void);
+	/**
+	 * Read the bio sensor value and add it to the batch
+	 * Use after bioDataReady() or checkBioInt()
+	 * @return result
+	 * 		FALSE if batch delivery is not started or the value is invalid
+	 */
+	bool readBatchSample(void);
+	/**
+	 * Add a sample read by the application to the batch
+	 * @param value
+	 * 		Bio sensor value
+	 * @param timestamp
+	 * 		Time of the sample in us, e.g. from SAMPLE_CLOCK
+	 * @return result
+	 * 		FALSE if batch delivery is not started
+	 */
+	bool addBatchSample(uint16_t value, uint32_t timestamp);
+	/**
+	 * Deliver the batch if the maximum latency is exceeded
+	 * Call from loop() if samples can stop, e.g. when the measurement is stopped
+	 */
+	void serviceBatch(void);
+	/**
+	 * Deliver the collected samples now
+	 */
+	void flushBatch(void);
+#if VCNL4020C_USE_ALS_EVENTS
+	/**
+	 * Set user callback function for ambient light change events
+	 * @param alsChange
+	 * 			Pointer to user function, called from handleAlsEvent() or handleEvents() with the new ambient light value
+	 */
+	void setAlsChangeCb(void (*alsChange)(uint16_t alsValue));
+	/**
+	 * Start ambient light change events
+	 * The threshold registers are programmed as a window around the current
+	 * ambient light value and the threshold interrupt is applied to the ambient
+	 * light measurements. The sensor only raises an interrupt when the ambient
+	 * light leaves the window. The first measurement always raises an event
+	 * with the initial ambient light value.
+	 * Ambient light measurements are started with the rate set by setAlsParam(),
+	 * a running bio sensor measurement is not touched.
+	 * @param hysteresis
+	 * 		Minimum distance of the window limits from the current value in ALS counts
+	 * @param hystPercent
+	 * 		Distance of the window limits in percent of the current value, 0 to use only hysteresis.
+	 * 		The larger of both distances is used
+	 * @param thresCount
+	 * 		Number of measurements needed outside the window before the interrupt is set
+	 * 		INT_CNT_EXC_1 to INT_CNT_EXC_128, see setIntControl()
+	 * @return result of request
+	 */
+	bool startAlsEvents(uint16_t hysteresis, uint8_t hystPercent = 0, uint8_t thresCount = INT_CNT_EXC_1);
+	/**
+	 * Stop ambient light change events
+	 * The threshold interrupt is disabled, the ambient light measurements keep running
+	 * @return result of request
+	 */
+	bool stopAlsEvents(void);
+	/**
+	 * Handle an ambient light threshold interrupt
+	 * Call from loop() after the sensor interrupt was raised.
+	 * If the ambient light left the window, the new value is read, the window
+	 * is centered around the new value, the threshold interrupt bits are
+	 * cleared and the ambient light change callback is called.
+	 * Other interrupt status bits are not changed.
+	 * @return result
+	 * 		TRUE if an ambient light change was handled, FALSE if no threshold interrupt is set or request failed
+	 */
+	bool handleAlsEvent(void);
+#endif
 
 private:
 	TwoWire *_i2c; ///< Pointer to I2C class
 
 	int _addr = VCNL4020C_ADDR; ///< Sensor I2C address
 
+#if VCNL4020C_USE_THRESHOLDS
 	uint16_t _lowThresh = 0;  ///< User defined lower treshold
 	uint16_t _highThresh = 0; ///< User defined upper treshold
+#endif
 
 	uint8_t regValue = 0; ///< Temporary register value
 
 	bool _intMeasurementBio = false; ///< Flag if BIO interrupts are enabled
+#if VCNL4020C_USE_ALS
 	bool _intMeasurementALS = false; ///< Flag if ALS interrupts are enabled
+#endif
+#if VCNL4020C_USE_THRESHOLDS
 	bool _intThreshold = false;		 ///< Flag if Treshold interrupts are enabled
+#endif
+
+#if VCNL4020C_USE_ALS_EVENTS
+	bool _alsEvents = false;	 ///< Flag if ambient light change events are enabled
+	uint8_t _alsThresCount = 0;	 ///< Threshold count for ambient light change events
+	uint16_t _alsHyst = 0;		 ///< Ambient light window distance in counts
+	uint8_t _alsHystPercent = 0; ///< Ambient light window distance in percent
+#endif
+
+	VCNL4020C_INIT_OPTIONS _initOptions; ///< Initialization options
+	VCNL4020C_INIT_TIMING _initTiming = {0, 0, 0, 0, 0}; ///< Startup timing by phase
+
+	void initBus(void);
+	bool resetSensor(void);
+
+	bool (*_storeConfig)(const uint8_t *data, uint8_t len) = NULL; ///< Pointer to user store function
+	bool (*_loadConfig)(uint8_t *data, uint8_t len) = NULL;		  ///< Pointer to user load function
+
+	uint8_t configChecksum(uint8_t *data);
+#if VCNL4020C_USE_ALS_EVENTS
+	bool setAlsWindow(uint16_t alsValue);
+	bool recenterAlsWindow(uint16_t *alsValue);
+#endif
+	bool interruptConfigured(void);
+	void attachIsr(void);
+	uint8_t intControlBits(bool bio, bool als);
+
+#if VCNL4020C_USE_INTERRUPTS
+	static void isr0(void);
+	static void isr1(void);
+	static void isr2(void);
+	static void isr3(void);
+
+	static VCNL4020C *_instances[VCNL4020C_MAX_INSTANCES]; ///< Sensors with event handlers, indexed by trampoline
+	int8_t _eventSlot = -1;								   ///< Slot in _instances, -1 if no event handler is set
+	volatile bool _eventPending = false;				   ///< Set by the interrupt routine
+	void (*_eventHandler)(void *ctx, uint8_t events) = NULL; ///< Pointer to user event handler
+	void *_eventCtx = NULL;								   ///< User context for the event handler
+#endif
+
+#if VCNL4020C_USE_ALS_EVENTS
+	/**
+	 * Ambient light change callback routine
+	 */
+	void (*_alsChange)(uint16_t alsValue) = NULL; ///< Pointer to ALS change callback function
+#endif
 	
+	PPG_SAMPLE *_batchBuf[2] = {NULL, NULL}; ///< Batch double buffer
+	uint8_t _batchFill = 0;					 ///< Buffer that is filled
+	uint16_t _batchCount = 0;				 ///< Samples in the buffer that is filled
+	uint16_t _batchWatermark = 0;			 ///< Samples per batch
+	uint32_t _batchLatency = 0;				 ///< Maximum age of the oldest sample in ms
+	uint32_t _batchStart = 0;				 ///< Time of the oldest sample in the buffer in ms
+	void (*_batchConsumer)(void *ctx, const PPG_SAMPLE *samples, uint16_t count) = NULL; ///< Pointer to batch consumer
+	void *_batchCtx = NULL;					 ///< User context for the batch consumer
+
 	bool readRegs(int reg_addr, uint8_t *data, int len);
 	bool writeRegs(int reg_addr, uint8_t *data, int len);
+	bool busRead(int reg_addr, uint8_t *data, int len);
+	bool busWrite(int reg_addr, uint8_t *data, int len);
 
+#ifdef PPG_HAS_THREADS
+	BUS_ARBITER *_arbiter = NULL; ///< Shared bus arbiter
+	int8_t _busClient = -1;		  ///< Client ID at the bus arbiter
+	uint32_t _busDeadline = 0;	  ///< Deadline for register accesses in us
+#endif
+
+#if VCNL4020C_USE_INTERRUPTS
 	/**
 	 * Interrupt callback routine
 	 */
 	void (*_sensorInt)() = NULL; ///< Pointer to callback function
 
 	int _intPin = -1; ///< GPIO connected to interrupt of VCNL4020
+#endif
 };
 #endif